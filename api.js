@@ -45,6 +45,31 @@ var Syn = {
   // Availability: 0.9.2
   addPluginMenuItem: function(text, shortcut, action) {},
 
+  // Apply several edits to the document at once.  They are undone as a single step, and plugin
+  // callbacks see a single edit.
+  //
+  // Arguments:
+  //   docId (integer) - Document handle.
+  //   edits (array) - Edits, as objects of the form
+  //     { 'startRow': integer, 'startCol': integer, 'endRow': integer, 'endCol': integer, 'text': string }
+  //     Text between start and end is replaced with text.  All locations refer to the document
+  //     before any of the edits, and edits must not overlap.
+  //
+  // Return value: (integer) Number of edits applied.
+  //
+  // Availability: 0.9.4
+  applyDocEdits: function(docId, edits) {},
+
+  // Cancel a command started with spawn.  The process is killed and its callbacks are not called.
+  //
+  // Arguments:
+  //   jobId (integer) - Job id returned by spawn.
+  //
+  // Return value: none
+  //
+  // Availability: 0.9.4
+  cancelSpawn: function(jobId) {},
+
   // Clear all overlays.
   //
   // Arguments:
@@ -153,6 +178,19 @@ var Syn = {
   // Availability: 0.9.2
   getShellDoc: function() {},
 
+  // Get a read-only view of the document, cheaper than getDocLine for reading many lines.  Lines
+  // are converted on first access.  Its methods throw once the document is edited, compare
+  // version with getDocVersion to check.
+  //
+  // Arguments:
+  //   docId (integer) - Document handle.
+  //
+  // Return value: (object) Buffer of the form
+  //   { 'numLines': integer, 'version': integer, 'line': function(row), 'lines': function(start, end) }
+  //
+  // Availability: 0.9.4
+  getDocBuffer: function(docId) {},
+
   // Get document cursor location.
   //
   // Arguments:
@@ -174,6 +212,30 @@ var Syn = {
   // Availability: 0.9.3
   getDocLine: function(docId, row) {},
 
+  // Get a range of lines from the document in one call.
+  //
+  // Arguments:
+  //   docId (integer) - Document handle.
+  //   start (integer) - First line to get.
+  //   end (integer) - One past the last line to get.
+  //
+  // Return value: (array) Text of the lines, clamped to the document.
+  //
+  // Availability: 0.9.4
+  getDocLines: function(docId, start, end) {},
+
+  // Get an estimate of the memory held for the document, in bytes.
+  //
+  // Arguments:
+  //   docId (integer) - Document handle.
+  //
+  // Return value: (object) Bytes per subsystem, of the form { 'text': number, 'lineTokens': number,
+  //   'undo': number, 'statlangTokens': number, 'statlangBlocks': number, 'symbolDb': number,
+  //   'flowGrid': number, 'foldImages': number, 'total': number }
+  //
+  // Availability: 0.9.4
+  getDocMemory: function(docId) {},
+
   // Get number of lines in the document
   //
   // Arguments:
@@ -227,6 +289,16 @@ var Syn = {
   // Availability: 0.9.3
   getDocType: function(docId) {},
 
+  // Get document version, which changes every time the document is edited.
+  //
+  // Arguments:
+  //   docId (integer) - Document handle.
+  //
+  // Return value: (integer) Version.
+  //
+  // Availability: 0.9.4
+  getDocVersion: function(docId) {},
+
   // Go to this location in the file
   //
   // Arguments:
@@ -291,7 +363,31 @@ var Syn = {
   // Availability: 0.9.2
   promptText: function(title, text, defaultText) {},
 
-  // Synchronously execute an external command.
+  // Asynchronously execute an external command.  Returns immediately, the editor keeps running while
+  // the command does.  At most 'plugins.max_jobs' commands run at the same time, others wait.
+  //
+  // Arguments:
+  //   obj (object) - Object with following keys:
+  //     command (string) - Required.  Command to execute.
+  //     stdin (string) - Optional.  If supplied, stdin will be piped into the external process.
+  //     timeout (integer) - Optional.  Kill the command after this many milliseconds.
+  //     onStdout (function) - Optional.  Called with each new chunk of stdout (whole lines).
+  //     onStderr (function) - Optional.  Called with each new chunk of stderr (whole lines).
+  //   callback (function) - Called once the command finishes, with an object with keys:
+  //     exitCode (integer)
+  //     stdout (string)
+  //     stderr (string)
+  //     failed (bool) - Command could not be started, crashed or timed out.
+  //     timedOut (bool)
+  //     error (string) - Reason for failure.
+  //
+  // Return value: (integer) job id, which can be passed to cancelSpawn.
+  //
+  // Availability: 0.9.4
+  spawn: function(obj, callback) {},
+
+  // Synchronously execute an external command.  The editor is blocked while the command runs, and
+  // the command is killed after 10 seconds.  Prefer spawn.
   //
   // Arguments:
   //   obj (object) - Object with following keys:
@@ -1,5 +1,275 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/*
+  Remote agent for SSHIOProvider.  Reads commands of the form "[CMD arg1 arg2 ...]", one per line,
+  from stdin and answers on stdout.  Everything is plain ASCII so that it survives any shell or pty
+  in between.
+
+    [PING]                 ->  [PONG]
+    [READ <Z|R> <path64>]  ->  frames of the file (see below) or [ERROR <message>]
+    [WRITE <path64>]       ->  expects frames on stdin, answers [OK] or [ERROR <message>]
+    [QUIT]                 ->  exits
+
+  Paths are base64 encoded.  A file is transferred as a sequence of frames:
+
+    [CHUNK <Z|R> <raw_size> <payload_size> <payload64>]
+    ...
+    [END <total_size> <adler32>]
+
+  Z chunks are zlib compressed, R chunks are raw.  payload_size is the size of the base64 decoded
+  payload.  adler32 is the checksum of the whole raw file as 8 hex digits.  Written files go into
+  <path>.synupload and are moved over <path> only if size and checksum match.
+
+  When stdin is a tty, it is switched to raw mode without echo for the duration of the session, so
+frames are neither echoed back nor cut at the canonical line limit.  [READY] is printed once that
+is done; the other side must wait for it before sending anything.
+
+  Run with --features to print the supported optional features.
+*/
+
+#define CHUNK_SIZE 32768
+#define LINE_BUFFER_SIZE (4*CHUNK_SIZE)
+
+////////////////////////////////////////////////////////////////////////////////////////// Utils
+
+static unsigned long adler32_update(unsigned long adler, const unsigned char* data, size_t size) {
+  unsigned long a = adler & 0xffff;
+  unsigned long b = (adler >> 16) & 0xffff;
+  for (size_t i = 0; i < size; i++) {
+    a = (a + data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+static const char base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void base64_write(FILE* out, const unsigned char* data, size_t size) {
+  size_t i = 0;
+  for (; i + 2 < size; i += 3) {
+    unsigned long v = (data[i] << 16) | (data[i+1] << 8) | data[i+2];
+    fputc(base64_chars[(v >> 18) & 63], out);
+    fputc(base64_chars[(v >> 12) & 63], out);
+    fputc(base64_chars[(v >> 6) & 63], out);
+    fputc(base64_chars[v & 63], out);
+  }
+  if (i + 1 == size) {
+    unsigned long v = data[i] << 16;
+    fputc(base64_chars[(v >> 18) & 63], out);
+    fputc(base64_chars[(v >> 12) & 63], out);
+    fputs("==", out);
+  } else if (i + 2 == size) {
+    unsigned long v = (data[i] << 16) | (data[i+1] << 8);
+    fputc(base64_chars[(v >> 18) & 63], out);
+    fputc(base64_chars[(v >> 12) & 63], out);
+    fputc(base64_chars[(v >> 6) & 63], out);
+    fputc('=', out);
+  }
+}
+
+static int base64_value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+/** Decode in place, return decoded size or -1 on error. */
+static long base64_decode(char* text) {
+  unsigned char* out = (unsigned char*) text;
+  long size = 0;
+  unsigned long v = 0;
+  int bits = 0;
+  for (char* cur = text; *cur != 0 && *cur != '='; cur++) {
+    int value = base64_value(*cur);
+    if (value < 0) return -1;
+    v = (v << 6) | value;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out[size] = (unsigned char) ((v >> bits) & 0xff);
+      size++;
+    }
+  }
+  out[size] = 0;
+  return size;
+}
+
+static void reply_error(const char* message, const char* detail) {
+  fputs("[ERROR ", stdout);
+  fputs(message, stdout);
+  if (detail != NULL) {
+    fputs(": ", stdout);
+    fputs(detail, stdout);
+  }
+  fputs("]\n", stdout);
+  fflush(stdout);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////// Reading
+
+static void write_chunk(const unsigned char* data, size_t size, int compress) {
+#ifdef HAVE_ZLIB
+  if (compress) {
+    static unsigned char compressed[CHUNK_SIZE + CHUNK_SIZE/2];
+    uLongf compressed_size = sizeof(compressed);
+    if (compress2(compressed, &compressed_size, data, size, Z_DEFAULT_COMPRESSION) == Z_OK
+        && compressed_size < size) {
+      printf("[CHUNK Z %lu %lu ", (unsigned long) size, (unsigned long) compressed_size);
+      base64_write(stdout, compressed, compressed_size);
+      fputs("]\n", stdout);
+      return;
+    }
+  }
+#else
+  (void) compress;
+#endif
+  printf("[CHUNK R %lu %lu ", (unsigned long) size, (unsigned long) size);
+  base64_write(stdout, data, size);
+  fputs("]\n", stdout);
+}
+
+static void handle_read(const char* mode, const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    reply_error("Could not open file", path);
+    return;
+  }
+
+  static unsigned char buffer[CHUNK_SIZE];
+  unsigned long total_size = 0;
+  unsigned long adler = 1;
+  const int compress = strcmp(mode, "Z") == 0;
+  for (;;) {
+    size_t num_read = fread(buffer, 1, CHUNK_SIZE, f);
+    if (num_read > 0) {
+      adler = adler32_update(adler, buffer, num_read);
+      total_size += num_read;
+      write_chunk(buffer, num_read, compress);
+    }
+    if (num_read < CHUNK_SIZE) break;
+  }
+  if (ferror(f)) {
+    fclose(f);
+    reply_error("Could not read file", path);
+    return;
+  }
+  fclose(f);
+  printf("[END %lu %08lx]\n", total_size, adler);
+  fflush(stdout);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////// Writing
+
+static char* next_arg(char** cur) {
+  while (**cur == ' ') (*cur)++;
+  char* arg = *cur;
+  while (**cur != 0 && **cur != ' ') (*cur)++;
+  if (**cur == ' ') {
+    **cur = 0;
+    (*cur)++;
+  }
+  return arg;
+}
+
+static char* process_line(char* line);
+
+/** Read frames from stdin into path. Returns NULL on success or error message. */
+static const char* receive_frames(FILE* f, char* line) {
+  unsigned long total_size = 0;
+  unsigned long adler = 1;
+#ifdef HAVE_ZLIB
+  static unsigned char uncompressed[CHUNK_SIZE];
+#endif
+
+  while (fgets(line, LINE_BUFFER_SIZE, stdin) != NULL) {
+    char* cmd = process_line(line);
+    if (cmd == NULL) return "Invalid frame";
+    char* cur = cmd;
+    char* name = next_arg(&cur);
+
+    if (strcmp(name, "CHUNK") == 0) {
+      char* mode = next_arg(&cur);
+      unsigned long raw_size = strtoul(next_arg(&cur), NULL, 10);
+      unsigned long payload_size = strtoul(next_arg(&cur), NULL, 10);
+      char* payload = next_arg(&cur);
+      long decoded_size = base64_decode(payload);
+      if (decoded_size < 0 || (unsigned long) decoded_size != payload_size) {
+        return "Invalid chunk payload";
+      }
+      const unsigned char* data = (const unsigned char*) payload;
+      if (strcmp(mode, "Z") == 0) {
+#ifdef HAVE_ZLIB
+        uLongf size = sizeof(uncompressed);
+        if (raw_size > CHUNK_SIZE) return "Chunk too big";
+        if (uncompress(uncompressed, &size, data, payload_size) != Z_OK || size != raw_size) {
+          return "Could not uncompress chunk";
+        }
+        data = uncompressed;
+#else
+        return "Compression not supported";
+#endif
+      } else if (raw_size != payload_size) {
+        return "Invalid raw chunk";
+      }
+      if (fwrite(data, 1, raw_size, f) != raw_size) return "Could not write";
+      adler = adler32_update(adler, data, raw_size);
+      total_size += raw_size;
+    } else if (strcmp(name, "END") == 0) {
+      unsigned long expected_size = strtoul(next_arg(&cur), NULL, 10);
+      unsigned long expected_adler = strtoul(next_arg(&cur), NULL, 16);
+      if (expected_size != total_size) return "Size mismatch";
+      if (expected_adler != adler) return "Checksum mismatch";
+      return NULL;
+    } else {
+      return "Unexpected command while receiving";
+    }
+  }
+  return "Unexpected end of input";
+}
+
+static void handle_write(const char* path, char* line) {
+  size_t path_len = strlen(path);
+  char* temp_path = malloc(path_len + 11);
+  if (temp_path == NULL) {
+    reply_error("Out of memory", NULL);
+    return;
+  }
+  memcpy(temp_path, path, path_len);
+  memcpy(temp_path + path_len, ".synupload", 11);
+
+  FILE* f = fopen(temp_path, "wb");
+  if (f == NULL) {
+    reply_error("Could not open file", temp_path);
+    free(temp_path);
+    return;
+  }
+  const char* error = receive_frames(f, line);
+  if (fclose(f) != 0 && error == NULL) error = "Could not close file";
+  if (error == NULL && rename(temp_path, path) != 0) error = "Could not replace file";
+
+  if (error == NULL) {
+    fputs("[OK]\n", stdout);
+    fflush(stdout);
+  } else {
+    remove(temp_path);
+    reply_error(error, path);
+  }
+  free(temp_path);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////// Main loop
 
 /** Go from "[PING]\r\n" to "PING". */
 static char* process_line(char* line) {
@@ -13,60 +283,88 @@ static char* process_line(char* line) {
   return line+1;
 }
 
-static void handle_command(int argc, char** argv) {
-  if (argc == 0) return;
+/** Returns non-zero to quit. */
+static int handle_line(char* line, char* line_buffer) {
+  char* cur = line;
+  char* cmd = next_arg(&cur);
 
-  if (strcmp(argv[0], "PING") == 0) {
+  if (strcmp(cmd, "PING") == 0) {
     fputs("[PONG]\n", stdout);
     fflush(stdout);
+  } else if (strcmp(cmd, "READ") == 0) {
+    char* mode = next_arg(&cur);
+    char* path = next_arg(&cur);
+    if (base64_decode(path) <= 0) reply_error("Invalid path", NULL);
+    else handle_read(mode, path);
+  } else if (strcmp(cmd, "WRITE") == 0) {
+    char* path = next_arg(&cur);
+    if (base64_decode(path) <= 0) reply_error("Invalid path", NULL);
+    else {
+      // Path lives in line_buffer which is about to be reused for frames.
+      char* path_copy = malloc(strlen(path) + 1);
+      if (path_copy == NULL) {
+        reply_error("Out of memory", NULL);
+        return 0;
+      }
+      strcpy(path_copy, path);
+      handle_write(path_copy, line_buffer);
+      free(path_copy);
+    }
+  } else if (strcmp(cmd, "QUIT") == 0) {
+    return 1;
   }
+  return 0;
 }
 
-#define ARGV_MAX 8
-static void handle_line(char* line) {
-  int argc = 0;
-  char* argv[ARGV_MAX];
-  char* cur = line;
-  while (*cur == ' ') {
-    cur++;
-  }
+////////////////////////////////////////////////////////////////////////////////////////// TTY
 
-  for (int arg = 0; arg < ARGV_MAX; arg++) {
-    argc++;
-    argv[arg] = cur;
-    while (*cur != 0 && *cur != ' ') {
-      cur++;
-    }
-    if (*cur == ' ') {
-      *cur = 0;
-      cur++;
-      while (*cur == ' ') {
-        *cur = 0;
-        cur++;
-      }
-    }
+static struct termios saved_term_settings;
+static int restore_term_settings = 0;
 
-    if (*cur == 0) {
-      break;
-    }
-  }
+static void enter_raw_mode() {
+  if (!isatty(0) || tcgetattr(0, &saved_term_settings) != 0) return;
 
-  handle_command(argc, argv);
+  // Like cfmakeraw, but output processing and signals are left alone.
+  struct termios term_settings = saved_term_settings;
+  term_settings.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+  term_settings.c_lflag &= ~(ECHO | ECHONL | ICANON | IEXTEN);
+  term_settings.c_cc[VMIN] = 1;
+  term_settings.c_cc[VTIME] = 0;
+  if (tcsetattr(0, TCSANOW, &term_settings) == 0) restore_term_settings = 1;
 }
 
-#define LINE_MAX 8192
+static void leave_raw_mode() {
+  if (restore_term_settings) tcsetattr(0, TCSANOW, &saved_term_settings);
+}
 
 int main(int argc, const char** argv) {
-  char line[LINE_MAX];
+  if (argc > 1 && strcmp(argv[1], "--features") == 0) {
+#ifdef HAVE_ZLIB
+    puts("frames zlib ready");
+#else
+    puts("frames ready");
+#endif
+    return 0;
+  }
+
+  char* line = malloc(LINE_BUFFER_SIZE);
+  if (line == NULL) return 1;
 
-  while (fgets(line, LINE_MAX, stdin) != NULL) {
-    line[LINE_MAX-1] = 0;
+  enter_raw_mode();
+  fputs("[READY]\n", stdout);
+  fflush(stdout);
 
-    // processed_line is a string inside line[LINE_MAX].
+  while (fgets(line, LINE_BUFFER_SIZE, stdin) != NULL) {
+    line[LINE_BUFFER_SIZE-1] = 0;
+
+    // processed_line is a string inside line.
     char* processed_line = process_line(line);
 
     if (processed_line != NULL) {
-      handle_line(processed_line);
+      if (handle_line(processed_line, line)) break;
     }
   }
-}
\ No newline at end of file
+  leave_raw_mode();
+  free(line);
+  return 0;
+}
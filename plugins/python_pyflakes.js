@@ -15,33 +15,39 @@ Syn.addPluginMenuItem("Pyflakes", "F1", function() {
   if (handle < 0) return;
   Syn.clearOverlays(handle);
 
-  var result = Syn.system({
+  // Runs in the background, the editor stays usable while pyflakes works.
+  Syn.spawn({
     command: PYFLAKES_BIN,
     stdin: Syn.getDocText(handle)
-  });
+  }, function(result) {
+    if (result.failed) {
+      Syn.feedback('Pyflakes', 'Could not run ' + PYFLAKES_BIN + ': ' + result.error);
+      return;
+    }
 
-  // Process output of pyflakes
-  var output = result.stdout + result.stderr;
-  var lines = output.split('\n');
+    // Process output of pyflakes
+    var output = result.stdout + result.stderr;
+    var lines = output.split('\n');
 
-  var num_errors = 0;
-  for (var i = 0; i < lines.length; i++) {
-    var line = lines[i];
-    var arr = line.split(':');
-    if (arr.length >= 3) {
-      if (arr[0] !== '<stdin>') continue;
-      var row = parseInt(arr[1]);
-      var col = 0;
-      var text = "";
-      if (arr.length > 3) {
-        col = parseInt(arr[2]);
-        text = arr.slice(3).join(':');
-      } else {
-        text = arr.slice(2).join(':');
+    var num_errors = 0;
+    for (var i = 0; i < lines.length; i++) {
+      var line = lines[i];
+      var arr = line.split(':');
+      if (arr.length >= 3) {
+        if (arr[0] !== '<stdin>') continue;
+        var row = parseInt(arr[1]);
+        var col = 0;
+        var text = "";
+        if (arr.length > 3) {
+          col = parseInt(arr[2]);
+          text = arr.slice(3).join(':');
+        } else {
+          text = arr.slice(2).join(':');
+        }
+        Syn.addOverlay(handle, row, col, 1, text);
+        num_errors += 1;
       }
-      Syn.addOverlay(handle, row, col, 1, text);
-      num_errors += 1;
     }
-  }
-  Syn.feedback('Pyflakes', num_errors + ' errors found. Press ESC to clear.');
+    Syn.feedback('Pyflakes', num_errors + ' errors found. Press ESC to clear.');
+  });
 });
@@ -0,0 +1,158 @@
+#include "async_io.hpp"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QRunnable>
+#include <QTimer>
+
+/** How long to wait before retrying when the provider is busy with a synchronous operation. */
+#define ASYNC_IO_BUSY_RETRY 50
+
+static QEvent::Type result_event_type() {
+  static const QEvent::Type type = QEvent::Type(QEvent::registerEventType());
+  return type;
+}
+
+/** Carries the result from the thread pool to the GUI thread. */
+class AsyncIOResultEvent : public QEvent {
+public:
+  std::shared_ptr<AsyncIOJob> job;
+  AsyncIOResult result;
+
+  AsyncIOResultEvent(std::shared_ptr<AsyncIOJob> j, AsyncIOResult& r)
+    : QEvent(result_event_type()), job(j), result(std::move(r)) {}
+};
+
+class AsyncIORunnable : public QRunnable {
+private:
+  AsyncIO* target;
+  IOProvider* iop;
+  std::shared_ptr<AsyncIOJob> job;
+  std::string abs_path;
+
+public:
+  AsyncIORunnable(AsyncIO* t, IOProvider* i, std::shared_ptr<AsyncIOJob> j, const std::string& p)
+    : target(t), iop(i), job(j), abs_path(p) {}
+
+  virtual void run() override {
+    if (job->request->is_cancelled()) return;
+    AsyncIOResult result = AsyncIO::run_operation(iop, *job, abs_path);
+    QCoreApplication::postEvent(target, new AsyncIOResultEvent(job, result));
+  }
+};
+
+AsyncIO::AsyncIO(IOProvider* m) : master(m), queue_running(false), queue_scheduled(false),
+    is_shut_down(false) {
+}
+
+AsyncIO::~AsyncIO() {
+  shutdown();
+}
+
+AsyncIOResult AsyncIO::run_operation(IOProvider* iop, const AsyncIOJob& job, const std::string& abs_path) {
+  AsyncIOResult result;
+  result.abs_path = abs_path;
+  result.ok = true;
+  result.size = 0;
+  result.too_big = false;
+
+  try {
+    switch (job.op) {
+      case AsyncIOOp::GET_FILE_SIZE:
+        result.size = iop->get_file_size(abs_path);
+        break;
+      case AsyncIOOp::LIST_DIR:
+        result.entries = iop->list_dir(abs_path, job.filter);
+        break;
+      case AsyncIOOp::LIST_DIR_RECURSIVE:
+        result.listings = iop->list_dir_recursive(abs_path, job.filter, -1);
+        break;
+      case AsyncIOOp::READ_FILE:
+        if (job.max_size > 0) {
+          result.size = iop->get_file_size(abs_path);
+          if (result.size > job.max_size) {
+            result.too_big = true;
+            break;
+          }
+        }
+        result.contents = iop->read_file(abs_path);
+        result.size = result.contents.size();
+        break;
+      case AsyncIOOp::WRITE_FILE_SAFE:
+        iop->write_file_safe(abs_path, job.data.data(), job.data.size());
+        break;
+    }
+  } catch (std::exception& e) {
+    result.ok = false;
+    result.error = e.what();
+  }
+  return result;
+}
+
+void AsyncIO::deliver(AsyncIOJob& job, AsyncIOResult& result) {
+  AsyncIORequest& request = *job.request;
+  if (request.is_cancelled()) return;
+
+  request.num_done++;
+  if (job.callback) job.callback(result);
+  // Callback may have cancelled the request.
+  if (request.is_cancelled()) return;
+  if (job.progress) job.progress(request.num_done, request.num_total);
+}
+
+void AsyncIO::run_in_pool(IOProvider* iop, std::shared_ptr<AsyncIOJob> job, const std::string& abs_path) {
+  if (is_shut_down) return;
+  pool.start(new AsyncIORunnable(this, iop, job, abs_path));
+}
+
+void AsyncIO::enqueue(std::shared_ptr<AsyncIOJob> job, const std::string& abs_path) {
+  if (is_shut_down) return;
+  queue.push_back(std::make_pair(job, abs_path));
+  schedule_queue(0);
+}
+
+void AsyncIO::schedule_queue(int delay) {
+  if (queue_scheduled) return;
+  queue_scheduled = true;
+  QTimer::singleShot(delay, this, SLOT(slot_run_queue()));
+}
+
+void AsyncIO::slot_run_queue() {
+  queue_scheduled = false;
+  // Operation that is running will reschedule once done.
+  if (queue_running) return;
+
+  while (!queue.empty() && queue.front().first->request->is_cancelled()) queue.pop_front();
+  if (queue.empty()) return;
+
+  if (master->is_busy(queue.front().second)) {
+    schedule_queue(ASYNC_IO_BUSY_RETRY);
+    return;
+  }
+
+  std::shared_ptr<AsyncIOJob> job = queue.front().first;
+  const std::string abs_path = queue.front().second;
+  queue.pop_front();
+
+  queue_running = true;
+  AsyncIOResult result = run_operation(master, *job, abs_path);
+  queue_running = false;
+
+  deliver(*job, result);
+  if (!queue.empty()) schedule_queue(0);
+}
+
+void AsyncIO::customEvent(QEvent* event) {
+  if (event->type() != result_event_type() || is_shut_down) return;
+
+  AsyncIOResultEvent* result_event = static_cast<AsyncIOResultEvent*>(event);
+  deliver(*result_event->job, result_event->result);
+}
+
+void AsyncIO::shutdown() {
+  is_shut_down = true;
+  for (auto& p : queue) p.first->request->cancel();
+  queue.clear();
+  pool.clear();
+  pool.waitForDone();
+}
@@ -0,0 +1,119 @@
+#ifndef SYNTAXIC_ASYNC_IO_HPP
+#define SYNTAXIC_ASYNC_IO_HPP
+
+#include "io_provider.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <QObject>
+#include <QThreadPool>
+
+class QEvent;
+
+namespace AsyncIOOp {
+  enum Type {
+    GET_FILE_SIZE, LIST_DIR, LIST_DIR_RECURSIVE, READ_FILE, WRITE_FILE_SAFE
+  };
+}
+
+/** Result of an asynchronous operation on a single path. */
+struct AsyncIOResult {
+  std::string abs_path;
+  bool ok;
+  /** Set if not ok. */
+  std::string error;
+  /** GET_FILE_SIZE and READ_FILE. */
+  unsigned long size;
+  /** READ_FILE.  Empty if the file was larger than max_size. */
+  std::vector<char> contents;
+  bool too_big;
+  /** LIST_DIR. */
+  std::vector<DirEntry> entries;
+  /** LIST_DIR_RECURSIVE, see IOProvider::list_dir_recursive. */
+  std::map<std::string, std::vector<DirEntry>> listings;
+};
+
+typedef std::function<void(AsyncIOResult& result)> AsyncIOCallback;
+typedef std::function<void(int num_done, int num_total)> AsyncIOProgress;
+
+/** Handle of an asynchronous operation.  Once cancelled, no more callbacks are invoked. */
+class AsyncIORequest {
+  friend class AsyncIO;
+
+private:
+  std::atomic<bool> cancelled;
+  int num_done;
+  int num_total;
+
+public:
+  AsyncIORequest(int total) : cancelled(false), num_done(0), num_total(total) {}
+
+  inline void cancel() { cancelled = true; }
+  inline bool is_cancelled() const { return cancelled; }
+  inline int get_num_done() const { return num_done; }
+  inline int get_num_total() const { return num_total; }
+  inline bool is_finished() const { return num_done == num_total; }
+};
+
+/** Everything needed to run an operation, on one or more paths. */
+struct AsyncIOJob {
+  AsyncIOOp::Type op;
+  std::vector<std::string> abs_paths;
+  std::string filter;
+  std::vector<char> data;
+  /** READ_FILE: files larger than this are not read (0 for no limit). */
+  unsigned long max_size;
+  AsyncIOCallback callback;
+  AsyncIOProgress progress;
+  std::shared_ptr<AsyncIORequest> request;
+};
+
+/** Runs IOProvider operations without blocking the GUI.  Operations on thread safe providers
+(local files) run on a thread pool.  Others (SSH) are queued and run one at a time on the GUI
+thread, where they wait for the remote side in their own event loop.  Callbacks are always
+invoked on the GUI thread, in order of completion. */
+class AsyncIO : public QObject {
+  Q_OBJECT
+
+private:
+  IOProvider* master;
+  QThreadPool pool;
+  std::deque<std::pair<std::shared_ptr<AsyncIOJob>, std::string>> queue;
+  bool queue_running;
+  bool queue_scheduled;
+  bool is_shut_down;
+
+  void schedule_queue(int delay);
+
+protected:
+  virtual void customEvent(QEvent* event) override;
+
+private slots:
+  void slot_run_queue();
+
+public:
+  /** master is used for all operations that do not run on the thread pool. */
+  AsyncIO(IOProvider* master);
+  virtual ~AsyncIO();
+
+  /** Run the operation on abs_path with iop, on the thread pool.  iop must be thread safe. */
+  void run_in_pool(IOProvider* iop, std::shared_ptr<AsyncIOJob> job, const std::string& abs_path);
+  /** Run the operation on abs_path on the GUI thread, after everything queued before it. */
+  void enqueue(std::shared_ptr<AsyncIOJob> job, const std::string& abs_path);
+
+  /** Invoke callbacks, unless cancelled.  Must be called on the GUI thread. */
+  static void deliver(AsyncIOJob& job, AsyncIOResult& result);
+  /** Run a single operation synchronously, errors are reported in the result. */
+  static AsyncIOResult run_operation(IOProvider* iop, const AsyncIOJob& job, const std::string& abs_path);
+
+  /** Drop everything queued and wait for the thread pool. */
+  void shutdown();
+};
+
+#endif
@@ -0,0 +1,404 @@
+// Benchmarks of the editor core.  Run from the root of the repository (inputs are read from
+// test_files), with the meta directory next to the binary for the grammar benchmarks, same as for
+// syntaxic itself:
+//
+//   syntaxic_bench [--filter substring] [--min-time seconds] [--output file.json]
+//
+// Results are written as JSON, so that runs on different commits can be compared.
+
+#include "choices.hpp"
+#include "core/common.hpp"
+#include "core/flow_grid.hpp"
+#include "core/rich_text.hpp"
+#include "core/text_buffer.hpp"
+#include "core/text_edit.hpp"
+#include "core/text_file.hpp"
+#include "core/util.hpp"
+#include "core/util_glob.hpp"
+#include "json/json.h"
+#include "master_io_provider.hpp"
+#include "statlang/statlang.hpp"
+#include "statlang/symboldb.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Every benchmark is sampled at least this many times... */
+#define BENCH_MIN_SAMPLES 5
+/** ...and at most this many times. */
+#define BENCH_MAX_SAMPLES 1000
+/** Default for --min-time: keep sampling until this much time (s) has been measured. */
+#define BENCH_DEFAULT_MIN_TIME 0.5
+
+/** Number of lines of generated source. */
+#define BENCH_SOURCE_LINES 20000
+/** Number of edits of the edit and undo storms. */
+#define BENCH_NUM_EDITS 5000
+/** Number of generated file paths for ChoiceList. */
+#define BENCH_NUM_PATHS 200000
+
+class Bench {
+private:
+  std::string filter;
+  double min_time;
+  Json::Value results;
+
+public:
+  Bench(const std::string& f, double mt) : filter(f), min_time(mt), results(Json::arrayValue) {}
+
+  inline bool wanted(const std::string& name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+  }
+
+  /** Time body, after setup, until enough has been measured.  Setup is not timed. */
+  void run(const std::string& name, std::function<void()> setup, std::function<void()> body) {
+    if (!wanted(name)) return;
+    fprintf(stderr, "%s... ", name.c_str());
+    fflush(stderr);
+
+    std::vector<double> samples;
+    double total = 0;
+    while (samples.size() < BENCH_MAX_SAMPLES && (samples.size() < BENCH_MIN_SAMPLES || total < min_time)) {
+      if (setup) setup();
+      const double start = get_timestamp();
+      body();
+      const double elapsed = get_timestamp() - start;
+      samples.push_back(elapsed);
+      total += elapsed;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Json::Value result;
+    result["name"] = name;
+    result["samples"] = int(samples.size());
+    result["min_ms"] = samples.front() * 1000;
+    result["median_ms"] = samples[samples.size() / 2] * 1000;
+    result["mean_ms"] = total / samples.size() * 1000;
+    results.append(result);
+    fprintf(stderr, "%.3f ms\n", samples[samples.size() / 2] * 1000);
+  }
+
+  inline void run(const std::string& name, std::function<void()> body) { run(name, nullptr, body); }
+
+  inline const Json::Value& get_results() const { return results; }
+};
+
+////////////////////////////////////////////////////////////// Inputs
+
+/** Results that are otherwise unused go here, so that they are not optimized away. */
+static volatile int bench_sink;
+
+/** Deterministic pseudo-random numbers, so that every run sees the same inputs. */
+class BenchRandom {
+private:
+  uint32_t state;
+public:
+  BenchRandom() : state(12345) {}
+  inline uint32_t next(uint32_t n) {
+    state = state * 1103515245 + 12345;
+    return (state >> 8) % n;
+  }
+};
+
+static const char* const words[] = {
+  "int", "return", "if", "else", "for", "while", "const", "static", "void", "class", "struct",
+  "text_buffer", "flow_grid", "line", "cursor", "row", "col", "size", "index", "result", "value",
+  "TextBuffer", "FlowGrid", "getLine", "numLines", "x", "y", "i", "j", "count", "name", "path"
+};
+static const int num_words = sizeof(words) / sizeof(words[0]);
+
+/** Something that looks enough like source code to exercise the grammars. */
+static std::string generate_source(int num_lines) {
+  BenchRandom random;
+  std::string output;
+  int depth = 0;
+  for (int i = 0; i < num_lines; i++) {
+    output.append(2 * depth, ' ');
+    switch (random.next(8)) {
+      case 0:
+        output += "// ";
+        for (int k = 0; k < 6; k++) { output += words[random.next(num_words)]; output += ' '; }
+        break;
+      case 1:
+        output += words[random.next(num_words)];
+        output += " = \"";
+        output += words[random.next(num_words)];
+        output += " string\";";
+        break;
+      case 2:
+        if (depth < 6) {
+          output += "if (";
+          output += words[random.next(num_words)];
+          output += " < 42) {";
+          depth++;
+        }
+        break;
+      case 3:
+        if (depth > 0) {
+          output.resize(output.size() - 2);
+          output += "}";
+          depth--;
+        }
+        break;
+      default:
+        output += words[random.next(num_words)];
+        output += ' ';
+        output += words[random.next(num_words)];
+        output += " = ";
+        output += words[random.next(num_words)];
+        output += "(";
+        output += std::to_string(random.next(10000));
+        output += ", 0.5);";
+        break;
+    }
+    output += '\n';
+  }
+  return output;
+}
+
+static std::vector<std::string> generate_paths(int num) {
+  BenchRandom random;
+  std::vector<std::string> paths;
+  for (int i = 0; i < num; i++) {
+    std::string path = "src";
+    const int depth = 1 + random.next(4);
+    for (int k = 0; k < depth; k++) {
+      path += '/';
+      path += words[random.next(num_words)];
+    }
+    path += '_';
+    path += std::to_string(i);
+    path += random.next(2) ? ".cpp" : ".hpp";
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+/** Contents of the test files, repeated up to about size bytes. */
+static std::string load_test_files(unsigned int size) {
+  std::string contents;
+  for (const char* name : { "test_files/small", "test_files/mini" }) {
+    try {
+      std::vector<char> data;
+      read_file(data, name);
+      contents.append(data.begin(), data.end());
+      contents += '\n';
+    } catch (std::exception& e) {
+      fprintf(stderr, "WARNING: Could not read %s: %s\n", name, e.what());
+    }
+  }
+  if (contents.empty()) return contents;
+  std::string output;
+  while (output.size() < size) output += contents;
+  return output;
+}
+
+/** Apply BENCH_NUM_EDITS single character edits all over tf, recording undo. */
+static void edit_storm(TextFile& tf, bool insert) {
+  BenchRandom random;
+  for (int i = 0; i < BENCH_NUM_EDITS; i++) {
+    const int row = random.next(tf.get_num_lines());
+    const int size = tf.get_line(row).size();
+    SimpleTextEdit ste(tf, CursorLocation(row, 0), &tf);
+    if (insert) {
+      ste.insert_char(CursorLocation(row, random.next(size + 1)), 'a' + random.next(26));
+    } else if (size > 0) {
+      ste.remove_char(CursorLocation(row, random.next(size)));
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////// Benchmarks
+
+static void bench_text(Bench& bench, const std::string& source) {
+  {
+    TextBuffer tb;
+    bench.run("text_buffer.from_utf8/generated", [&]() { tb.from_utf8(source); });
+    bench.run("text_buffer.to_utf8/generated", [&]() { tb.to_utf8(UNIX); });
+  }
+
+  const std::string test_files = load_test_files(source.size());
+  if (!test_files.empty()) {
+    TextBuffer tb;
+    bench.run("text_buffer.from_utf8/test_files", [&]() { tb.from_utf8(test_files); });
+    bench.run("text_buffer.to_utf8/test_files", [&]() { tb.to_utf8(UNIX); });
+  }
+
+  {
+    TextBuffer tb;
+    tb.from_utf8(source);
+    std::vector<SearchResult> results;
+    auto search_all = [&](const std::string& term, bool word, bool case_insensitive) {
+      results.clear();
+      for (int row = 0; row < tb.get_num_lines(); row++) {
+        tb.get_line(row).search(term, results, row, word, case_insensitive);
+      }
+    };
+    bench.run("line.search/plain", [&]() { search_all("text_buffer", false, false); });
+    bench.run("line.search/word", [&]() { search_all("line", true, false); });
+    bench.run("line.search/case_insensitive", [&]() { search_all("TEXTBUFFER", false, true); });
+  }
+}
+
+static void bench_edits(Bench& bench, const std::string& source) {
+  std::unique_ptr<TextFile> tf;
+  auto fresh = [&]() {
+    tf.reset(new TextFile(master_io_provider));
+    tf->from_utf8(source);
+  };
+  bench.run("simple_text_edit.insert_storm", fresh, [&]() { edit_storm(*tf, true); });
+  bench.run("simple_text_edit.remove_storm", fresh, [&]() { edit_storm(*tf, false); });
+  bench.run("undo_manager.undo", [&]() {
+    fresh();
+    edit_storm(*tf, true);
+  }, [&]() {
+    CursorLocation cl(0, 0);
+    while (tf->get_undo_manager().undo(cl)) {}
+  });
+}
+
+static void bench_flow_grid(Bench& bench, const std::string& source) {
+  TextBuffer tb;
+  tb.from_utf8(source);
+  FlowGrid fg;
+  fg.text_buffer = &tb;
+  fg.x_width = 8;
+  fg.tab_width = 32;
+  fg.line_height = 16;
+  fg.folded_line_height = 4;
+
+  fg.word_wrap_width = -1;
+  bench.run("flow_grid.reflow/no_wrap", [&]() { fg.reflow(); });
+  fg.word_wrap_width = 320;
+  bench.run("flow_grid.reflow/wrap", [&]() { fg.reflow(); });
+  fg.fast_reflow = true;
+  bench.run("flow_grid.reflow/wrap_fast", [&]() { fg.reflow(); });
+}
+
+static void bench_statlang(Bench& bench, const std::string& source) {
+  const std::string meta_path = under_root("syntaxic_meta.json");
+  if (!QFileInfo::exists(QString::fromStdString(meta_path))) {
+    fprintf(stderr, "WARNING: No %s, skipping grammars.\n", meta_path.c_str());
+    return;
+  }
+  std::vector<char> meta;
+  read_file(meta, meta_path);
+  StatLang stat_lang;
+  stat_lang.init(meta.data(), meta.size());
+
+  TextBuffer tb;
+  tb.from_utf8(source);
+  RichText rich_text;
+  const int id = stat_lang.add_document(&tb);
+  for (const std::string& type : stat_lang.available_file_types) {
+    const std::string name = "statlang.process_document/" + type;
+    if (!bench.wanted(name)) continue;
+    stat_lang.set_document_type(id, type);
+    // Loading and compiling the grammar is not what is measured.
+    stat_lang.process_document(id, &rich_text);
+    bench.run(name, [&]() { stat_lang.process_document(id, &rich_text); });
+  }
+  stat_lang.remove_document(id);
+}
+
+static void bench_choices(Bench& bench) {
+  const std::vector<std::string> paths = generate_paths(BENCH_NUM_PATHS);
+  ChoiceList cl;
+  for (unsigned int i = 0; i < paths.size(); i++) cl.add_choice(paths[i], i);
+
+  bench.run("choices.refilter_choices/cold", [&]() { cl.order_choices(); }, [&]() {
+    cl.refilter_choices("tbufcpp");
+  });
+  // As typed, each refilter narrows the previous one.
+  bench.run("choices.refilter_choices/typing", [&]() { cl.order_choices(); }, [&]() {
+    const std::string entry = "flowgridcpp";
+    for (unsigned int i = 1; i <= entry.size(); i++) cl.refilter_choices(entry.substr(0, i));
+  });
+
+  UtilGlob::GlobSet globs(true);
+  for (const char* glob : { "*.c", "*.cpp", "*.h", "*.hpp", "*.py", "*.js", "Makefile", "*.[ch]xx", "*_test.*" }) {
+    globs.add(glob, 0);
+  }
+  bench.run("glob_set.match", [&]() {
+    int num = 0;
+    for (const std::string& path : paths) num += globs.matches(path);
+    bench_sink = num;
+  });
+}
+
+static void bench_symboldb(Bench& bench, const std::string& source) {
+  TextBuffer tb;
+  tb.from_utf8(source);
+  SymbolDatabase sdb;
+  sdb.start_adding();
+  BenchRandom random;
+  for (int row = 0; row < tb.get_num_lines(); row++) {
+    // Make the symbols more varied than the words of the source.
+    sdb.add_symbol(std::string(words[random.next(num_words)]) + std::to_string(random.next(5000)), row, 0);
+  }
+  sdb.finish_adding();
+
+  std::unordered_map<std::string, int> matches;
+  bench.run("symboldb.query_by_prefix", [&]() {
+    for (int i = 0; i < num_words; i++) {
+      for (int len = 1; len <= 3 && len <= int(strlen(words[i])); len++) {
+        matches.clear();
+        sdb.query_by_prefix(std::string(words[i], len), matches);
+      }
+    }
+  });
+}
+
+int main(int argc, char** argv) {
+  QCoreApplication app(argc, argv);
+  MasterIOProvider miop;
+
+  std::string filter, output_path;
+  double min_time = BENCH_DEFAULT_MIN_TIME;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+    else if (arg == "--min-time" && i + 1 < argc) min_time = atof(argv[++i]);
+    else if (arg == "--output" && i + 1 < argc) output_path = argv[++i];
+    else {
+      fprintf(stderr, "Usage: %s [--filter substring] [--min-time seconds] [--output file.json]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  Bench bench(filter, min_time);
+  const std::string source = generate_source(BENCH_SOURCE_LINES);
+  bench_text(bench, source);
+  bench_edits(bench, source);
+  bench_flow_grid(bench, source);
+  bench_statlang(bench, source);
+  bench_choices(bench);
+  bench_symboldb(bench, source);
+
+  Json::Value root;
+  root["version"] = 1;
+  root["source_lines"] = BENCH_SOURCE_LINES;
+  root["results"] = bench.get_results();
+  const std::string json = Json::StyledWriter().write(root);
+  if (output_path.empty()) {
+    printf("%s", json.c_str());
+  } else {
+    FILE* f = fopen(output_path.c_str(), "wb");
+    if (f == nullptr || fwrite(json.data(), 1, json.size(), f) != json.size()) {
+      fprintf(stderr, "ERROR: Could not write %s.\n", output_path.c_str());
+      if (f) fclose(f);
+      return 1;
+    }
+    fclose(f);
+  }
+  return 0;
+}
@@ -1,106 +1,254 @@
 #include "choices.hpp"
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <thread>
 
 using std::min;
 using std::max;
 
-int16_t longest_common_substring(const std::string& str1, const std::string& str2, int* curr, int* prev)
-{
-  if (str1.empty() || str2.empty()) return 0;
-  if (str1.size() >= MAX_PATH_SIZE || str2.size() >= MAX_PATH_SIZE) return 0;
-
-  int *swap = nullptr;
-  int maxSubstr = 0;
-
-  for(unsigned int i = 0; i<str1.size(); ++i) {
-    for(unsigned int j = 0; j<str2.size(); ++j) {
-      if(str1[i] != str2[j]) {
-        curr[j] = 0;
-      } else {
-        if(i == 0 || j == 0) {
-          curr[j] = 1;
-        } else {
-          curr[j] = 1 + prev[j-1];
-        }
-        maxSubstr = max(maxSubstr, curr[j]);
-      }
-    }
-    swap=curr;
-    curr=prev;
-    prev=swap;
+// Scoring, loosely after fzf.  All in integers, a match is worth SCORE_MATCH plus the bonus of its
+// position.
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_PATH_BOUNDARY 10
+#define BONUS_BOUNDARY 8
+#define BONUS_CAMEL 7
+#define BONUS_CONSECUTIVE 4
+#define BONUS_FILE_NAME 3
+#define SCORE_NONE -1000000
+
+static inline bool is_path_separator(char c) {
+  return c == '/' || c == '\\';
+}
+
+static inline bool is_word_separator(char c) {
+  return c == '_' || c == '-' || c == '.' || c == ' ' || c == ':';
+}
+
+static inline char to_lower(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static bool is_better(const Choice* a, const Choice* b) {
+  if (a->score != b->score) return a->score > b->score;
+  if (a->name.size() != b->name.size()) return a->name.size() < b->name.size();
+  return a->num < b->num;
+}
+
+static uint64_t calculate_char_mask(const char* lower, int size) {
+  uint64_t mask = 0;
+  for (int i = 0; i < size; i++) {
+    const uint8_t u = lower[i];
+    int bit;
+    if (u >= 'a' && u <= 'z') bit = u - 'a';
+    else if (u >= '0' && u <= '9') bit = 26 + u - '0';
+    else bit = 36 + u % 28;
+    mask |= uint64_t(1) << bit;
   }
-  return maxSubstr;
+  return mask;
 }
 
-int16_t levenshtein_distance(const std::string& s, const std::string& t, int16_t* buffer) {
-  int n = s.size(), m = t.size();
-  if (n >= MAX_PATH_SIZE || m >= MAX_PATH_SIZE) return 1000;
-  int16_t* d = buffer;
-  m++;
-  n++;
-  for (int i = 0; i < n; i++) d[i] = i;
-  for (int i = 0; i < m; i++) d[i * n] = i;
-
-  for (int i = 1; i < n; i++) {
-    for (int j = 1; j < m; j++) {
-      // Insertions/deletions cost 1, substitution 3.
-      const int a = d[(j - 1) * n + i] + 1;
-      const int b = d[j * n + i - 1] + 1;
-      const int c = d[(j - 1) * n + i - 1] + ((s[i-1] != t[j-1]) ? 3 : 0);
-      d[j * n + i] = (min(a,(min(b,c))));
-    }
+static int find_file_name_start(const char* name, int size) {
+  for (int i = size - 1; i >= 0; i--) {
+    if (is_path_separator(name[i])) return i + 1;
   }
-  return d[n * m - 1];
+  return 0;
 }
 
-float ChoiceList::calculate_score(const std::string& entry, const std::string& choice) {
-  float score = levenshtein_distance(entry, choice, levenshtein_buffer)
-              / (static_cast<float> (choice.size()));
-  score = score - (score*0.1*longest_common_substring(entry, choice, comm1_buf, comm2_buf));
-  return score;
+/** Bonus for matching the character at i. */
+static inline int position_bonus(const char* name, int i, int file_name_start) {
+  int bonus = i >= file_name_start ? BONUS_FILE_NAME : 0;
+  if (i == 0) return bonus + BONUS_PATH_BOUNDARY;
+  const unsigned char prev = name[i-1], cur = name[i];
+  if (is_path_separator(prev)) return bonus + BONUS_PATH_BOUNDARY;
+  if (is_word_separator(prev)) return bonus + BONUS_BOUNDARY;
+  if (islower(prev) && isupper(cur)) return bonus + BONUS_CAMEL;
+  if (!isdigit(prev) && isdigit(cur)) return bonus + BONUS_CAMEL;
+  return bonus;
 }
 
-#define MAX_NUM_CHOICES 30
+/** See ChoiceList::calculate_score.  entry must be lowercase, lower is name in lowercase. */
+static int score_name(const std::string& entry, const char* name, const char* lower, int size,
+    int file_name_start) {
+  const int n = entry.size();
+  if (n <= 0) return 0;
+  if (n > MAX_PATH_SIZE) return -1;
 
-void ChoiceList::insert_choice_into_chosen(Choice* ch) {
-  if (chosen.size() == 0) {
-    chosen.push_back(ch);
-    return;
-  } else {
-    bool found = false;
-    for (int i = int(chosen.size()) - 1; i >= 0; i--) {
-      if (chosen[i]->score < ch->score) {
-        chosen.insert(chosen.begin() + i + 1, ch);
-        found = true;
-        break;
+  // Subsequence check, forward and backward.  entry[i] can only be matched between lo[i] (earliest
+  // position) and hi[i] (latest position), so the DP only has to look at those columns.
+  int lo[MAX_PATH_SIZE], hi[MAX_PATH_SIZE];
+  int pos = 0;
+  for (int i = 0; i < n; i++) {
+    const char* found = static_cast<const char*>(memchr(lower + pos, entry[i], size - pos));
+    if (found == nullptr) return -1;
+    lo[i] = found - lower;
+    pos = lo[i] + 1;
+  }
+  pos = size - 1;
+  for (int i = n - 1; i >= 0; i--) {
+    while (lower[pos] != entry[i]) pos--;
+    hi[i] = pos--;
+  }
+  const int first = lo[0];
+  // Too long to score properly, but it does match.
+  if (hi[n-1] - first + 1 > MAX_PATH_SIZE) return 0;
+
+  // s[j]: best score with entry[i] matched at first + j.
+  // g[j]: best score with entry[i] matched before first + j - 1, and the characters in between
+  // skipped, i.e. what entry[i+1] builds on when it is matched at first + j after a gap.
+  // SCORE_NONE is low enough to stay negative whatever is added to it, so no checks are needed.
+  // Rows are offset by 2, so that j - 2 is always a valid index.
+  int rows[4][MAX_PATH_SIZE + 2];
+  int *prev_s = rows[0] + 2, *prev_g = rows[1] + 2, *s = rows[2] + 2, *g = rows[3] + 2;
+  int best = SCORE_NONE;
+
+  for (int i = 0; i < n; i++) {
+    const char c = entry[i];
+    const int j0 = lo[i] - first;
+    // Next row reads this one up to its own last column.
+    const int j1 = (i + 1 < n ? hi[i+1] : hi[i]) - first;
+    const int jm = hi[i] - first;
+    s[j0-1] = s[j0-2] = g[j0-1] = SCORE_NONE;
+    for (int j = j0; j <= j1; j++) {
+      int score = SCORE_NONE;
+      if (j <= jm && lower[first + j] == c) {
+        const int bonus = position_bonus(name, first + j, file_name_start);
+        // First character counts double, as it is what the user is most deliberate about.
+        if (i == 0) score = SCORE_MATCH + 2 * bonus;
+        // Previous row is valid from lo[i-1], which is before j.
+        else score = max(prev_s[j-1] + BONUS_CONSECUTIVE, prev_g[j]) + SCORE_MATCH + bonus;
       }
+      s[j] = score;
+      g[j] = max(s[j-2] + SCORE_GAP_START, g[j-1] + SCORE_GAP_EXTENSION);
+    }
+    if (i == n - 1) {
+      for (int j = j0; j <= jm; j++) best = max(best, s[j]);
     }
-    if (!found) chosen.insert(chosen.begin(), ch);
+    std::swap(prev_s, s);
+    std::swap(prev_g, g);
   }
-  if (chosen.size() > MAX_NUM_CHOICES) {
-    chosen.pop_back();
+
+  // Subsequence check passed, so this cannot happen, but never report a match as a miss.
+  if (best < 0) best = 0;
+  return best;
+}
+
+ChoiceList::ChoiceList() : matching_valid(false), currently_chosen(0) {}
+
+float ChoiceList::calculate_score(const std::string& entry, const std::string& name) {
+  std::string lower_entry(entry), lower(name);
+  for (char& c : lower_entry) c = to_lower(c);
+  for (char& c : lower) c = to_lower(c);
+  return score_name(lower_entry, name.data(), lower.data(), name.size(),
+      find_file_name_start(name.data(), name.size()));
+}
+
+void ChoiceList::refilter_range(const std::string& entry, uint64_t entry_mask,
+    const std::vector<int>* candidates, int begin, int end, std::vector<int>& out_matching,
+    std::vector<Choice*>& out_best) {
+  // out_best is a heap with the worst of the best on top.
+  for (int k = begin; k < end; k++) {
+    const int index = candidates ? (*candidates)[k] : k;
+    const ChoiceKey& key = keys[index];
+    if ((key.char_mask & entry_mask) != entry_mask) continue;
+    const int score = score_name(entry, names.data() + key.offset, lower_names.data() + key.offset,
+        key.size, key.file_name_start);
+    if (score < 0) continue;
+    out_matching.push_back(index);
+
+    Choice& choice = choices[index];
+    choice.score = score;
+    if (out_best.size() < MAX_NUM_CHOICES) {
+      out_best.push_back(&choice);
+      std::push_heap(out_best.begin(), out_best.end(), is_better);
+    } else if (is_better(&choice, out_best.front())) {
+      std::pop_heap(out_best.begin(), out_best.end(), is_better);
+      out_best.back() = &choice;
+      std::push_heap(out_best.begin(), out_best.end(), is_better);
+    }
   }
 }
 
 void ChoiceList::refilter_choices(const std::string& entry) {
+  std::string lower_entry(entry);
+  for (char& c : lower_entry) c = to_lower(c);
+  if (lower_entry.empty()) {
+    order_choices();
+    return;
+  }
+
+  // Extending the entry can only remove matches.
+  const std::vector<int>* candidates = nullptr;
+  if (matching_valid && !last_entry.empty() && lower_entry.compare(0, last_entry.size(), last_entry) == 0) {
+    candidates = &matching;
+  }
+  const int num_candidates = candidates ? candidates->size() : choices.size();
+  const uint64_t entry_mask = calculate_char_mask(lower_entry.data(), lower_entry.size());
+
+  int num_threads = min<int>(std::thread::hardware_concurrency(), num_candidates / CHOICES_THREAD_CHUNK);
+  if (num_threads < 1) num_threads = 1;
+  std::vector<std::vector<int>> thread_matching(num_threads);
+  std::vector<std::vector<Choice*>> thread_best(num_threads);
+  std::vector<std::thread> threads;
+  const int chunk = (num_candidates + num_threads - 1) / num_threads;
+  for (int t = 1; t < num_threads; t++) {
+    threads.push_back(std::thread(&ChoiceList::refilter_range, this, std::cref(lower_entry), entry_mask,
+        candidates, t * chunk, min(num_candidates, (t + 1) * chunk), std::ref(thread_matching[t]),
+        std::ref(thread_best[t])));
+  }
+  refilter_range(lower_entry, entry_mask, candidates, 0, min(num_candidates, chunk), thread_matching[0],
+      thread_best[0]);
+  for (std::thread& thread : threads) thread.join();
+
   chosen.clear();
-  for (Choice& c : choices) {
-    c.score = calculate_score(entry, c.name);
-    insert_choice_into_chosen(&c);
+  std::vector<int> new_matching;
+  for (int t = 0; t < num_threads; t++) {
+    chosen.insert(chosen.end(), thread_best[t].begin(), thread_best[t].end());
+    new_matching.insert(new_matching.end(), thread_matching[t].begin(), thread_matching[t].end());
   }
+  std::sort(chosen.begin(), chosen.end(), is_better);
+  if (chosen.size() > MAX_NUM_CHOICES) chosen.resize(MAX_NUM_CHOICES);
+
+  matching.swap(new_matching);
+  matching_valid = true;
+  last_entry = lower_entry;
 }
 
 void ChoiceList::add_choice(const std::string& name, int i) {
   choices.push_back(Choice(name, i));
+
+  ChoiceKey key;
+  key.offset = names.size();
+  key.size = name.size();
+  key.file_name_start = find_file_name_start(name.data(), name.size());
+  names += name;
+  for (char c : name) lower_names += to_lower(c);
+  key.char_mask = calculate_char_mask(lower_names.data() + key.offset, key.size);
+  keys.push_back(key);
+  matching_valid = false;
+}
+
+void ChoiceList::clear() {
+  choices.clear();
+  chosen.clear();
+  keys.clear();
+  names.clear();
+  lower_names.clear();
+  matching.clear();
+  matching_valid = false;
+  last_entry.clear();
 }
 
 void ChoiceList::order_choices() {
-  int i = 1;
+  matching_valid = false;
+  last_entry.clear();
   chosen.clear();
   for (Choice& c : choices) {
+    if (chosen.size() >= MAX_NUM_CHOICES) return;
     chosen.push_back(&c);
-    i++;
-    if (i > MAX_NUM_CHOICES) return;
   }
-}
\ No newline at end of file
+}
@@ -5,32 +5,64 @@
 #include <string>
 #include <vector>
 
+/** Longer matches are not scored character by character, only filtered. */
 #define MAX_PATH_SIZE 500
+#define MAX_NUM_CHOICES 30
+/** Candidates are split across threads in chunks of at least this many. */
+#define CHOICES_THREAD_CHUNK 20000
 
 struct Choice {
   std::string name;
+  /** Higher is better. */
   float score;
   int num;
 
-  inline Choice(const std::string& n, int i) : name(n), num(i) {}
+  inline Choice(const std::string& n, int i) : name(n), score(0), num(i) {}
 };
 
+/** Fuzzy matching of an entry against many choices (such as paths).  A choice matches if it contains
+the characters of the entry in order, ignoring case.  Matches are scored with a DP that rewards
+matches at word and path boundaries, consecutive matches and matches in the file name, and
+penalizes gaps. */
 class ChoiceList {
 private:
-  int16_t levenshtein_buffer[MAX_PATH_SIZE*MAX_PATH_SIZE];
-  int comm1_buf[MAX_PATH_SIZE];
-  int comm2_buf[MAX_PATH_SIZE];
-  void insert_choice_into_chosen(Choice* ch);
+  /** What matching looks at, kept apart from choices and packed together so that a refilter walks
+  through contiguous memory. */
+  struct ChoiceKey {
+    uint64_t char_mask;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t file_name_start;
+  };
+  std::vector<ChoiceKey> keys;
+  /** Names of all choices, back to back, as given and lowercase. */
+  std::string names;
+  std::string lower_names;
+
+  /** Entry of the last refilter and indices of all choices that matched it.  If the entry is only
+  extended, only these need to be looked at. */
+  std::string last_entry;
+  std::vector<int> matching;
+  bool matching_valid;
+
+  /** Match entry against candidates[begin, end), collecting matching indices and the best few. */
+  void refilter_range(const std::string& entry, uint64_t entry_mask, const std::vector<int>* candidates,
+      int begin, int end, std::vector<int>& out_matching, std::vector<Choice*>& out_best);
 
 public:
+  /** Do not modify directly, use add_choice and clear. */
   std::vector<Choice> choices;
   std::vector<Choice*> chosen;
   int currently_chosen;
 
-  float calculate_score(const std::string& entry, const std::string& choice);
+  ChoiceList();
+
+  /** Score of name, or a negative number if it does not match.  Higher is better. */
+  static float calculate_score(const std::string& entry, const std::string& name);
   void refilter_choices(const std::string& entry);
   void order_choices();
   void add_choice(const std::string& name, int i);
+  void clear();
 };
 
-#endif
\ No newline at end of file
+#endif
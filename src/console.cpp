@@ -4,6 +4,9 @@
 #include "master_navigators.hpp"
 
 Console::Console() : line_view(line_buffer), current_history(0) {
+  const int depth = master.pref_manager.get_int("console.scrollback_lines");
+  if (depth > 0) text_buffer.set_depth(depth);
+  text_buffer.set_spill(master.pref_manager.get_bool("console.spill_scrollback"));
   text_end = text_buffer.cursor_end_buffer();
   prompt = " > ";
 }
@@ -54,8 +57,18 @@ std::string Console::get_short_title() const {
   return "Console";
 }
 
+std::string Console::get_full_history() const {
+  return text_buffer.get_full_history();
+}
+
 void Console::console_output(const std::string& contents, uint8_t markup) {
-  text_buffer.trim_lines_to_size(1000);
+  std::vector<ConsoleRun> runs;
+  runs.push_back({ contents, markup });
+  console_output_runs(runs);
+}
+
+void Console::console_output_runs(const std::vector<ConsoleRun>& runs) {
+  if (runs.empty()) return;
 
   // Trim the line
   {
@@ -67,8 +80,11 @@ void Console::console_output(const std::string& contents, uint8_t markup) {
 
   {
     SimpleTextEdit ste(text_buffer);
-    ste.insert_text(text_buffer.cursor_end_buffer(), contents, markup);
+    for (const ConsoleRun& run : runs) {
+      ste.insert_text(text_buffer.cursor_end_buffer(), run.text, run.markup);
+    }
   }
+  text_buffer.evict();
   text_end = text_buffer.cursor_end_buffer();
 
   // Append back the line
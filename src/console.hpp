@@ -2,16 +2,24 @@
 #define SYNTAXIC_CONSOLE_HPP
 
 #include "core/common.hpp"
+#include "core/scrollback_buffer.hpp"
 #include "core/text_buffer.hpp"
 #include "core/text_view.hpp"
 #include "doc.hpp"
 
+#include <string>
 #include <vector>
 
+/** A piece of console output with uniform markup. */
+struct ConsoleRun {
+  std::string text;
+  uint8_t markup;
+};
+
 class Console : public Doc {
 private:
 
-  TextBuffer text_buffer;
+  ScrollbackBuffer text_buffer;
   TextBuffer line_buffer;
   TextView line_view;
   CursorLocation text_end;
@@ -49,7 +57,11 @@ public:
   // Our:
 
   void console_output(const std::string& contents, uint8_t markup=0);
+  /** Output several runs at once, the prompt is redrawn and hooks are called only once. */
+  void console_output_runs(const std::vector<ConsoleRun>& runs);
   virtual void console_input(const std::string& contents);
+  /** Return all output, including lines spilled out of the scrollback. */
+  std::string get_full_history() const;
 
   // Optional functions
 
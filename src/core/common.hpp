@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
 
 /** Character in a line. */
 struct Character {
@@ -81,6 +82,12 @@ struct CursorLocation {
   }
 };
 
+/** Replace text between start and end with text. */
+struct TextReplacement {
+  CursorLocation start, end;
+  std::string text;
+};
+
 struct SearchResult {
   int row, col, size;
 
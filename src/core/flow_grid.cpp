@@ -7,46 +7,26 @@
 FlowGrid::FlowGrid() : text_buffer(nullptr), x_width(1), tab_width(4), line_height(10), folded_line_height(2), word_wrap_width(-1), word_wrap_indent(4), x_offset(0), fast_reflow(false), output_width(10), output_height(10) {}
 
 int FlowGrid::get_line_indent(const Line& line) const {
-  int indent = 0;
-  for (unsigned int j = 0; j < line.size(); j++) {
-    const uint32_t ch = line.get_char(j).c;
-    if (ch == '\t') indent += tab_width;
-    else if (ch == ' ') indent += x_width;
-    else break;
-  }
-  return indent;
-}
-
-int FlowGrid::get_word_width(const Line& line, int start_col) const {
-  int width = 0;
-  {
-    const uint32_t ch = line.get_char(start_col).c;
-    if (ch == '\t') return tab_width;
-    if (isalnum(ch) || ch == '_') {
-      width += x_width;
-    } else {
-      return x_width;
-    }
-  }
-  for (unsigned int j = start_col+1; j < line.size(); j++) {
-    const uint32_t ch = line.get_char(j).c;
-    if (isalnum(ch) || ch == '_') {
-      width += x_width;
-    } else break;
-  }
-  return width;
+  const Indentation ind = line.get_indentation();
+  return ind.num_tabs * tab_width + ind.num_spaces * x_width;
+}
+
+static inline bool is_word_char(uint32_t ch) {
+  return isalnum(ch) || ch == '_';
 }
 
 /** Note, word_wrap_width is in pixels, and so are all the widths below. */
 void FlowGrid::reflow() {
   rows.clear();
-  elements.clear();
+  breaks.clear();
+  tabs.clear();
   output_width = 0;
 
   const bool wrap = word_wrap_width > 40;
   int current_y = 0;
   for (int i = 0; i < text_buffer->get_num_lines(); i++) {
     const Line& line = text_buffer->get_line(i);
+    const int size = int(line.size());
     int current_x = x_offset;
 
     int line_indent = 0;
@@ -56,71 +36,105 @@ void FlowGrid::reflow() {
       if (line_indent > word_wrap_width - 12*x_width) line_indent = 0;
     }
 
-    // Number of effective rows for this row.
-    int num_effective_rows = 1;
-
     FlowGridRow fgr;
-    fgr.index = int(elements.size());
     fgr.start_y = current_y;
-    fgr.row_length = int(line.size());
+    fgr.row_length = size;
+    fgr.first_break = int(breaks.size());
+    fgr.first_tab = int(tabs.size());
     // Total row height must be computed at the end.
     const int char_height = line.appendage().folded ? folded_line_height : line_height;
 
-    for (unsigned int j = 0; j < line.size(); j++) {
+    // End of the word being laid out, words are measured once at their first character.
+    int word_end = 0;
+    for (int j = 0; j < size; j++) {
       const uint32_t ch = line.get_char(j).c;
       const int char_width = (ch == '\t') ? tab_width : x_width;
+      if (ch == '\t') tabs.push_back(j);
 
       if (wrap) {
-        int word_width;
-        if (fast_reflow) word_width = 1;
-        else word_width = get_word_width(line, j);
+        // Width of the rest of the word starting at j.
+        int word_width = char_width;
+        if (fast_reflow) {
+          word_width = 1;
+        } else if (is_word_char(ch)) {
+          if (j >= word_end) {
+            word_end = j + 1;
+            while (word_end < size && is_word_char(line.get_char(word_end).c)) word_end++;
+          }
+          word_width = (word_end - j)*x_width;
+        }
 
+        bool wrap_here;
         if (word_width > word_wrap_width) {
           // This is a really, _really_ long word.
-          if (current_x + char_width > word_wrap_width) {
-            current_x = x_offset + line_indent;
-            num_effective_rows += 1;
-            current_y += char_height;
-          }
-        } else if (current_x + word_width > word_wrap_width) {
+          wrap_here = current_x + char_width > word_wrap_width;
+        } else {
+          wrap_here = current_x + word_width > word_wrap_width;
+        }
+        if (wrap_here) {
           current_x = x_offset + line_indent;
-          num_effective_rows += 1;
-          current_y += char_height;
+          breaks.push_back({ j, line_indent });
         }
       }
 
-      FlowGridElement fge;
-      fge.coordinate.x = current_x;
-      fge.coordinate.y = current_y;
-      fge.width = (uint8_t) char_width;
-      elements.push_back(fge);
-
       current_x += char_width;
     }
     if (current_x > output_width) output_width = current_x;
-    current_y += char_height;
 
-    fgr.row_height = num_effective_rows*char_height;
-    fgr.num_effective_rows = num_effective_rows;
+    fgr.num_effective_rows = 1 + int(breaks.size()) - fgr.first_break;
+    fgr.num_tabs = int(tabs.size()) - fgr.first_tab;
+    fgr.row_height = fgr.num_effective_rows*char_height;
+    current_y += fgr.row_height;
     rows.push_back(fgr);
   }
   if (wrap) output_width = word_wrap_width;
   output_height = current_y;
 }
 
+int FlowGrid::get_segment(const FlowGridRow& fgr, int col) const {
+  // Breaks are ordered by column, count the ones at or before col.
+  const auto first = breaks.begin() + fgr.first_break;
+  const auto last = first + (fgr.num_effective_rows - 1);
+  return std::upper_bound(first, last, col,
+      [](int c, const FlowGridBreak& b) { return c < b.col; }) - first;
+}
+
+int FlowGrid::count_tabs(const FlowGridRow& fgr, int col) const {
+  if (fgr.num_tabs == 0) return 0;
+  const auto first = tabs.begin() + fgr.first_tab;
+  return std::lower_bound(first, first + fgr.num_tabs, col) - first;
+}
+
+int FlowGrid::get_segment_first(const FlowGridRow& fgr, int segment) const {
+  if (segment == 0) return 0;
+  return breaks[fgr.first_break + segment - 1].col;
+}
+
+int FlowGrid::get_segment_last(const FlowGridRow& fgr, int segment) const {
+  if (segment == fgr.num_effective_rows - 1) return fgr.row_length;
+  return breaks[fgr.first_break + segment].col;
+}
+
+int FlowGrid::get_segment_x(const FlowGridRow& fgr, int segment, int col) const {
+  const int first = get_segment_first(fgr, segment);
+  const int x = segment == 0 ? 0 : breaks[fgr.first_break + segment - 1].x;
+  const int num_tabs = count_tabs(fgr, col) - count_tabs(fgr, first);
+  return x_offset + x + (col - first)*x_width + num_tabs*(tab_width - x_width);
+}
+
 RowInfo FlowGrid::get_row_info(int row) const {
   if (row < 0 || rows.empty()) {
     printf("Warning: row < 0 in get_row_info.\n");
-    return { 0, row*line_height, line_height, 1, 0 };
+    return { row*line_height, line_height, 1, 0 };
   }
   if (row >= int(rows.size())) {
     printf("Warning: row too big in get_row_info.\n");
     const int last = rows.back().start_y + rows.back().row_height;
-    return { int(elements.size()), last + (row - int(rows.size()))*line_height, line_height, 1, 0 };
+    return { last + (row - int(rows.size()))*line_height, line_height, 1, 0 };
   }
 
   const FlowGridRow& fgr = rows[row];
-  return { fgr.index, fgr.start_y, fgr.row_height, fgr.num_effective_rows, fgr.row_length };
+  return { fgr.start_y, fgr.row_height, fgr.num_effective_rows, fgr.row_length };
 }
 
 FlowGridElement FlowGrid::map_to_element(int row, int col) const {
@@ -138,12 +152,13 @@ FlowGridElement FlowGrid::map_to_element(int row, int col) const {
   if (col < 0 || fgr.row_length == 0) {
     return { x_offset + col*x_width, fgr.start_y, uint8_t(x_width) };
   }
-  if (col >= fgr.row_length) {
-    const FlowGridElement& last_fge = elements[fgr.index + fgr.row_length-1];
-    return { last_fge.coordinate.x + last_fge.width + (col - fgr.row_length)*x_width, last_fge.coordinate.y, uint8_t(x_width) };
-  }
-  const FlowGridElement& fge = elements[fgr.index + col];
-  return fge;
+  // Past the end of the row, columns continue the last effective row.
+  const int segment = get_segment(fgr, col);
+  const int irh = fgr.row_height / fgr.num_effective_rows;
+  const bool tab = col < fgr.row_length && fgr.num_tabs > 0
+      && std::binary_search(tabs.begin() + fgr.first_tab, tabs.begin() + fgr.first_tab + fgr.num_tabs, col);
+  return { get_segment_x(fgr, segment, col), fgr.start_y + segment*irh,
+      uint8_t(tab ? tab_width : x_width) };
 }
 
 Coordinate FlowGrid::map_to_coordinate(int row, int col) const {
@@ -159,29 +174,26 @@ int FlowGrid::map_to_y(int row, int col) const {
   return map_to_coordinate(row, col).y;
 }
 
-struct FlowGridElementComparator {
-  bool operator() (const FlowGridElement& left, const FlowGridElement& right) {
-    return left.coordinate.y < right.coordinate.y;
-  }
-};
-
 int FlowGrid::get_row_index_of_effective_row(int x, int row, int eff_row) const {
   const EffRowInfo eri = get_effective_row_info(row, eff_row);
-  for (int index = eri.first_index; index < eri.last_index; index++) {
-    if (elements[eri.row_index + index].coordinate.x >= x) {
-      return index;
-    }
+  if (eri.first_index >= eri.last_index) return eri.last_index;
+
+  // X grows along an effective row, find the first column at or past x.
+  const FlowGridRow& fgr = rows[row];
+  int lo = eri.first_index, hi = eri.last_index;
+  while (lo < hi) {
+    const int mid = (lo + hi) / 2;
+    if (get_segment_x(fgr, eff_row, mid) >= x) hi = mid;
+    else lo = mid + 1;
   }
-  return eri.last_index;
+  return lo;
 }
 
 int FlowGrid::get_effective_row(int row, int col) const {
   if (col <= 0) return 0;
   const RowInfo ri = get_row_info(row);
   if (col >= ri.length) return ri.num_effective_rows - 1;
-  const int ty = elements[ri.index + col].coordinate.y;
-  const int irh = ri.height / ri.num_effective_rows;
-  return (ty - ri.y) / irh;
+  return get_segment(rows[row], col);
 }
 
 EffRowInfo FlowGrid::get_effective_row_info(int row, int eff_row) const {
@@ -196,36 +208,38 @@ EffRowInfo FlowGrid::get_effective_row_info(int row, int eff_row) const {
     printf("Warning: eff_row >= num_ers\n");
     eri = {0, 0, 0, 0, 0};
     return eri;
+  } else if (row < 0 || row >= int(rows.size())) {
+    eri = {0, 0, 0, 0, 0};
+    return eri;
   }
 
   // Individual row height:
   const int irh = ri.height / ri.num_effective_rows;
-  eri.row_index = ri.index;
+  eri.row = row;
   eri.height = irh;
   eri.y = ri.y + irh*eff_row;
-  const int start_index = rows[row].index;
-  const int end_index = start_index + rows[row].row_length;
-  const FlowGridElement dummy_fge = { {0, eri.y}, 0 };
-  eri.first_index = std::lower_bound(elements.begin() + start_index, elements.begin() + end_index, dummy_fge, FlowGridElementComparator()) - elements.begin() - eri.row_index;
-  eri.last_index = std::upper_bound(elements.begin() + start_index, elements.begin() + end_index, dummy_fge, FlowGridElementComparator()) - elements.begin() - eri.row_index;
+  eri.first_index = get_segment_first(rows[row], eff_row);
+  eri.last_index = get_segment_last(rows[row], eff_row);
 
   return eri;
 }
 
 int FlowGrid::get_effective_row_left_margin(const EffRowInfo& eri) const {
-  return elements[eri.row_index + eri.first_index].coordinate.x;
+  return map_to_x(eri.row, eri.first_index);
 }
 
 int FlowGrid::get_effective_row_right_margin(const EffRowInfo& eri) const {
-  return elements[eri.row_index + eri.last_index-1].coordinate.x + elements[eri.last_index-1].width;
+  if (eri.last_index <= eri.first_index) return get_effective_row_left_margin(eri);
+  const FlowGridElement fge = map_to_element(eri.row, eri.last_index - 1);
+  return fge.coordinate.x + fge.width;
 }
 
 int FlowGrid::unmap_row(int y) const {
-  for (int row = 0; row < int(rows.size()); row++) {
-    const FlowGridRow& fgr = rows[row];
-    if (fgr.start_y + fgr.row_height >= y) return row;
-  }
-  return rows.size() - 1;
+  // Bottoms of rows only grow, find the first one reaching y.
+  auto it = std::lower_bound(rows.begin(), rows.end(), y,
+      [](const FlowGridRow& fgr, int y) { return fgr.start_y + fgr.row_height < y; });
+  if (it == rows.end()) return rows.size() - 1;
+  return it - rows.begin();
 }
 
 CursorLocation FlowGrid::unmap(int x, int y) const {
@@ -235,14 +249,19 @@ CursorLocation FlowGrid::unmap(int x, int y) const {
 
   const FlowGridRow& fgr = rows[row];
   const int row_height = fgr.row_height / fgr.num_effective_rows;
-  for (int col = 0; col < fgr.row_length; col++) {
-    const FlowGridElement& fge = elements[fgr.index + col];
-    if (x < fge.coordinate.x + x_width/2) {
-      if (y <= fge.coordinate.y + row_height) {
-        return CursorLocation(row, col);
-      }
+  for (int segment = 0; segment < fgr.num_effective_rows; segment++) {
+    // Effective row is above y.
+    if (y > fgr.start_y + (segment + 1)*row_height) continue;
+
+    int lo = get_segment_first(fgr, segment), hi = get_segment_last(fgr, segment);
+    const int last = hi;
+    while (lo < hi) {
+      const int mid = (lo + hi) / 2;
+      if (x < get_segment_x(fgr, segment, mid) + x_width/2) hi = mid;
+      else lo = mid + 1;
     }
+    if (lo < last) return CursorLocation(row, lo);
   }
 
   return CursorLocation(row, fgr.row_length);
-}
\ No newline at end of file
+}
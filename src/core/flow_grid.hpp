@@ -3,6 +3,7 @@
 
 #include "core/common.hpp"
 #include "core/line.hpp"
+#include "core/memory_usage.hpp"
 
 #include <cstdint>
 #include <vector>
@@ -10,11 +11,23 @@
 class TextBuffer;
 
 struct FlowGridRow {
-  int index;
   int start_y;
   int row_height;
   int row_length;
   int num_effective_rows;
+  /** Effective rows after the first start at breaks[first_break] onwards. */
+  int first_break;
+  /** Columns holding tabs are tabs[first_tab] through tabs[first_tab + num_tabs - 1]. */
+  int first_tab;
+  int num_tabs;
+};
+
+/** Start of an effective row of a wrapped row. */
+struct FlowGridBreak {
+  // First column on the effective row.
+  int col;
+  // Its x, not counting x_offset.
+  int x;
 };
 
 struct FlowGridElement {
@@ -23,8 +36,6 @@ struct FlowGridElement {
 };
 
 struct RowInfo {
-  // Index of first element
-  int index;
   // Top, in pixels
   int y;
   // Total height in pixels
@@ -38,21 +49,32 @@ struct RowInfo {
 struct EffRowInfo {
   int y;
   int height;
-  // Index of the whole row.
-  int row_index;
+  // The whole row.
+  int row;
   // First index of this effective row (from start of row).
   int first_index;
   // Last index of this effective row (exclusive).
   int last_index;
 };
 
+/** Lays out a text buffer in pixels.  Rows keep only where they wrap and where their tabs are,
+coordinates of columns are computed from those. */
 class FlowGrid {
 private:
   std::vector<FlowGridRow> rows;
-  std::vector<FlowGridElement> elements;
+  std::vector<FlowGridBreak> breaks;
+  std::vector<int> tabs;
 
   int get_line_indent(const Line& line) const;
-  int get_word_width(const Line& line, int start_col) const;
+  /** Effective row that col of the row is on. */
+  int get_segment(const FlowGridRow& fgr, int col) const;
+  /** Number of tabs in columns [0, col) of the row. */
+  int count_tabs(const FlowGridRow& fgr, int col) const;
+  /** X of col on effective row segment of the row. */
+  int get_segment_x(const FlowGridRow& fgr, int segment, int col) const;
+  /** Column range [first, last) of effective row segment of the row. */
+  int get_segment_first(const FlowGridRow& fgr, int segment) const;
+  int get_segment_last(const FlowGridRow& fgr, int segment) const;
 
 public:
   FlowGrid();
@@ -91,6 +113,12 @@ public:
   /** Once your inputs are set up, you can call reflow() and read outputs. */
   void reflow();
 
+  /** Bytes held by the grid. */
+  inline size_t get_memory_usage() const {
+    return rows.capacity() * sizeof(FlowGridRow) + breaks.capacity() * sizeof(FlowGridBreak)
+        + tabs.capacity() * sizeof(int);
+  }
+
 
   //////////   Outputs for flowing
 
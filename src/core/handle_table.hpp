@@ -0,0 +1,74 @@
+#ifndef SYNTAXIC_CORE_HANDLE_TABLE_HPP
+#define SYNTAXIC_CORE_HANDLE_TABLE_HPP
+
+#include <unordered_map>
+#include <vector>
+
+/** Bits of a handle which hold the slot index, the rest hold the generation of the slot. */
+#define HANDLE_INDEX_BITS 16
+#define HANDLE_INDEX_MASK ((1 << HANDLE_INDEX_BITS) - 1)
+/** Generations wrap around below this, so that handles are always positive ints. */
+#define HANDLE_MAX_GENERATION ((1 << (31 - HANDLE_INDEX_BITS)) - 1)
+
+/** Hands out integer handles for pointers that are safe to give to code that may outlive the
+objects, such as plugins.  Both lookups are O(1).  A slot is reused once its object is removed, but
+with a new generation, so a stale handle resolves to nullptr rather than to another object. */
+template <typename T>
+class HandleTable {
+private:
+  struct Slot {
+    T* ptr;
+    int generation;
+  };
+  std::vector<Slot> slots;
+  std::vector<int> free_slots;
+  std::unordered_map<T*, int> handles;
+
+public:
+  /** Handle of ptr, assigning one if it has none yet.  Returns -1 if the table is full. */
+  int get_handle(T* ptr) {
+    if (ptr == nullptr) return -1;
+    auto it = handles.find(ptr);
+    if (it != handles.end()) return it->second;
+
+    int index;
+    if (!free_slots.empty()) {
+      index = free_slots.back();
+      free_slots.pop_back();
+    } else {
+      if (slots.size() > HANDLE_INDEX_MASK) return -1;
+      index = slots.size();
+      slots.push_back({nullptr, 0});
+    }
+    Slot& slot = slots[index];
+    slot.ptr = ptr;
+    slot.generation = slot.generation >= HANDLE_MAX_GENERATION ? 1 : slot.generation + 1;
+    const int handle = (slot.generation << HANDLE_INDEX_BITS) | index;
+    handles[ptr] = handle;
+    return handle;
+  }
+
+  /** Object of the handle, or nullptr if it has been removed. */
+  T* get(int handle) const {
+    if (handle < 0) return nullptr;
+    const unsigned int index = handle & HANDLE_INDEX_MASK;
+    if (index >= slots.size()) return nullptr;
+    const Slot& slot = slots[index];
+    if (slot.generation != (handle >> HANDLE_INDEX_BITS)) return nullptr;
+    return slot.ptr;
+  }
+
+  /** Invalidate the handle of ptr, if it has one. */
+  void remove(T* ptr) {
+    auto it = handles.find(ptr);
+    if (it == handles.end()) return;
+    const int index = it->second & HANDLE_INDEX_MASK;
+    slots[index].ptr = nullptr;
+    free_slots.push_back(index);
+    handles.erase(it);
+  }
+
+  inline unsigned int size() const { return handles.size(); }
+};
+
+#endif
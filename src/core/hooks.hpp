@@ -1,9 +1,22 @@
 #ifndef SYNTAXIC_CORE_HOOKS_HPP
 #define SYNTAXIC_CORE_HOOKS_HPP
 
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
+#include <string>
+
+/** Time spent in the callbacks of a subscriber. */
+struct HookStats {
+  unsigned int num_calls;
+  double total_time, max_time;
+
+  HookStats() : num_calls(0), total_time(0), max_time(0) {}
+};
+
+/** Subscriber name to its stats, filled in by hook sources that are given one. */
+typedef std::map<std::string, HookStats> HookProfile;
 
 template <typename ... Args>
 class HookSource;
@@ -66,24 +79,51 @@ private:
   std::shared_ptr<HookSource<Args ...>*> marker;
 
   std::map<int, Callback> callbacks;
+  std::map<int, std::string> names;
+  HookProfile* profile;
 
 public:
-  HookSource() : counter(0), marker(std::make_shared<HookSource<Args ...>*>(this)) {}
+  HookSource() : counter(0), marker(std::make_shared<HookSource<Args ...>*>(this)), profile(nullptr) {}
 
-  Hook<Args...> add(Callback callback) {
+  /** name identifies the subscriber in the profile, subscribers may share a name. */
+  Hook<Args...> add(Callback callback, const std::string& name = "") {
     counter++;
     callbacks[counter] = callback;
+    if (!name.empty()) names[counter] = name;
     return Hook<Args...>(counter, marker);
   }
-  
+
+  /** Record time spent in each subscriber into profile (or stop, if nullptr). */
+  void set_profile(HookProfile* p) { profile = p; }
+
   void call(Args ... args) {
-    for (auto& p : callbacks) {
-      p.second(args ...);
+    if (profile == nullptr) {
+      for (auto& p : callbacks) {
+        p.second(args ...);
+      }
+      return;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    for (auto it = callbacks.begin(); it != callbacks.end(); ) {
+      const int id = it->first;
+      const Clock::time_point start = Clock::now();
+      it->second(args ...);
+      const double time = std::chrono::duration<double>(Clock::now() - start).count();
+
+      auto name = names.find(id);
+      HookStats& stats = (*profile)[name == names.end() ? "(unnamed)" : name->second];
+      stats.num_calls++;
+      stats.total_time += time;
+      if (time > stats.max_time) stats.max_time = time;
+      // The callback may have removed itself.
+      it = callbacks.upper_bound(id);
     }
   }
-  
+
   void delete_hook(int id) {
     callbacks.erase(id);
+    names.erase(id);
   }
   
   int num_hooks() {
@@ -4,20 +4,22 @@
 #include <stdexcept>
 #include "utf8.h"
 
-Line::Line(const char* buf, int line_len) {
+Line::Line(const char* buf, int line_len) : line_info_valid(false) {
   append(buf, line_len);
 }
 
-Line::Line(const std::string& s) {
+Line::Line(const std::string& s) : line_info_valid(false) {
   append(s);
 }
 
-Line::Line() {
+Line::Line() : line_info_valid(false) {
 }
 
 void Line::from_line(const Line& other) {
   contents = other.contents;
   line_appendage = other.line_appendage;
+  line_info = other.line_info;
+  line_info_valid = other.line_info_valid;
 }
 
 void Line::check_index(int i) const {
@@ -27,6 +29,7 @@ void Line::check_index(int i) const {
 #define CHECK(i)   check_index(i)
 
 void Line::append(char32_t ch, uint8_t markup) {
+  invalidate_info();
   contents.push_back(Character(ch, markup));
 }
 
@@ -39,6 +42,7 @@ void Line::append(const char* s, uint8_t markup) {
 }
 
 void Line::append(const char* s, int sz, uint8_t markup) {
+  invalidate_info();
   const char* end = s + sz;
   while (s != end) {
     uint32_t c = utf8::next(s, end);
@@ -46,8 +50,16 @@ void Line::append(const char* s, int sz, uint8_t markup) {
   }
 }
 
+void Line::append(const Line& other, int index0, int index1) {
+  other.check_index(index0);
+  other.check_index(index1);
+  invalidate_info();
+  contents.insert(contents.end(), other.contents.begin() + index0, other.contents.begin() + index1);
+}
+
 void Line::insert(int index, char32_t ch, uint8_t markup) {
   CHECK(index);
+  invalidate_info();
   contents.insert(contents.begin() + index, Character(ch, markup));
 }
 
@@ -61,38 +73,48 @@ void Line::insert(int index, const char* s, uint8_t markup) {
 
 void Line::insert(int index, const char* s, int sz, uint8_t markup) {
   CHECK(index);
+  // Decode first so that the tail of the line is moved only once.
+  std::vector<Character> chars;
+  chars.reserve(sz);
   const char* end = s + sz;
   while (s != end) {
     uint32_t c = utf8::next(s, end);
-    contents.insert(contents.begin() + index, Character(c, markup));
-    index++;
+    chars.push_back(Character(c, markup));
   }
+  invalidate_info();
+  contents.insert(contents.begin() + index, chars.begin(), chars.end());
 }
 
 void Line::remove(int index) {
   CHECK(index);
+  invalidate_info();
   contents.erase(contents.begin() + index);
 }
 
 void Line::remove(int index0, int index1) {
   CHECK(index0);
   CHECK(index1);
+  invalidate_info();
   contents.erase(contents.begin() + index0, contents.begin() + index1);
 }
 
+void Line::split(int index, Line& tail) {
+  CHECK(index);
+  invalidate_info();
+  tail.invalidate_info();
+  tail.contents.insert(tail.contents.end(), contents.begin() + index, contents.end());
+  contents.erase(contents.begin() + index, contents.end());
+}
+
 void Line::trim(int index) {
   CHECK(index);
+  invalidate_info();
   contents.erase(contents.begin() + index, contents.end());
 }
 
 int Line::get_start() const {
-  for (unsigned int i = 0; i < contents.size(); i++) {
-    const Character& c = contents[i];
-    if (c.c != ' ' && c.c != '\t') {
-      return i;
-    }
-  }
-  return contents.size();
+  const Indentation& ind = info().indentation;
+  return ind.num_tabs + ind.num_spaces;
 }
 
 int Line::get_end() const {
@@ -116,15 +138,22 @@ std::string Line::to_string(int index0, int index1) const {
 }
 
 std::string Line::to_string() const {
-  return to_string(0, size());
+  std::string s;
+  s.reserve(contents.size());
+  append_utf8(s);
+  return s;
 }
 
-bool Line::is_whitespace() const {
-  for (unsigned int i = 0; i < contents.size(); i++) {
-    const Character& cc = contents[i];
-    if (cc.c != ' ' && cc.c != '\t') return false;
+void Line::append_utf8(std::string& out) const {
+  for (const Character& cc : contents) {
+    const uint32_t c = cc.c;
+    if (c < 0x80) out += char(c);
+    else utf8::append(c, std::back_inserter(out));
   }
-  return true;
+}
+
+bool Line::is_whitespace() const {
+  return info().whitespace;
 }
 
 int Line::num_real_chars() const {
@@ -137,11 +166,7 @@ int Line::num_real_chars() const {
 }
 
 bool Line::is_non_word() const {
-  for (unsigned int i = 0; i < contents.size(); i++) {
-    const Character& cc = contents[i];
-    if (isalnum(cc.c) || cc.c == '_') return false;
-  }
-  return true;
+  return info().non_word;
 }
 
 void Line::trim_whitespace() {
@@ -152,19 +177,31 @@ void Line::trim_whitespace() {
 
 void Line::trim_r() {
   if (!contents.empty() && contents.back().c == '\r') {
+    invalidate_info();
     contents.pop_back();
   }
 }
 
-Indentation Line::get_indentation() const {
-  Indentation ind = {0, 0};
+void Line::update_info() const {
+  LineInfo& li = line_info;
+  li.indentation.num_tabs = li.indentation.num_spaces = 0;
+  li.whitespace = true;
+  li.non_word = true;
   for (unsigned int i = 0; i < contents.size(); i++) {
-    const Character& cc = contents[i];
-    if (cc.c == ' ') ind.num_spaces++;
-    else if (cc.c == '\t') ind.num_tabs++;
-    else return ind;
+    const char32_t c = contents[i].c;
+    if (c == ' ') {
+      if (li.whitespace) li.indentation.num_spaces++;
+    } else if (c == '\t') {
+      if (li.whitespace) li.indentation.num_tabs++;
+    } else {
+      li.whitespace = false;
+      if (isalnum(c) || c == '_') {
+        li.non_word = false;
+        break;
+      }
+    }
   }
-  return ind;
+  line_info_valid = true;
 }
 
 void Line::search(const std::string& term, std::vector<SearchResult>& results, int line_num,
@@ -21,12 +21,28 @@ struct Indentation {
   int num_tabs, num_spaces;
 };
 
+/** Facts about a line that folding, indenting and wrapping ask for over and over. Line caches
+them until its characters change. */
+struct LineInfo {
+  /** Leading whitespace. */
+  Indentation indentation;
+  /** Line is purely whitespace. */
+  bool whitespace;
+  /** Line consists purely of non-word characters. */
+  bool non_word;
+};
+
 class Line {
 private:
   std::vector<Character> contents;
   void check_index(int i) const;
 
   LineAppendage line_appendage;
+
+  mutable LineInfo line_info;
+  mutable bool line_info_valid;
+  void update_info() const;
+  inline void invalidate_info() { line_info_valid = false; }
 public:
   Line();
   Line(const std::string& s);
@@ -38,13 +54,14 @@ public:
   Line& operator=(const Line&) = delete;
 
   // Move:
-  Line(const Line&& other) {
+  Line(Line&& other) noexcept : contents(std::move(other.contents)),
+      line_appendage(std::move(other.line_appendage)), line_info(other.line_info),
+      line_info_valid(other.line_info_valid) {}
+  Line& operator=(Line&& other) noexcept {
 	  contents = std::move(other.contents);
-	  line_appendage = other.line_appendage;
-  }
-  Line& operator=(const Line&& other) {
-	  contents = std::move(other.contents);
-	  line_appendage = other.line_appendage;
+	  line_appendage = std::move(other.line_appendage);
+	  line_info = other.line_info;
+	  line_info_valid = other.line_info_valid;
 	  return *this;
   }
 
@@ -54,8 +71,15 @@ public:
   // Access
 
   inline size_t size() const { return contents.size(); }
+  /** Characters allocated, see optimize_size(). */
+  inline size_t capacity() const { return contents.capacity(); }
   inline LineAppendage& appendage() { return line_appendage; }
   inline const LineAppendage& appendage() const { return line_appendage; }
+  /** Cached facts about the line, recomputed on first use after an edit. */
+  inline const LineInfo& info() const {
+    if (!line_info_valid) update_info();
+    return line_info;
+  }
   inline Character& get_char(int index) { return contents.at(index); }
   inline const Character& get_char(int index) const { return contents.at(index); }
   /** Get the start of the line, i.e. skip all whitespace at the start of the line. In case of
@@ -67,6 +91,8 @@ public:
   /** Get contents as a UTF8 string. */
   std::string to_string() const;
   std::string to_string(int index0, int index1) const;
+  /** Append contents as UTF8 to out, cheaper than to_string() when out is reused. */
+  void append_utf8(std::string& out) const;
   /** Is line purely whitespace? */
   bool is_whitespace() const;
   /** Number of real, i.e. non-whitespace, characters in a line. */
@@ -80,12 +106,16 @@ public:
   void append(const std::string& other, uint8_t markup=0);
   void append(const char* s, uint8_t markup=0);
   void append(const char* s, int sz, uint8_t markup=0);
+  /** Append characters index0 through index1 of other, keeping their markup. */
+  void append(const Line& other, int index0, int index1);
   void insert(int index, char32_t c, uint8_t markup=0);
   void insert(int index, const std::string& other, uint8_t markup=0);
   void insert(int index, const char* s, uint8_t markup=0);
   void insert(int index, const char* s, int sz, uint8_t markup=0);
   void remove(int index);
   void remove(int index0, int index1);
+  /** Move everything from index on to the end of tail. */
+  void split(int index, Line& tail);
 
   /** Delete line after index. */
   void trim(int index);
@@ -93,7 +123,7 @@ public:
   void trim_whitespace();
   /** Trim '\r' off the end (if any). */
   void trim_r();
-  Indentation get_indentation() const;
+  inline Indentation get_indentation() const { return info().indentation; }
   inline void optimize_size() { contents.shrink_to_fit(); }
 
   /** Search. If word == true, then the results must be whole words. */
@@ -0,0 +1,55 @@
+#ifndef SYNTAXIC_CORE_MEMORY_USAGE_HPP
+#define SYNTAXIC_CORE_MEMORY_USAGE_HPP
+
+#include <cstddef>
+#include <string>
+
+/** Subsystems holding memory on behalf of a document. */
+enum MemorySubsystem {
+  MEM_TEXT,
+  MEM_LINE_TOKENS,
+  MEM_UNDO,
+  MEM_STATLANG_TOKENS,
+  MEM_STATLANG_BLOCKS,
+  MEM_SYMBOL_DB,
+  MEM_FLOW_GRID,
+  MEM_FOLD_IMAGES,
+  MEM_NUM_SUBSYSTEMS
+};
+
+/** Estimated bytes held by each subsystem.  Estimates count what containers have allocated, not
+allocator overhead. */
+struct MemoryUsage {
+  size_t bytes[MEM_NUM_SUBSYSTEMS];
+
+  inline MemoryUsage() : bytes() {}
+
+  inline size_t total() const {
+    size_t sum = 0;
+    for (size_t b : bytes) sum += b;
+    return sum;
+  }
+
+  inline MemoryUsage& operator+=(const MemoryUsage& other) {
+    for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) bytes[i] += other.bytes[i];
+    return *this;
+  }
+
+  /** Short name, also used as the key in JS. */
+  static inline const char* get_name(int subsystem) {
+    static const char* names[MEM_NUM_SUBSYSTEMS] = {
+      "text", "lineTokens", "undo", "statlangTokens", "statlangBlocks", "symbolDb", "flowGrid",
+      "foldImages"
+    };
+    return names[subsystem];
+  }
+};
+
+/** Bytes allocated by a string, 0 if it fits in the string itself. */
+inline size_t heap_bytes(const std::string& s) {
+  const char* inside = reinterpret_cast<const char*>(&s);
+  if (s.data() >= inside && s.data() < inside + sizeof(std::string)) return 0;
+  return s.capacity() + 1;
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "core/perf.hpp"
+
+#include <cstdio>
+#include <map>
+
+Perf perf;
+
+static const char* perf_names[PERF_NUM_COUNTERS] = {
+  "Paint", "Reflow", "Process document", "Highlight", "Document events"
+};
+
+Perf::Perf() : enabled(false), trace_next(0) {
+  clear();
+}
+
+const char* Perf::get_name(PerfCounter counter) {
+  return perf_names[counter];
+}
+
+void Perf::set_enabled(bool e) {
+  enabled.store(e, std::memory_order_relaxed);
+}
+
+void Perf::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  origin = get_timestamp();
+  for (Counter& c : counters) {
+    c = Counter();
+    c.window_start = origin;
+  }
+  trace.clear();
+  trace_next = 0;
+}
+
+void Perf::record(PerfCounter counter, double start, double duration) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Counter& c = counters[counter];
+  c.num++;
+  c.total += duration;
+  if (duration > c.max) c.max = duration;
+  c.last = duration;
+
+  int bucket = 0;
+  double limit = PERF_BUCKET_BASE;
+  while (bucket < PERF_NUM_BUCKETS - 1 && duration >= limit) {
+    bucket++;
+    limit *= 2;
+  }
+  c.buckets[bucket]++;
+
+  if (start - c.window_start >= 1) {
+    c.rate = c.window_num / (start - c.window_start);
+    c.window_start = start;
+    c.window_num = 0;
+  }
+  c.window_num++;
+
+  const TraceEvent event = { counter, std::this_thread::get_id(), start, duration };
+  if (trace.size() < PERF_MAX_TRACE_EVENTS) trace.push_back(event);
+  else trace[trace_next] = event;
+  trace_next = (trace_next + 1) % PERF_MAX_TRACE_EVENTS;
+}
+
+double Perf::get_last(PerfCounter counter) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return counters[counter].last;
+}
+
+double Perf::get_rate(PerfCounter counter) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const Counter& c = counters[counter];
+  // Nothing recorded for a while, the last rate is stale.
+  if (get_timestamp() - c.window_start >= 2) return 0;
+  return c.rate;
+}
+
+std::string Perf::report() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string output;
+  char line[128];
+  if (!is_enabled()) output += "Instrumentation is off, turn on the performance HUD to record.\n\n";
+  for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+    const Counter& c = counters[i];
+    snprintf(line, sizeof(line), "%s: %u calls, total %.1f ms, mean %.3f ms, max %.3f ms\n",
+        perf_names[i], c.num, c.total * 1000, c.num ? c.total * 1000 / c.num : 0.0, c.max * 1000);
+    output += line;
+
+    int last_bucket = -1;
+    unsigned int most = 0;
+    for (int b = 0; b < PERF_NUM_BUCKETS; b++) {
+      if (c.buckets[b] == 0) continue;
+      last_bucket = b;
+      if (c.buckets[b] > most) most = c.buckets[b];
+    }
+    double limit = PERF_BUCKET_BASE;
+    for (int b = 0; b <= last_bucket; b++, limit *= 2) {
+      if (b < PERF_NUM_BUCKETS - 1) snprintf(line, sizeof(line), "  < %8.2f ms %8u  ", limit * 1000, c.buckets[b]);
+      else snprintf(line, sizeof(line), " >= %8.2f ms %8u  ", limit / 2 * 1000, c.buckets[b]);
+      output += line;
+      output += std::string((c.buckets[b] * 40 + most - 1) / most, '#');
+      output += '\n';
+    }
+    output += '\n';
+  }
+  return output;
+}
+
+std::string Perf::chrome_trace() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<std::thread::id, int> tids;
+  std::string output = "{\"traceEvents\":[";
+  char line[192];
+  const unsigned int first = trace.size() < PERF_MAX_TRACE_EVENTS ? 0 : trace_next;
+  for (unsigned int i = 0; i < trace.size(); i++) {
+    const TraceEvent& event = trace[(first + i) % trace.size()];
+    auto it = tids.find(event.thread);
+    if (it == tids.end()) it = tids.insert(std::make_pair(event.thread, int(tids.size()) + 1)).first;
+    snprintf(line, sizeof(line),
+        "%s\n{\"name\":\"%s\",\"cat\":\"syntaxic\",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":1,\"tid\":%d}",
+        i ? "," : "", perf_names[event.counter], (event.start - origin) * 1000000,
+        event.duration * 1000000, it->second);
+    output += line;
+  }
+  output += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return output;
+}
@@ -0,0 +1,93 @@
+#ifndef SYNTAXIC_CORE_PERF_HPP
+#define SYNTAXIC_CORE_PERF_HPP
+
+#include "core/util.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Instrumented hot paths. */
+enum PerfCounter {
+  PERF_PAINT,
+  PERF_REFLOW,
+  PERF_PROCESS_DOCUMENT,
+  PERF_HIGHLIGHT,
+  PERF_DOC_EVENTS,
+  PERF_NUM_COUNTERS
+};
+
+/** Histogram buckets, bucket i holds durations under 2^i * PERF_BUCKET_BASE (the last one holds
+the rest). */
+#define PERF_NUM_BUCKETS 14
+#define PERF_BUCKET_BASE 0.00005
+/** Timings kept for the trace, older ones are overwritten. */
+#define PERF_MAX_TRACE_EVENTS 100000
+
+/** Timings of the hot paths: counts, histograms, rates and a trace of the most recent ones.
+Nothing is recorded unless enabled, so timers cost a single check otherwise.  Thread safe. */
+class Perf {
+private:
+  struct Counter {
+    unsigned int num;
+    double total, max, last;
+    unsigned int buckets[PERF_NUM_BUCKETS];
+    /** Rate is counted over windows of about a second. */
+    double window_start;
+    unsigned int window_num;
+    double rate;
+  };
+  struct TraceEvent {
+    PerfCounter counter;
+    std::thread::id thread;
+    double start, duration;
+  };
+
+  std::atomic<bool> enabled;
+  std::mutex mutex;
+  double origin;
+  Counter counters[PERF_NUM_COUNTERS];
+  /** Ring buffer, trace_next is where the next event goes. */
+  std::vector<TraceEvent> trace;
+  unsigned int trace_next;
+
+public:
+  Perf();
+
+  inline bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+  void set_enabled(bool e);
+  void clear();
+
+  /** Record a timing, start is a get_timestamp(). */
+  void record(PerfCounter counter, double start, double duration);
+  /** Duration of the last timing, in seconds. */
+  double get_last(PerfCounter counter);
+  /** Timings per second, recently. */
+  double get_rate(PerfCounter counter);
+
+  /** Summary and histogram of every counter. */
+  std::string report();
+  /** The trace in Chrome's trace event format (chrome://tracing). */
+  std::string chrome_trace();
+
+  static const char* get_name(PerfCounter counter);
+};
+
+extern Perf perf;
+
+/** Times its scope, if perf is enabled. */
+class PerfTimer {
+private:
+  PerfCounter counter;
+  double start;
+
+public:
+  inline PerfTimer(PerfCounter c) : counter(c), start(perf.is_enabled() ? get_timestamp() : -1) {}
+  inline ~PerfTimer() {
+    if (start >= 0) perf.record(counter, start, get_timestamp() - start);
+  }
+};
+
+#endif
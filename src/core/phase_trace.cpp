@@ -0,0 +1,38 @@
+#include "core/phase_trace.hpp"
+#include "core/util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+PhaseTrace::PhaseTrace() : origin(get_timestamp()) {}
+
+void PhaseTrace::add(const std::string& name, double start) {
+  phases.push_back({ name, start - origin, get_timestamp() - start });
+}
+
+void PhaseTrace::mark(const std::string& name) {
+  phases.push_back({ name, get_timestamp() - origin, 0 });
+}
+
+std::string PhaseTrace::report() const {
+  std::vector<Phase> sorted(phases);
+  std::stable_sort(sorted.begin(), sorted.end(), [](const Phase& a, const Phase& b) {
+    return a.start < b.start;
+  });
+
+  std::string output = "   start ms  duration ms  phase\n";
+  char line[64];
+  for (const Phase& phase : sorted) {
+    snprintf(line, sizeof(line), "%11.1f  %11.1f  ", phase.start * 1000, phase.duration * 1000);
+    output += line;
+    output += phase.name;
+    output += '\n';
+  }
+  return output;
+}
+
+PhaseTimer::PhaseTimer(PhaseTrace& t, const std::string& n) : trace(t), name(n), start(get_timestamp()) {}
+
+PhaseTimer::~PhaseTimer() {
+  trace.add(name, start);
+}
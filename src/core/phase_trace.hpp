@@ -0,0 +1,41 @@
+#ifndef SYNTAXIC_CORE_PHASE_TRACE_HPP
+#define SYNTAXIC_CORE_PHASE_TRACE_HPP
+
+#include <string>
+#include <vector>
+
+/** Timings of named phases, such as those of startup, relative to when the trace was created. */
+class PhaseTrace {
+private:
+  struct Phase {
+    std::string name;
+    double start;
+    double duration;
+  };
+  double origin;
+  std::vector<Phase> phases;
+
+public:
+  PhaseTrace();
+
+  /** Record a phase that started at start (a get_timestamp()) and ends now. */
+  void add(const std::string& name, double start);
+  /** Record an instant, such as the first paint. */
+  void mark(const std::string& name);
+  /** One line per phase, in order of start. */
+  std::string report() const;
+};
+
+/** Records a phase for the duration of its scope. */
+class PhaseTimer {
+private:
+  PhaseTrace& trace;
+  std::string name;
+  double start;
+
+public:
+  PhaseTimer(PhaseTrace& trace, const std::string& name);
+  ~PhaseTimer();
+};
+
+#endif
@@ -59,11 +59,16 @@ bool Highlights::is_char_highlighted_non_temporary(int col) {
   return false;
 }
 
-int get_row_preference(int row, int col, int delta, const TextBuffer* tb, std::vector<Overlay>& overlays) {
-  if (row < 0 || row >= tb->get_num_lines()) return 100000;
-  for (Overlay& o: overlays) {
-    if (o.drow == row) return 50000;
+bool RichText::is_row_taken(int drow) const {
+  for (const auto& by_row : overlays) {
+    if (by_row.count(drow)) return true;
   }
+  return false;
+}
+
+int RichText::get_row_preference(const TextBuffer* tb, int row, int col, int delta) const {
+  if (row < 0 || row >= tb->get_num_lines()) return 100000;
+  if (is_row_taken(row)) return 50000;
   const Line& line = tb->get_line(row);
   if (delta < 0) delta *= -1;
   return std::max(((int) line.size() + 3), col) + 2*delta;
@@ -77,21 +82,37 @@ void RichText::add_overlay(const TextBuffer* tb, int row, int col, OverlayType::
   int drow = row;
   int best_preference = 100000;
 
-  for (int i = -2; i <= 2; i++) {
-    int preference = get_row_preference(row+i, col, i, tb, overlays);
+  for (int i = -OVERLAY_MAX_DISTANCE; i <= OVERLAY_MAX_DISTANCE; i++) {
+    int preference = get_row_preference(tb, row+i, col, i);
     if (preference < best_preference) {
       drow = row + i;
       best_preference = preference;
     }
   }
-  overlays.push_back(Overlay(row, col, type, drow, best_preference, text));
+  overlays[type][drow].push_back(Overlay(row, col, type, drow, best_preference, text));
+  num_overlays++;
 }
 
 void RichText::clear_overlays(OverlayType::Type type) {
-  for (int i = overlays.size() - 1; i >= 0; i--) {
-    Overlay& o = overlays[i];
-    if (o.type == type) {
-      overlays.erase(overlays.begin() + i);
+  for (const auto& p : overlays[type]) num_overlays -= p.second.size();
+  overlays[type].clear();
+}
+
+void RichText::clear_overlays() {
+  for (auto& by_row : overlays) by_row.clear();
+  num_overlays = 0;
+}
+
+void RichText::get_overlays(int row0, int row1, std::vector<const Overlay*>& output) const {
+  for (const auto& by_row : overlays) {
+    // Overlays pointing at the rows can be displayed a little above or below them.
+    auto it = by_row.lower_bound(row0 - OVERLAY_MAX_DISTANCE);
+    const auto end = by_row.upper_bound(row1 + OVERLAY_MAX_DISTANCE);
+    for (; it != end; ++it) {
+      for (const Overlay& o : it->second) {
+        if (std::max(o.row, o.drow) < row0 || std::min(o.row, o.drow) > row1) continue;
+        output.push_back(&o);
+      }
     }
   }
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #ifndef SYNTAXIC_CORE_HIGHLIGHTS_HPP
 #define SYNTAXIC_CORE_HIGHLIGHTS_HPP
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -51,10 +52,13 @@ public:
 
 namespace OverlayType {
   enum Type {
-    NOTICE, ERROR, STATLANG_ERROR
+    NOTICE, ERROR, STATLANG_ERROR, NUM_TYPES
   };
 }
 
+/** How many rows above or below its row an overlay may be displayed. */
+#define OVERLAY_MAX_DISTANCE 2
+
 struct Overlay {
   int row, col;
   int drow, dcol;
@@ -67,18 +71,29 @@ struct Overlay {
 
 /** Additions to plain TextBuffer.  Overlays and highlights for the time being. */
 class RichText {
+private:
+  /** Overlays of each type, by the row they are displayed on. */
+  std::map<int, std::vector<Overlay>> overlays[OverlayType::NUM_TYPES];
+  int num_overlays;
+
+  bool is_row_taken(int drow) const;
+  int get_row_preference(const TextBuffer* tb, int row, int col, int delta) const;
+
 public:
   Highlights highlights;
 
   /** Suppress temporary highlights?  This is used during incremental search. */
   bool suppress_temporary_highlights;
 
-  /** Sequence of overlays. */
-  std::vector<Overlay> overlays;
   void add_overlay(const TextBuffer* tb, int row, int col, OverlayType::Type type, const std::string& text);
   void clear_overlays(OverlayType::Type type);
+  void clear_overlays();
+  inline int get_num_overlays() const { return num_overlays; }
+  /** Get overlays that are displayed on, or point at, rows row0 through row1.  Pointers are valid
+  until overlays change. */
+  void get_overlays(int row0, int row1, std::vector<const Overlay*>& output) const;
 
-  inline RichText() : suppress_temporary_highlights(false) {}
+  inline RichText() : num_overlays(0), suppress_temporary_highlights(false) {}
 };
 
 
@@ -0,0 +1,85 @@
+#include "core/scrollback_buffer.hpp"
+#include "core/util_path.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <QByteArray>
+#include <QFile>
+
+ScrollbackBuffer::ScrollbackBuffer(unsigned int d) : depth(d), spill(false), num_spilled_lines(0) {
+  if (depth < 1) depth = 1;
+}
+
+ScrollbackBuffer::~ScrollbackBuffer() {
+  if (!spill_path.empty()) QFile::remove(QString::fromStdString(spill_path));
+}
+
+void ScrollbackBuffer::set_depth(unsigned int d) {
+  depth = d;
+  if (depth < 1) depth = 1;
+}
+
+void ScrollbackBuffer::set_spill(bool s) {
+  spill = s;
+}
+
+int ScrollbackBuffer::evict() {
+  const unsigned int num_lines = lines.size();
+  if (num_lines <= depth + get_slack()) return 0;
+
+  const int num_to_erase = num_lines - depth;
+  if (spill) spill_lines(num_to_erase);
+  lines.erase(lines.begin(), lines.begin() + num_to_erase);
+  return num_to_erase;
+}
+
+// Spill file is a sequence of blocks, each block is a 32-bit size followed by qCompress-ed UTF-8
+// text of the lines (every line terminated with '\n').
+
+void ScrollbackBuffer::spill_lines(int num_lines) {
+  if (spill_path.empty()) spill_path = UtilPath::temp_file();
+
+  std::string text;
+  for (int i = 0; i < num_lines; i++) {
+    text += lines[i].to_string();
+    text += '\n';
+  }
+  QByteArray compressed = qCompress(reinterpret_cast<const uchar*>(text.data()), text.size());
+
+  QFile file(QString::fromStdString(spill_path));
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    printf("WARNING: Could not spill scrollback to '%s'.\n", spill_path.c_str());
+    return;
+  }
+  const uint32_t size = compressed.size();
+  file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  file.write(compressed);
+  num_spilled_lines += num_lines;
+}
+
+std::string ScrollbackBuffer::get_full_history() const {
+  std::string rv;
+  if (!spill_path.empty()) {
+    QFile file(QString::fromStdString(spill_path));
+    if (file.open(QIODevice::ReadOnly)) {
+      QByteArray contents = file.readAll();
+      int pos = 0;
+      while (pos + int(sizeof(uint32_t)) <= contents.size()) {
+        uint32_t size;
+        memcpy(&size, contents.constData() + pos, sizeof(size));
+        pos += sizeof(size);
+        if (pos + int(size) > contents.size()) {
+          printf("WARNING: Truncated scrollback spill file '%s'.\n", spill_path.c_str());
+          break;
+        }
+        QByteArray block = qUncompress(reinterpret_cast<const uchar*>(contents.constData() + pos), size);
+        rv.append(block.constData(), block.size());
+        pos += size;
+      }
+    } else {
+      printf("WARNING: Could not read scrollback from '%s'.\n", spill_path.c_str());
+    }
+  }
+  rv += get_contents_as_string();
+  return rv;
+}
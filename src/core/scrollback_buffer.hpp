@@ -0,0 +1,44 @@
+#ifndef SYNTAXIC_CORE_SCROLLBACK_BUFFER_HPP
+#define SYNTAXIC_CORE_SCROLLBACK_BUFFER_HPP
+
+#include "core/text_buffer.hpp"
+
+#include <string>
+
+/** TextBuffer for console output which keeps at most `depth` lines.  Lines over the depth are
+evicted from the front in blocks, so that appending stays amortized O(1) no matter how deep the
+scrollback is.  Evicted lines can optionally be spilled into a compressed temp file. */
+class ScrollbackBuffer : public TextBuffer {
+private:
+  unsigned int depth;
+  bool spill;
+  std::string spill_path;
+  int num_spilled_lines;
+
+  void spill_lines(int num_lines);
+
+public:
+  ScrollbackBuffer(unsigned int depth = 1000);
+  ~ScrollbackBuffer();
+  ScrollbackBuffer(const ScrollbackBuffer&) = delete;
+  ScrollbackBuffer& operator=(const ScrollbackBuffer&) = delete;
+
+  inline unsigned int get_depth() const { return depth; }
+  void set_depth(unsigned int d);
+  inline bool get_spill() const { return spill; }
+  void set_spill(bool s);
+
+  /** How many lines can be over the depth before a block of lines is evicted. */
+  inline unsigned int get_slack() const { return depth / 4 + 64; }
+
+  /** Evict lines over the depth (if there are enough of them).  Returns number of evicted lines,
+  row numbers of remaining lines shift up by this much. */
+  int evict();
+
+  /** Number of lines that were spilled into the temp file. */
+  inline int get_num_spilled_lines() const { return num_spilled_lines; }
+  /** Return the spilled lines followed by the current contents. */
+  std::string get_full_history() const;
+};
+
+#endif
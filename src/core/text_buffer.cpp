@@ -2,6 +2,8 @@
 #include "core/text_edit.hpp"
 #include "utf8.h"
 
+#include <iterator>
+
 TextBuffer::TextBuffer() {
   lines.push_back(Line());
 }
@@ -25,10 +27,20 @@ Line& TextBuffer::insert_line(int index) {
   return lines[index];
 }
 
+void TextBuffer::insert_lines(int index, int num) {
+  std::vector<Line> new_lines(num);
+  lines.insert(lines.begin() + index, std::make_move_iterator(new_lines.begin()),
+      std::make_move_iterator(new_lines.end()));
+}
+
 void TextBuffer::remove_line(int index) {
   lines.erase(lines.begin() + index);
 }
 
+void TextBuffer::remove_lines(int index0, int index1) {
+  lines.erase(lines.begin() + index0, lines.begin() + index1);
+}
+
 void TextBuffer::trim_lines_to_size(unsigned int size) {
   if (lines.size() > size) {
     const int num_to_erase = lines.size() - size;
@@ -36,11 +48,22 @@ void TextBuffer::trim_lines_to_size(unsigned int size) {
   }
 }
 
+void TextBuffer::add_memory_usage(MemoryUsage& usage) const {
+  size_t text = lines.capacity() * sizeof(Line);
+  size_t tokens = 0;
+  for (const Line& line : lines) {
+    text += line.capacity() * sizeof(Character);
+    tokens += line.appendage().tokens.capacity() * sizeof(Token);
+  }
+  usage.bytes[MEM_TEXT] += text;
+  usage.bytes[MEM_LINE_TOKENS] += tokens;
+}
+
 std::string TextBuffer::get_contents_as_string() const {
   std::string rv;
   for (int i = 0; i < get_num_lines(); i++) {
     const Line& line = get_line(i);
-    rv += line.to_string();
+    line.append_utf8(rv);
     if (i != get_num_lines() - 1) rv += '\n';
   }
   return rv;
@@ -232,7 +255,7 @@ std::string TextBuffer::to_utf8(LineEndings line_endings) {
   std::string rv;
   for (int i = 0; i < get_num_lines(); i++) {
     const Line& line = get_line(i);
-    rv.append(line.to_string());
+    line.append_utf8(rv);
     if (i != get_num_lines() - 1) {
       if (line_endings == WINDOWS) rv += '\r';
       rv += '\n';
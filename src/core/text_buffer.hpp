@@ -3,6 +3,7 @@
 
 #include "core/common.hpp"
 #include "core/line.hpp"
+#include "core/memory_usage.hpp"
 #include "core/word_def.hpp"
 
 #include <string>
@@ -25,12 +26,18 @@ public:
   const Line& get_last_line() const;
   inline int get_num_lines() const { return lines.size(); }
   Line& insert_line(int index);
+  /** Insert num empty lines before index in one go. */
+  void insert_lines(int index, int num);
   void remove_line(int index);
+  /** Remove lines index0 through index1 (exclusive) in one go. */
+  void remove_lines(int index0, int index1);
   /** If there are more than _size_ lines, then delete first N lines like a console. */
   void trim_lines_to_size(unsigned int size);
   /** Utility function to take the entire TextFile and return it as a UTF8 string. */
   std::string get_contents_as_string() const;
   inline std::string to_string() const { return get_contents_as_string(); }
+  /** Add memory held by the lines (MEM_TEXT) and their tokens (MEM_LINE_TOKENS). */
+  void add_memory_usage(MemoryUsage& usage) const;
 
   // Cursor helpers:
 
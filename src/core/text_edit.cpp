@@ -32,11 +32,10 @@ void SimpleTextEdit::remove_char(CursorLocation cl) {
       return;
     }
     Line& nl = text_buffer.get_line(cl.row+1);
-    std::string s = nl.to_string(0, nl.size());
     if (undo_manager) undo_manager->add_remove_line(activity, cl.row+1, start_location);
-    text_buffer.remove_line(cl.row+1);
     if (undo_manager) undo_manager->add_change_line(activity, cl.row, start_location);
-    l.append(s);
+    l.append(nl, 0, nl.size());
+    text_buffer.remove_line(cl.row+1);
   } else {
     if (undo_manager) undo_manager->add_change_line(activity, cl.row, start_location);
     l.remove(cl.col);
@@ -53,14 +52,11 @@ void SimpleTextEdit::insert_char(CursorLocation cl, char32_t c, uint8_t markup)
 
   Line& l = text_buffer.get_line(cl.row);
   if (c == '\n') {
-    std::string s = "";
     if (cl.col != (int) l.size()) {
       if (undo_manager) undo_manager->add_change_line(activity, cl.row, start_location);
-      s = l.to_string(cl.col, l.size());
-      l.trim(cl.col);
     }
-    Line& nl = text_buffer.insert_line(cl.row+1);
-    nl.append(s);
+    text_buffer.insert_line(cl.row+1);
+    text_buffer.get_line(cl.row).split(cl.col, text_buffer.get_line(cl.row+1));
     if (undo_manager) undo_manager->add_insert_line(activity, cl.row+1, start_location);
     end_location.row = cl.row + 1;
     end_location.col = 0;
@@ -92,12 +88,14 @@ void SimpleTextEdit::remove_text(CursorLocation cl1, CursorLocation cl2) {
     if (undo_manager) undo_manager->add_change_line(activity, cl1.row, start_location);
     Line& l1 = text_buffer.get_line(cl1.row);
     Line& l2 = text_buffer.get_line(cl2.row);
-    l1.remove(cl1.col, l1.size());
-    l1.append(l2.to_string(cl2.col, l2.size()));
-    for (int row = cl2.row; row > cl1.row; row--) {
-      if (undo_manager) undo_manager->add_remove_line(activity, row, start_location);
-      text_buffer.remove_line(row);
+    l1.trim(cl1.col);
+    l1.append(l2, cl2.col, l2.size());
+    if (undo_manager) {
+      for (int row = cl2.row; row > cl1.row; row--) {
+        undo_manager->add_remove_line(activity, row, start_location);
+      }
     }
+    text_buffer.remove_lines(cl1.row + 1, cl2.row + 1);
   }
 
   end_location = cl1;
@@ -128,18 +126,20 @@ void SimpleTextEdit::insert_text(CursorLocation cl, std::string text, uint8_t ma
 
   } else if (splitted.size() > 1) {
     if (undo_manager) undo_manager->add_change_line(activity, cl.row, start_location);
+    const int num_new = splitted.size() - 1;
+    text_buffer.insert_lines(cl.row + 1, num_new);
+    for (int i = 1; i <= num_new; i++) {
+      text_buffer.get_line(cl.row + i).append(splitted[i], markup);
+    }
     Line& l = text_buffer.get_line(cl.row);
-    std::string s = l.to_string(cl.col, l.size());
-    l.trim(cl.col);
+    Line& last = text_buffer.get_line(cl.row + num_new);
+    end_location = CursorLocation(cl.row + num_new, last.size());
+    l.split(cl.col, last);
     l.append(splitted[0], markup);
-    for (unsigned int i = 1; i < splitted.size(); i++) {
-      Line& nl = text_buffer.insert_line(cl.row + i);
-      nl.append(splitted[i], markup);
-      end_location = CursorLocation(cl.row + i, nl.size());
-      if (i == (splitted.size() - 1)) {
-        nl.append(s, markup);
+    if (undo_manager) {
+      for (int i = 1; i <= num_new; i++) {
+        undo_manager->add_insert_line(activity, cl.row + i, start_location);
       }
-      if (undo_manager) undo_manager->add_insert_line(activity, cl.row + i, start_location);
     }
   }
   if (text_file) text_file->unsaved_edits = true;
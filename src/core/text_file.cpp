@@ -45,11 +45,14 @@ void TextFile::change_path(const std::string& path) {
 
 void TextFile::load() {
   assert(!absolute_path.empty());
+  load_contents(io_provider->read_file(absolute_path));
+}
+
+void TextFile::load_contents(const std::vector<char>& contents) {
   assert(line_endings != UNKNOWN && line_endings != MIXED);
 
   std::string utf8_contents;
   {
-    std::vector<char> contents = io_provider->read_file(absolute_path);
     if (encoding == "UTF-8") {
       utf8_contents = std::string(contents.data(), contents.size());
     } else {
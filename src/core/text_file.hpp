@@ -61,6 +61,8 @@ public:
   void save(bool trim_trailing_whitespace=false, bool ignore_unencodable_chars=false);
   /** Load trims the former contents of the text buffer.  */
   void load();
+  /** Same as load() but with contents that were already read (e.g. asynchronously). */
+  void load_contents(const std::vector<char>& contents);
 
   // Undo manager:
   inline UndoManager& get_undo_manager() { return undo_manager; }
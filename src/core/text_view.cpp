@@ -6,6 +6,10 @@
 #include "core/text_view.hpp"
 #include "core/utf8_util.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
 TextView::TextView(TextBuffer& tb, TextFile* tf) : preferred_x(0), cursor(0, 0), selection_active(false), text_buffer(tb), text_file(tf) {}
 
 SelectionInfo TextView::get_selection() const {
@@ -552,6 +556,39 @@ int TextView::replace_all(const std::string& term, SearchSettings search_setting
   return results.size();
 }
 
+int TextView::apply_replacements(std::vector<TextReplacement> replacements) {
+  const int num_lines = text_buffer.get_num_lines();
+  auto clamp = [&](CursorLocation& cl) {
+    if (cl.row < 0) cl.row = 0;
+    if (cl.row >= num_lines) cl.row = num_lines - 1;
+    const int size = text_buffer.get_line(cl.row).size();
+    if (cl.col < 0) cl.col = 0;
+    if (cl.col > size) cl.col = size;
+  };
+  for (TextReplacement& tr : replacements) {
+    clamp(tr.start);
+    clamp(tr.end);
+    if (tr.start > tr.end) std::swap(tr.start, tr.end);
+  }
+
+  // Apply from the back, so that locations of the remaining replacements stay valid.
+  std::sort(replacements.begin(), replacements.end(),
+      [](const TextReplacement& a, const TextReplacement& b) { return a.start > b.start; });
+  for (unsigned int i = 1; i < replacements.size(); i++) {
+    if (replacements[i].end > replacements[i-1].start) {
+      throw std::invalid_argument("Overlapping replacements.");
+    }
+  }
+
+  SimpleTextEdit ste(text_buffer, cursor, text_file);
+  for (TextReplacement& tr : replacements) {
+    if (!(tr.start == tr.end)) ste.remove_text(tr.start, tr.end);
+    if (!tr.text.empty()) ste.insert_text(tr.start, tr.text);
+  }
+  mouse(cursor.row, cursor.col, false);
+  return replacements.size();
+}
+
 void TextView::select_word() {
   Line& line = text_buffer.get_line(cursor.row);
 
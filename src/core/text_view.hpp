@@ -4,6 +4,7 @@
 #include "core/common.hpp"
 
 #include <string>
+#include <vector>
 
 class FlowGrid;
 class SimpleTextEdit;
@@ -82,6 +83,9 @@ public:
   void select_none();
   void replace(const std::string& term, const std::string& replacement);
   int replace_all(const std::string& term, SearchSettings search_settings, const std::string& replacement);
+  /** Apply all replacements as a single undo step.  Locations refer to the text before any of the
+  replacements and are clamped to the buffer.  Throws std::invalid_argument if any overlap. */
+  int apply_replacements(std::vector<TextReplacement> replacements);
   void rotating_tab(int index);
   void tab(int tabdef);
   void untab(int tabdef);
@@ -1,3 +1,4 @@
+#include "core/memory_usage.hpp"
 #include "core/undo_manager.hpp"
 #include "core/text_file.hpp"
 
@@ -90,3 +91,34 @@ bool UndoManager::undo(CursorLocation& cl) {
 
   return true;
 }
+
+size_t UndoManager::get_memory_usage() const {
+  size_t bytes = elements.capacity() * sizeof(UndoElement);
+  for (const UndoElement& ue : elements) bytes += heap_bytes(ue.get_line());
+  return bytes;
+}
+
+size_t UndoManager::trim(size_t max_bytes) {
+  const size_t before = get_memory_usage();
+  // Budget what the history holds, unused capacity is given back by shrinking anyway.
+  size_t bytes = elements.size() * sizeof(UndoElement);
+  for (const UndoElement& ue : elements) bytes += heap_bytes(ue.get_line());
+
+  // A save point at the tail stays, is_save_point() relies on it.  An older one may go, the text
+  // then simply can not be undone back to its saved state and stays modified.
+  const unsigned int keep = is_save_point() ? elements.size() - 1 : elements.size();
+
+  // Only whole operations go, an operation undone in part would corrupt the text.
+  unsigned int cut = 0;
+  while (cut < keep && bytes > max_bytes) {
+    const int count = elements[cut].get_count();
+    unsigned int end = cut;
+    while (end < elements.size() && elements[end].get_count() == count) end++;
+    if (end > keep) break;
+    for (; cut < end; cut++) bytes -= sizeof(UndoElement) + heap_bytes(elements[cut].get_line());
+  }
+  if (cut == 0) return 0;
+  elements.erase(elements.begin(), elements.begin() + cut);
+  elements.shrink_to_fit();
+  return before - get_memory_usage();
+}
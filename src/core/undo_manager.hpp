@@ -3,6 +3,7 @@
 
 #include "core/common.hpp"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -61,6 +62,12 @@ public:
 
   /** Return if top of the stack is a save point. */
   bool is_save_point();
+
+  /** Bytes held by the history. */
+  size_t get_memory_usage() const;
+  /** Forget the oldest operations until the history holds at most max_bytes.  A save point on top
+  of the stack is kept, an older one may be forgotten.  Return bytes freed. */
+  size_t trim(size_t max_bytes);
 };
 
 #endif
\ No newline at end of file
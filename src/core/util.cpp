@@ -94,15 +94,19 @@ void read_file(std::vector<char>& out, const std::string& p) {
     throw std::runtime_error("Failed to open file '" + p + "' for reading.");
   }
 
-  for (;;) {
-    char c = 0;
-    bool result = qfile.getChar(&c);
-    if (!result) {
+  // Read in one go, not a character at a time.  Files reporting no size (empty or special) are
+  // read until the end.
+  const qint64 size = qfile.size();
+  if (size > 0) {
+    out.resize(size);
+    if (qfile.read(out.data(), size) != size) {
       throw std::runtime_error("Error while reading file '" + p + "'");
     }
-    out.push_back(c);
-    if (qfile.atEnd()) break;
+    return;
   }
+  const QByteArray data = qfile.readAll();
+  if (data.isEmpty()) throw std::runtime_error("Error while reading file '" + p + "'");
+  out.assign(data.constData(), data.constData() + data.size());
 }
 
 void write_file(const std::vector<char>& contents, const std::string& p) {
@@ -179,6 +183,6 @@ std::string extract_lowercase_extension(const std::string& filename) {
 
 double get_timestamp() {
   auto tp = std::chrono::high_resolution_clock::now();
-  double d = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
-  return d / 1000;
+  double d = std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+  return d / 1000000;
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #include "core/util_glob.hpp"
 #include "core/utf8_util.hpp"
 
+#include <mutex>
+
+/** Filters compiled by compile_filter are forgotten once there are more than this many. */
+#define GLOB_FILTER_CACHE_SIZE 16
+
 namespace UtilGlob {
 
 bool matches(const std::string& glob, const std::string& str) {
@@ -33,4 +38,224 @@ bool matches(const std::string& glob, const std::string& str) {
   return true;
 }
 
-}
\ No newline at end of file
+////////////////////////////////////////////////////////////// GlobSet
+
+static inline char lower_ascii(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static std::string to_lower_ascii(const std::string& str) {
+  std::string output(str);
+  for (char& c : output) c = lower_ascii(c);
+  return output;
+}
+
+/** Next character of a UTF8 string.  Invalid bytes are taken as characters of their own, file
+names need not be valid UTF8. */
+static uint32_t next_char(const char*& p, const char* end) {
+  const uint8_t lead = *p++;
+  if (lead < 0x80) return lead;
+  int num_cont;
+  uint32_t c;
+  if ((lead & 0xE0) == 0xC0) { num_cont = 1; c = lead & 0x1F; }
+  else if ((lead & 0xF0) == 0xE0) { num_cont = 2; c = lead & 0x0F; }
+  else if ((lead & 0xF8) == 0xF0) { num_cont = 3; c = lead & 0x07; }
+  else return lead;
+  if (end - p < num_cont) return lead;
+  for (int i = 0; i < num_cont; i++) {
+    if ((uint8_t(p[i]) & 0xC0) != 0x80) return lead;
+    c = (c << 6) | (uint8_t(p[i]) & 0x3F);
+  }
+  p += num_cont;
+  return c;
+}
+
+GlobSet::GlobSet(bool ic) : ignore_case(ic), max_suffix(0) {}
+
+void GlobSet::add(const std::string& g, int value) {
+  const int index = values.size();
+  values.push_back(value);
+  const std::string glob = ignore_case ? to_lower_ascii(g) : g;
+
+  bool has_wildcards = false;
+  for (unsigned int i = 1; i < glob.size(); i++) {
+    if (glob[i] == '*' || glob[i] == '?' || glob[i] == '[') has_wildcards = true;
+  }
+  if (!glob.empty() && (glob[0] == '?' || glob[0] == '[')) has_wildcards = true;
+
+  // "*.ext"
+  if (glob.size() > 1 && glob[0] == '*' && !has_wildcards) {
+    const std::string suffix = glob.substr(1);
+    if (suffix[0] == '.') {
+      if (suffixes.count(suffix) == 0) suffixes[suffix] = index;
+      if (suffix.size() > max_suffix) max_suffix = suffix.size();
+      return;
+    }
+  }
+  if (glob.empty() || (glob[0] != '*' && !has_wildcards)) {
+    if (names.count(glob) == 0) names[glob] = index;
+    return;
+  }
+
+  starts.push_back(tokens.size());
+  const char* p = glob.data();
+  const char* end = p + glob.size();
+  while (p < end) {
+    Token token = { CHAR, false, 0, 0, 0 };
+    const char* token_start = p;
+    const uint32_t c = next_char(p, end);
+    if (c == '*') {
+      token.type = STAR;
+      // Consecutive stars are one star.
+      if (!tokens.empty() && int(tokens.size()) > starts.back() && tokens.back().type == STAR) continue;
+    } else if (c == '?') {
+      token.type = ANY;
+    } else if (c == '[') {
+      // Class, unless it is not terminated, in which case '[' is just a character.
+      const char* q = p;
+      token.type = CLASS;
+      if (q < end && (*q == '!' || *q == '^')) {
+        token.negated = true;
+        q++;
+      }
+      token.ranges_start = class_ranges.size();
+      bool first = true;
+      bool terminated = false;
+      while (q < end) {
+        if (*q == ']' && !first) {
+          q++;
+          terminated = true;
+          break;
+        }
+        first = false;
+        const uint32_t lo = next_char(q, end);
+        uint32_t hi = lo;
+        if (q + 1 < end && *q == '-' && q[1] != ']') {
+          q++;
+          hi = next_char(q, end);
+        }
+        class_ranges.push_back(std::make_pair(lo, hi));
+      }
+      token.ranges_end = class_ranges.size();
+      if (terminated) {
+        p = q;
+      } else {
+        class_ranges.resize(token.ranges_start);
+        token = { CHAR, false, '[', 0, 0 };
+        p = token_start + 1;
+      }
+    } else {
+      token.c = c;
+    }
+    tokens.push_back(token);
+  }
+  tokens.push_back({ ACCEPT, false, uint32_t(index), 0, 0 });
+}
+
+void GlobSet::add_filter(const std::string& filter, int value) {
+  std::string glob;
+  for (char c : filter) {
+    if (c == ' ' || c == ';') {
+      if (!glob.empty()) add(glob, value);
+      glob.clear();
+    } else {
+      glob += c;
+    }
+  }
+  if (!glob.empty()) add(glob, value);
+}
+
+bool GlobSet::token_matches(const Token& token, uint32_t c) const {
+  switch (token.type) {
+    case CHAR: return token.c == c;
+    case ANY: return true;
+    case CLASS:
+      for (uint32_t i = token.ranges_start; i < token.ranges_end; i++) {
+        if (c >= class_ranges[i].first && c <= class_ranges[i].second) return !token.negated;
+      }
+      return token.negated;
+    default: return false;
+  }
+}
+
+void GlobSet::add_state(std::vector<int>& states, std::vector<uint32_t>& marks, uint32_t mark,
+    int state) const {
+  while (marks[state] != mark) {
+    marks[state] = mark;
+    states.push_back(state);
+    // A star may match nothing.
+    if (tokens[state].type != STAR) return;
+    state++;
+  }
+}
+
+int GlobSet::run_nfa(const std::string& name) const {
+  std::vector<int> states, next_states;
+  std::vector<uint32_t> marks(tokens.size(), 0);
+  uint32_t mark = 1;
+  for (int start : starts) add_state(states, marks, mark, start);
+
+  const char* p = name.data();
+  const char* end = p + name.size();
+  while (p < end && !states.empty()) {
+    const uint32_t c = next_char(p, end);
+    mark++;
+    next_states.clear();
+    for (int state : states) {
+      const Token& token = tokens[state];
+      if (token.type == STAR) add_state(next_states, marks, mark, state);
+      else if (token_matches(token, c)) add_state(next_states, marks, mark, state + 1);
+    }
+    states.swap(next_states);
+  }
+
+  int best = -1;
+  for (int state : states) {
+    const Token& token = tokens[state];
+    if (token.type == ACCEPT && (best < 0 || int(token.c) < best)) best = token.c;
+  }
+  return best;
+}
+
+int GlobSet::match(const std::string& n) const {
+  if (values.empty()) return -1;
+  const std::string lowered = ignore_case ? to_lower_ascii(n) : std::string();
+  const std::string& name = ignore_case ? lowered : n;
+
+  int best = -1;
+  if (!names.empty()) {
+    auto it = names.find(name);
+    if (it != names.end()) best = it->second;
+  }
+  if (!suffixes.empty()) {
+    // Every suffix starting with a dot, shortest first.
+    const int min_pos = name.size() > max_suffix ? int(name.size() - max_suffix) : 0;
+    for (int pos = int(name.size()) - 1; pos >= min_pos; pos--) {
+      if (name[pos] != '.') continue;
+      auto it = suffixes.find(name.substr(pos));
+      if (it != suffixes.end() && (best < 0 || it->second < best)) best = it->second;
+    }
+  }
+  if (!starts.empty()) {
+    const int nfa_best = run_nfa(name);
+    if (nfa_best >= 0 && (best < 0 || nfa_best < best)) best = nfa_best;
+  }
+  return best < 0 ? -1 : values[best];
+}
+
+std::shared_ptr<const GlobSet> compile_filter(const std::string& filter) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::shared_ptr<const GlobSet>> cache;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = cache.find(filter);
+  if (it != cache.end()) return it->second;
+
+  std::shared_ptr<GlobSet> glob_set = std::make_shared<GlobSet>(true);
+  glob_set->add_filter(filter, 0);
+  if (cache.size() >= GLOB_FILTER_CACHE_SIZE) cache.clear();
+  cache[filter] = glob_set;
+  return glob_set;
+}
+
+}
@@ -1,12 +1,70 @@
 #ifndef SYNTAXIC_CORE_UTIL_GLOB_HPP
 #define SYNTAXIC_CORE_UTIL_GLOB_HPP
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace UtilGlob {
 
 bool matches(const std::string& glob, const std::string& str);
 
+/** Many globs compiled once, to be matched against many names.  Globs support '*', '?' and
+character classes ("[abc]", "[a-z]", "[!abc]").  The common cases, "*.ext" and names without
+wildcards, are hash lookups.  The rest are combined into a single NFA that is run over the name
+once, however many globs there are. */
+class GlobSet {
+private:
+  enum TokenType : uint8_t { CHAR, ANY, STAR, CLASS, ACCEPT };
+  struct Token {
+    TokenType type;
+    bool negated;
+    /** CHAR: the character.  ACCEPT: index of the glob. */
+    uint32_t c;
+    /** CLASS: ranges in class_ranges. */
+    uint32_t ranges_start, ranges_end;
+  };
+
+  bool ignore_case;
+  /** Value of every glob added, in order.  Where several globs match, the first one wins. */
+  std::vector<int> values;
+  /** "*.ext" globs, keyed by ".ext". */
+  std::unordered_map<std::string, int> suffixes;
+  /** Longest key in suffixes, longer suffixes of a name need not be looked up. */
+  unsigned int max_suffix;
+  /** Globs without wildcards. */
+  std::unordered_map<std::string, int> names;
+  /** All other globs, one after another, each followed by an ACCEPT. */
+  std::vector<Token> tokens;
+  std::vector<int> starts;
+  std::vector<std::pair<uint32_t, uint32_t>> class_ranges;
+
+  bool token_matches(const Token& token, uint32_t c) const;
+  /** Add state (and what it leads to without consuming a character) to states. */
+  void add_state(std::vector<int>& states, std::vector<uint32_t>& marks, uint32_t mark, int state) const;
+  /** Index of the first glob of the NFA that matches name, or -1. */
+  int run_nfa(const std::string& name) const;
+
+public:
+  /** If ignore_case, ASCII letters match regardless of case. */
+  GlobSet(bool ignore_case = false);
+
+  /** value must not be negative. */
+  void add(const std::string& glob, int value);
+  /** Add globs separated by spaces or semicolons (the syntax of filters, see QDir::match). */
+  void add_filter(const std::string& filter, int value);
+  /** Value of the first added glob that matches name, or -1 if none does. */
+  int match(const std::string& name) const;
+  inline bool matches(const std::string& name) const { return match(name) >= 0; }
+  inline bool empty() const { return values.empty(); }
+};
+
+/** Filter compiled with add_filter, ignoring case.  Compiled filters are cached, so this is cheap
+to call for every directory listed.  Thread safe. */
+std::shared_ptr<const GlobSet> compile_filter(const std::string& filter);
+
 }
 
 #endif
@@ -1,9 +1,15 @@
+#include "core/perf.hpp"
 #include "core/text_buffer.hpp"
 #include "doc.hpp"
 
-Doc::Doc() : collection(nullptr), window(nullptr) {}
+#include <algorithm>
+#include <cstdio>
+
+Doc::Doc() : collection(nullptr), window(nullptr), version(0), pending_flags(0) {}
 
 Doc::~Doc() {
+  // Too late to deliver anything to the document itself.
+  doc_events.forget(this);
   all_docs_hook.call(this, DocEvent::CLOSING);
 }
 
@@ -19,8 +25,94 @@ Doc* DocCollection::get_current_doc() const {
 HookSource<Doc*, int> all_docs_hook;
 
 void Doc::call_hook(int flags) {
-  get_doc_hook()->call(this, flags);
-  all_docs_hook.call(this, flags);
+  if (flags & DocEvent::EDITED) version++;
+  doc_events.post(this, flags);
+}
+
+////////////////////////////////////////////////////////////// DocEventDispatcher
+
+DocEventDispatcher doc_events;
+
+DocEventDispatcher::DocEventDispatcher() : scheduled(false), flushing(false), num_posted(0),
+    num_delivered(0) {}
+
+void DocEventDispatcher::deliver(Doc* doc, int flags) {
+  PerfTimer timer(PERF_DOC_EVENTS);
+  num_delivered++;
+  HookSource<Doc*, int>* hook = doc->get_doc_hook();
+  hook->set_profile(&profile);
+  all_docs_hook.set_profile(&profile);
+  hook->call(doc, flags);
+  all_docs_hook.call(doc, flags);
+}
+
+void DocEventDispatcher::post(Doc* doc, int flags) {
+  num_posted++;
+  if (!scheduler || (flags & DocEvent::IMMEDIATE)) {
+    // Whatever came before goes first.
+    flush(doc);
+    deliver(doc, flags);
+    return;
+  }
+
+  if (doc->pending_flags == 0) pending_docs.push_back(doc);
+  doc->pending_flags |= flags;
+  if (!scheduled) {
+    scheduled = true;
+    scheduler();
+  }
+}
+
+void DocEventDispatcher::flush() {
+  scheduled = false;
+  if (flushing) return;
+  flushing = true;
+  // Hooks may post more events, those wait for the next flush.  They may also flush or close
+  // documents, which leaves a nullptr behind.
+  const unsigned int num = pending_docs.size();
+  for (unsigned int i = 0; i < num; i++) {
+    Doc* doc = pending_docs[i];
+    if (doc == nullptr) continue;
+    pending_docs[i] = nullptr;
+    const int flags = doc->pending_flags;
+    doc->pending_flags = 0;
+    deliver(doc, flags);
+  }
+  pending_docs.erase(pending_docs.begin(), pending_docs.begin() + num);
+  flushing = false;
+  if (!pending_docs.empty() && scheduler && !scheduled) {
+    scheduled = true;
+    scheduler();
+  }
+}
+
+void DocEventDispatcher::flush(Doc* doc) {
+  if (doc->pending_flags == 0) return;
+  const int flags = doc->pending_flags;
+  forget(doc);
+  deliver(doc, flags);
+}
+
+void DocEventDispatcher::forget(Doc* doc) {
+  if (doc->pending_flags == 0) return;
+  doc->pending_flags = 0;
+  std::replace(pending_docs.begin(), pending_docs.end(), doc, static_cast<Doc*>(nullptr));
+}
+
+std::string DocEventDispatcher::get_profile_report() const {
+  char line[256];
+  std::string output;
+  snprintf(line, sizeof(line), "%u events posted, %u delivered.\n\n", num_posted, num_delivered);
+  output += line;
+  output += "     calls     total ms       max ms  subscriber\n";
+  for (const auto& p : profile) {
+    snprintf(line, sizeof(line), "%10u  %11.1f  %11.2f  ", p.second.num_calls, p.second.total_time * 1000,
+        p.second.max_time * 1000);
+    output += line;
+    output += p.first;
+    output += '\n';
+  }
+  return output;
 }
 
 std::string Doc::get_long_title() const {
@@ -53,6 +145,7 @@ void Doc::handle_save_as(const std::string& /* path */) {}
 DocSearchResults Doc::handle_search_update(const std::string& /* search_term */, SearchSettings /* search_settings */, bool /* search_back */, bool /* move */) { return { 0, 0, 0, 0}; }
 DocSearchResults Doc::handle_search_replace(const std::string& /* search_term */, SearchSettings /* search_settings */, const std::string& /* replacement */) { return { 0, 0, 0, 0}; }
 int Doc::handle_search_replace_all(const std::string& /* search_term */, SearchSettings /* search_settings */, const std::string& /* replacement */) { return 0; }
+int Doc::handle_replacements(const std::vector<TextReplacement>& /* replacements */) { return 0; }
 void Doc::handle_change_type(const std::string& /* new_type */) {}
 void Doc::handle_comment() {}
 void Doc::handle_uncomment() {}
@@ -3,9 +3,11 @@
 
 #include "core/common.hpp"
 #include "core/hooks.hpp"
+#include "core/memory_usage.hpp"
 #include "core/rich_text.hpp"
 #include "core/visual_payload.hpp"
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -41,6 +43,9 @@ namespace DocEvent {
     // Newline was pressed in the document
     NEWLINE = 8192,
   };
+
+  /** Events delivered right away, in order, rather than coalesced with others. */
+  const int IMMEDIATE = OPENED | CHANGED_PATH | CLOSING | BEFORE_SAVE | AFTER_SAVE | NEWLINE | PAGE_UP | PAGE_DOWN;
 }
 
 /** Some keyboard driven actions. Usually these require no additional info apart from the keypress and flowgrid. */
@@ -132,6 +137,8 @@ public:
   virtual void add_doc(Doc* doc, bool switch_to_doc) = 0;
   virtual void remove_doc(Doc* doc) = 0;
   virtual void go_to_doc(Doc* doc) = 0;
+  /** Add memory held to display doc (MEM_FLOW_GRID, MEM_FOLD_IMAGES). */
+  virtual void add_view_memory_usage(Doc* /* doc */, MemoryUsage& /* usage */) {}
 };
 
 /** Mostly this is a virtualized interface for Document. */
@@ -141,6 +148,11 @@ private:
   DocCollection* collection;
   UIWindow* window;
   VisualPayload visual_payload;
+  unsigned int version;
+  /** Events waiting in doc_events. */
+  int pending_flags;
+
+  friend class DocEventDispatcher;
 
 protected:
   void call_hook(int flags);
@@ -161,6 +173,8 @@ public:
   inline void set_window(UIWindow* w) { window = w; }
   inline VisualPayload get_visual_payload() { return visual_payload; }
   inline void set_visual_payload(VisualPayload vp) { visual_payload = vp; }
+  /** Incremented on every EDITED event, lets plugins know whether what they read is stale. */
+  inline unsigned int get_version() const { return version; }
 
   // Needed functions
 
@@ -209,6 +223,8 @@ public:
   virtual DocSearchResults handle_search_update(const std::string& search_term, SearchSettings search_settings, bool search_back, bool move);
   virtual DocSearchResults handle_search_replace(const std::string& search_term, SearchSettings search_settings, const std::string& replacement);
   virtual int handle_search_replace_all(const std::string& search_term, SearchSettings search_settings, const std::string& replacement);
+  /** Apply all replacements as a single undo step, with a single EDITED event.  Returns number applied. */
+  virtual int handle_replacements(const std::vector<TextReplacement>& replacements);
   virtual void handle_change_type(const std::string& new_type);
   virtual void handle_comment();
   virtual void handle_uncomment();
@@ -231,4 +247,39 @@ public:
 /** Hook that activates for every document. */
 extern HookSource<Doc*, int> all_docs_hook;
 
+/** Delivers document events to the hooks.  Events are coalesced per document until the next flush,
+so that a burst of edits (console output, plugins, replacing) is processed once, with the union of
+their flags.  The UI schedules a flush whenever events are waiting and flushes before painting.
+Without a scheduler, as in tests, events are delivered right away. */
+class DocEventDispatcher {
+private:
+  std::vector<Doc*> pending_docs;
+  std::function<void()> scheduler;
+  bool scheduled;
+  bool flushing;
+  unsigned int num_posted, num_delivered;
+  HookProfile profile;
+
+  void deliver(Doc* doc, int flags);
+
+public:
+  DocEventDispatcher();
+
+  /** scheduler must arrange for flush() to be called soon. */
+  inline void set_scheduler(std::function<void()> s) { scheduler = s; }
+
+  void post(Doc* doc, int flags);
+  /** Deliver all waiting events. */
+  void flush();
+  /** Deliver waiting events of doc. */
+  void flush(Doc* doc);
+  /** Drop waiting events of doc, which is going away. */
+  void forget(Doc* doc);
+
+  /** Time spent in each subscriber, and how well events coalesce. */
+  std::string get_profile_report() const;
+};
+
+extern DocEventDispatcher doc_events;
+
 #endif
\ No newline at end of file
@@ -422,6 +422,16 @@ int Document::handle_search_replace_all(const std::string& search_term, SearchSe
   return rv;
 }
 
+int Document::handle_replacements(const std::vector<TextReplacement>& replacements) {
+  master.set_markovian(MARKOVIAN_NONE);
+  if (check_read_only()) return 0;
+  int rv = text_view.apply_replacements(replacements);
+  if (rv == 0) return 0;
+  if (get_appendage().folded) text_view.folded_momentum_up(false);
+  call_hook(DocEvent::EDITED | DocEvent::CHANGED_STATE | DocEvent::CURSOR_MOVED);
+  return rv;
+}
+
 void Document::handle_change_type(const std::string& new_type) {
   get_appendage().file_type = new_type;
   master.stat_lang.set_document_type(get_appendage().statlang_id, new_type);
@@ -504,7 +514,7 @@ void Document::handle_complete(const std::string& str) {
 
 void Document::handle_escape() {
   text_view.select_none();
-  get_appendage().rich_text.overlays.clear();
+  get_appendage().rich_text.clear_overlays();
   call_hook(DocEvent::CURSOR_MOVED);
 }
 
@@ -77,6 +77,7 @@ public:
   virtual DocSearchResults handle_search_update(const std::string& search_term, SearchSettings search_settings, bool search_back, bool move) override;
   virtual DocSearchResults handle_search_replace(const std::string& search_term, SearchSettings search_settings, const std::string& replacement) override;
   virtual int handle_search_replace_all(const std::string& search_term, SearchSettings search_settings, const std::string& replacement) override;
+  virtual int handle_replacements(const std::vector<TextReplacement>& replacements) override;
   virtual void handle_change_type(const std::string& new_type) override;
   virtual void handle_comment() override;
   virtual void handle_uncomment() override;
@@ -6,10 +6,17 @@
 #include "master_io_provider.hpp"
 #include "uiwindow.hpp"
 
+#include <algorithm>
+#include <climits>
 #include <QDir>
 #include <QFileInfo>
+#include <QTimer>
 
-FileNode::FileNode(STreeNode* p, FileBrowser* fb, int index, const std::string& name, const std::string& fn, int t) : STreeNode(p, fb, index), short_name(name), abs_path(fn), is_loaded(false), type(t), movable(true) {
+FileNode::FileNode(STreeNode* p, FileBrowser* fb, int index, const std::string& name, const std::string& fn, int t) : STreeNode(p, fb, index), short_name(name), abs_path(fn), is_loaded(false), type(t), movable(true), is_wanted(false), num_pending_done(0) {
+}
+
+FileNode::~FileNode() {
+  cancel_loading();
 }
 
 STreeNodeType FileNode::get_type() const {
@@ -36,11 +43,136 @@ int FileNode::num_children() const {
     // TODO: Ugly! But no other way.  QT's tree model has const virtual interface but we need lazy
     // loading.
     FileNode* fn = const_cast<FileNode*>(this);
-    fn->count_and_process_dir(true);
+    if (type != FB_DIR) {
+      fn->count_and_process_dir(true);
+    } else if (!pending_entries.empty()) {
+      // Prefetched.  The view is asking right now, so the first rows go in without notifying it.
+      fn->is_loaded = true;
+      if (fn->populate_chunk(FB_POPULATE_CHUNK, false)) {
+        dynamic_cast<FileBrowser*>(fn->file_provider)->schedule_populate(fn);
+      }
+    } else if (!is_wanted) {
+      fn->is_wanted = true;
+      fn->start_loading();
+      fn->prefetch_siblings();
+    }
   }
   return children.size();
 }
 
+void FileNode::start_loading() {
+  if (pending_listing) return;
+  FileBrowser* file_browser = dynamic_cast<FileBrowser*>(file_provider);
+  pending_listing = master_io_provider->list_dir_async(abs_path, file_browser->get_filter(),
+      [this, file_browser](AsyncIOResult& result) {
+    pending_listing.reset();
+    if (is_loaded) return;
+
+    if (!result.ok) {
+      // Not wanted yet: try again once it is.
+      if (!is_wanted) return;
+      STreeChangeNotifier* fpcn = file_provider->get_change_notifier();
+      if (fpcn) fpcn->begin_rows_insert(this, 0, 1);
+      process_error(true);
+      if (fpcn) fpcn->end_rows_insert();
+      return;
+    }
+
+    pending_entries = std::move(result.entries);
+    num_pending_done = 0;
+    if (is_wanted) {
+      is_loaded = true;
+      if (populate_chunk(FB_POPULATE_CHUNK, true)) file_browser->schedule_populate(this);
+    }
+  });
+}
+
+void FileNode::prefetch_siblings() {
+  // Prefetching remote directories would only hold up the listings that were asked for.
+  if (parent == nullptr || !master_io_provider->is_local(abs_path)) return;
+  FileNode* fn_parent = dynamic_cast<FileNode*>(parent);
+  int num_prefetched = 0;
+  for (std::unique_ptr<FileNode>& sibling : fn_parent->children) {
+    if (num_prefetched >= FB_PREFETCH_SIBLINGS) return;
+    FileNode* fn = sibling.get();
+    if (fn == this || fn->type != FB_DIR || fn->is_loaded || fn->pending_listing
+        || !fn->pending_entries.empty()) continue;
+    fn->start_loading();
+    num_prefetched++;
+  }
+}
+
+void FileNode::cancel_loading() {
+  if (pending_listing) {
+    pending_listing->cancel();
+    pending_listing.reset();
+  }
+  if (!pending_entries.empty()) {
+    pending_entries.clear();
+    num_pending_done = 0;
+    dynamic_cast<FileBrowser*>(file_provider)->unschedule_populate(this);
+  }
+  is_wanted = false;
+}
+
+bool FileNode::populate_chunk(unsigned int max_rows, bool notify) {
+  const unsigned int count = std::min<unsigned int>(max_rows, pending_entries.size() - num_pending_done);
+  if (count > 0) {
+    STreeChangeNotifier* fpcn = notify ? file_provider->get_change_notifier() : nullptr;
+    const int start = children.size();
+    if (fpcn) fpcn->begin_rows_insert(this, start, count);
+    for (unsigned int i = 0; i < count; i++) {
+      add_entry(pending_entries[num_pending_done + i], start + i);
+    }
+    if (fpcn) fpcn->end_rows_insert();
+    num_pending_done += count;
+  }
+  if (num_pending_done < pending_entries.size()) return true;
+  pending_entries.clear();
+  num_pending_done = 0;
+  return false;
+}
+
+void FileNode::complete_loading(const std::vector<DirEntry>* entries) {
+  if (is_loaded) {
+    if (!pending_entries.empty()) {
+      populate_chunk(UINT_MAX, true);
+      dynamic_cast<FileBrowser*>(file_provider)->unschedule_populate(this);
+    }
+    return;
+  }
+  if (type != FB_DIR) {
+    if (entries) process_entries(*entries, true);
+    else count_and_process_dir(true);
+    return;
+  }
+
+  // If the view has asked for the rows, it has been told there are none so far.
+  const bool notify = is_wanted;
+  if (pending_listing) {
+    pending_listing->cancel();
+    pending_listing.reset();
+  }
+  if (entries) {
+    pending_entries = *entries;
+    num_pending_done = 0;
+  } else if (pending_entries.empty()) {
+    FileBrowser* file_browser = dynamic_cast<FileBrowser*>(file_provider);
+    try {
+      pending_entries = master_io_provider->list_dir(abs_path, file_browser->get_filter());
+      num_pending_done = 0;
+    } catch (std::exception& e) {
+      STreeChangeNotifier* fpcn = notify ? file_provider->get_change_notifier() : nullptr;
+      if (fpcn) fpcn->begin_rows_insert(this, 0, 1);
+      process_error(true);
+      if (fpcn) fpcn->end_rows_insert();
+      return;
+    }
+  }
+  is_loaded = true;
+  populate_chunk(UINT_MAX, notify);
+}
+
 bool FileNode::is_leaf() const {
   if (type == FB_DIR || type == FB_ROOT || type == FB_PROJECT_ROOT) return false;
   return true;
@@ -51,11 +183,11 @@ void FileNode::add_known_documents(KnownDocuments* kd) {
     kd->add_document(abs_path);
     return;
   }
-  if (!is_loaded) {
+  if (!is_loaded || !pending_entries.empty()) {
     FileBrowser* file_browser = dynamic_cast<FileBrowser*>(file_provider);
     if (file_browser->get_is_project()) {
-      count_and_process_dir(true);
-    } else return;
+      complete_loading(nullptr);
+    } else if (!is_loaded) return;
   }
   for (std::unique_ptr<FileNode>& fn: children) {
     fn->add_known_documents(kd);
@@ -93,39 +225,66 @@ int FileNode::count_and_process_dir(bool process) {
 
   try {
     std::vector<DirEntry> entries = master_io_provider->list_dir(abs_path, filter);
-    is_loaded = true;
-
-    int j = 0;
-    if (type == FB_ROOT && movable) {
-      std::string parent_path;
-      if (master_io_provider->parent_dir(abs_path, parent_path)) {
-        j++;
-        if (process) {
-          const int child_type = FB_PARENT;
-          children.push_back(std::unique_ptr<FileNode>(new FileNode(this, file_browser, j, "..", parent_path, child_type)));
-        }
-      }
-    }
+    return process_entries(entries, process);
+  } catch (std::exception& e) {
+    return process_error(process);
+  }
+}
+
+int FileNode::process_error(bool process) {
+  FileBrowser* file_browser = dynamic_cast<FileBrowser*>(file_provider);
+  is_loaded = true;
+  if (process) {
+    // TODO: In the future, maybe make IO error clickable with e.what().
+    children.push_back(std::unique_ptr<FileNode>(new FileNode(this, file_browser, 0, "I/O Error", "", FB_WARNING)));
+  }
+  return 1;
+}
 
-    for (DirEntry& de: entries) {
+int FileNode::process_entries(const std::vector<DirEntry>& entries, bool process) {
+  FileBrowser* file_browser = dynamic_cast<FileBrowser*>(file_provider);
+  is_loaded = true;
+
+  int j = 0;
+  if (type == FB_ROOT && movable) {
+    std::string parent_path;
+    if (master_io_provider->parent_dir(abs_path, parent_path)) {
+      j++;
       if (process) {
-        int child_type = FB_FILE;
-        if (de.type == DirEntryType::DIR) child_type = FB_DIR;
-        if (de.type == DirEntryType::LINK) child_type = FB_LINK;
-        std::string child_full_path;
-        if (abs_path.empty()) child_full_path = de.name;
-        else child_full_path = UtilPath::join_components(abs_path, de.name);
-        children.push_back(std::unique_ptr<FileNode>(new FileNode(this, file_browser, j, de.name, child_full_path, child_type)));
+        const int child_type = FB_PARENT;
+        children.push_back(std::unique_ptr<FileNode>(new FileNode(this, file_browser, j, "..", parent_path, child_type)));
       }
-      j++;
-    }
-    return j;
-  } catch (std::exception& e) {
-    if (process) {
-      // TODO: In the future, maybe make IO error clickable with e.what().
-      children.push_back(std::unique_ptr<FileNode>(new FileNode(this, file_browser, 0, "I/O Error", "", FB_WARNING)));
     }
-    return 1;
+  }
+
+  for (const DirEntry& de: entries) {
+    if (process) add_entry(de, j);
+    j++;
+  }
+  return j;
+}
+
+void FileNode::add_entry(const DirEntry& de, int index) {
+  FileBrowser* file_browser = dynamic_cast<FileBrowser*>(file_provider);
+  int child_type = FB_FILE;
+  if (de.type == DirEntryType::DIR) child_type = FB_DIR;
+  if (de.type == DirEntryType::LINK) child_type = FB_LINK;
+  std::string child_full_path;
+  if (abs_path.empty()) child_full_path = de.name;
+  else child_full_path = UtilPath::join_components(abs_path, de.name);
+  children.push_back(std::unique_ptr<FileNode>(new FileNode(this, file_browser, index, de.name, child_full_path, child_type)));
+  master.invalidate_known_documents();
+}
+
+void FileNode::load_listings(const std::map<std::string, std::vector<DirEntry>>& listings) {
+  if (is_leaf()) return;
+  if (!is_loaded || !pending_entries.empty()) {
+    auto it = listings.find(abs_path);
+    if (it == listings.end()) return;
+    complete_loading(&it->second);
+  }
+  for (std::unique_ptr<FileNode>& fn: children) {
+    fn->load_listings(listings);
   }
 }
 
@@ -133,6 +292,34 @@ FileBrowser::FileBrowser(const std::string& path) : movable(true), is_project(fa
   current_dir_abs = UtilPath::to_absolute(path);
   root_node = std::unique_ptr<FileNode>(new FileNode(nullptr, this, 0, "File browser", current_dir_abs, FB_ROOT));
   root_node->set_movable(movable);
+
+  populate_timer = new QTimer();
+  populate_timer->setInterval(0);
+  QObject::connect(populate_timer, &QTimer::timeout, [this]() {
+    if (populating.empty()) {
+      populate_timer->stop();
+      return;
+    }
+    FileNode* fn = populating.front();
+    if (!fn->populate_chunk(FB_POPULATE_CHUNK, true)) unschedule_populate(fn);
+  });
+}
+
+FileBrowser::~FileBrowser() {
+  if (pending_listing) pending_listing->cancel();
+  // Nodes unschedule themselves as they go.
+  root_node.reset();
+  delete populate_timer;
+}
+
+void FileBrowser::schedule_populate(FileNode* fn) {
+  if (std::find(populating.begin(), populating.end(), fn) == populating.end()) populating.push_back(fn);
+  if (!populate_timer->isActive()) populate_timer->start();
+}
+
+void FileBrowser::unschedule_populate(FileNode* fn) {
+  populating.erase(std::remove(populating.begin(), populating.end(), fn), populating.end());
+  if (populating.empty()) populate_timer->stop();
 }
 
 STreeNode* FileBrowser::get_root_node() {
@@ -148,22 +335,35 @@ void FileBrowser::activate(const STreeNode* fpn, STreeChangeNotifier* fpcn) {
       if (!movable) return;
 
       {
-        std::string new_path = fn->abs_path;
-
-        int num_rows = root_node->num_children();
-        fpcn->begin_rows_delete(root_node.get(), num_rows);
-        root_node->children.clear();
-        fpcn->end_rows_delete();
-
-        current_dir_abs = new_path;
-        master.settings.set_current_path(current_dir_abs);
-
-        root_node->abs_path = current_dir_abs;
-        root_node->type = FB_ROOT;
-        num_rows = root_node->count_and_process_dir(false);
-        fpcn->begin_rows_insert(root_node.get(), num_rows);
-        root_node->count_and_process_dir(true);
-        fpcn->end_rows_insert();
+        // List the new directory in the background and only then swap the rows.
+        const std::string new_path = fn->abs_path;
+        if (pending_listing) pending_listing->cancel();
+        pending_listing = master_io_provider->list_dir_async(new_path, get_filter(),
+            [this, new_path, fpcn](AsyncIOResult& result) {
+          pending_listing.reset();
+
+          int num_rows = root_node->num_children();
+          fpcn->begin_rows_delete(root_node.get(), num_rows);
+          root_node->children.clear();
+          fpcn->end_rows_delete();
+          master.invalidate_known_documents();
+
+          current_dir_abs = new_path;
+          master.settings.set_current_path(current_dir_abs);
+
+          root_node->abs_path = current_dir_abs;
+          root_node->type = FB_ROOT;
+          if (result.ok) {
+            num_rows = root_node->process_entries(result.entries, false);
+            fpcn->begin_rows_insert(root_node.get(), num_rows);
+            root_node->process_entries(result.entries, true);
+          } else {
+            num_rows = root_node->process_error(false);
+            fpcn->begin_rows_insert(root_node.get(), num_rows);
+            root_node->process_error(true);
+          }
+          fpcn->end_rows_insert();
+        });
       }
       break;
     case FB_FILE:
@@ -173,10 +373,15 @@ void FileBrowser::activate(const STreeNode* fpn, STreeChangeNotifier* fpcn) {
 }
 
 void FileBrowser::refresh_node(FileNode* fn, STreeChangeNotifier* fpcn) {
-  int num_rows = fn->num_children();
+  master_io_provider->refresh(fn->abs_path);
+  if (project_index) project_index->rescan();
+  fn->cancel_loading();
+
+  int num_rows = fn->children.size();
   fpcn->begin_rows_delete(fn, num_rows);
   fn->children.clear();
   fpcn->end_rows_delete();
+  master.invalidate_known_documents();
 
   num_rows = fn->count_and_process_dir(false);
   fpcn->begin_rows_insert(fn, num_rows);
@@ -308,6 +513,21 @@ STreeSave FileBrowser::get_save_info() const {
 }
 
 void FileBrowser::populate_known_documents(KnownDocuments* kd) {
+  if (project_index && project_index->is_ready()) {
+    for (const std::string& abs_path : project_index->get_files()) kd->add_document(abs_path);
+    return;
+  }
+  if (is_project) {
+    // Fetch the whole tree at once, much cheaper than a listing per directory on remote
+    // filesystems.  Anything missing is loaded lazily by add_known_documents.
+    try {
+      const auto listings = master_io_provider->list_dir_recursive(root_node->abs_path, get_filter(), -1);
+      if (project_index) project_index->set_listings(listings);
+      root_node->load_listings(listings);
+    } catch (std::exception& e) {
+      printf("WARNING: Could not list project '%s': %s\n", root_node->abs_path.c_str(), e.what());
+    }
+  }
   root_node->add_known_documents(kd);
 }
 
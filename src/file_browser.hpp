@@ -1,8 +1,12 @@
 #ifndef SYNTAXIC_FILE_BROWSER_HPP
 #define SYNTAXIC_FILE_BROWSER_HPP
 
+#include "async_io.hpp"
+#include "io_provider.hpp"
+#include "project_index.hpp"
 #include "stree.hpp"
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -16,7 +20,13 @@
 #define FB_PROJECT_ROOT 6
 #define FB_LINK       7
 
+/** Rows inserted into an expanding directory per turn of the event loop. */
+#define FB_POPULATE_CHUNK 500
+/** When a directory is expanded, at most this many of its sibling directories are listed ahead. */
+#define FB_PREFETCH_SIBLINGS 8
+
 class FileBrowser;
+class QTimer;
 class UIWindow;
 
 class FileNode : public STreeNode {
@@ -29,8 +39,30 @@ private:
   int type;
   bool movable;
 
+  // Subdirectories are listed in the background when first expanded (or ahead of that, when a
+  // sibling is expanded), and their rows inserted a chunk at a time.
+
+  /** Listing in progress. */
+  std::shared_ptr<AsyncIORequest> pending_listing;
+  /** The view has asked for the rows (and was told there are none yet). */
+  bool is_wanted;
+  /** Listed, but not yet turned into children. */
+  std::vector<DirEntry> pending_entries;
+  unsigned int num_pending_done;
+
+  void start_loading();
+  void prefetch_siblings();
+  void cancel_loading();
+  /** Insert up to max_rows of pending_entries, notifying the view if notify.  Returns true if more
+  remain. */
+  bool populate_chunk(unsigned int max_rows, bool notify);
+  /** Finish loading synchronously, out of entries if given. */
+  void complete_loading(const std::vector<DirEntry>* entries);
+  void add_entry(const DirEntry& de, int index);
+
 public:
   FileNode(STreeNode* p, FileBrowser* fb, int index, const std::string& short_name, const std::string& abs_path, int type);
+  virtual ~FileNode();
 
   virtual STreeNodeType get_type() const;
   virtual std::string text() const;
@@ -40,11 +72,20 @@ public:
   virtual STreeNode* get_child(int child);
 
   int count_and_process_dir(bool process);
+  /** Same as count_and_process_dir but with an already fetched listing. */
+  int process_entries(const std::vector<DirEntry>& entries, bool process);
+  /** Single "I/O Error" child. */
+  int process_error(bool process);
+  /** Load this node and all nodes below it out of listings (as returned by
+  IOProvider::list_dir_recursive) without further I/O. */
+  void load_listings(const std::map<std::string, std::vector<DirEntry>>& listings);
   void add_known_documents(KnownDocuments* kd);
   inline void set_movable(bool b) { movable = b; }
 };
 
 class FileBrowser : public STree {
+  friend class FileNode;
+
 protected:
   std::string current_dir_abs;
   std::unique_ptr<FileNode> root_node;
@@ -53,11 +94,22 @@ protected:
   bool movable;
   std::string filter;
   bool is_project;
+  /** Listing of the directory we are moving to, if any. */
+  std::shared_ptr<AsyncIORequest> pending_listing;
+  /** Projects only. */
+  std::unique_ptr<ProjectIndex> project_index;
+  /** Nodes with pending_entries left to insert, and the timer that inserts them. */
+  std::vector<FileNode*> populating;
+  QTimer* populate_timer;
+
+  void schedule_populate(FileNode* fn);
+  void unschedule_populate(FileNode* fn);
 
   void set_project(const std::string& project_name);
 
 public:
   FileBrowser(const std::string& path);
+  virtual ~FileBrowser();
 
   inline std::string get_current_dir_abs() { return current_dir_abs; }
 
@@ -1,10 +1,18 @@
+#include "core/util_glob.hpp"
 #include "core/util_path.hpp"
 #include "file_io_provider.hpp"
 
+#include <algorithm>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 
+#ifndef CMAKE_WINDOWS
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
+#endif
+
 bool FileIOProvider::is_handled(const std::string& /* abs_path */) {
   return true;
 }
@@ -41,20 +49,20 @@ std::vector<DirEntry> FileIOProvider::list_dir(const std::string& abs_path, cons
     return output;
   }
 
+  const std::shared_ptr<const UtilGlob::GlobSet> globs = UtilGlob::compile_filter(filter);
+
+#ifdef CMAKE_WINDOWS
   const QDir q_dir(QString::fromStdString(abs_path));
   if (!q_dir.exists() || !q_dir.isReadable()) {
     throw IOProviderError("Cannot read directory " + abs_path);
   }
 
-  const QString q_filter = QString::fromStdString(filter);
-  const bool to_filter = !filter.empty();
-
   const QList<QFileInfo> list = q_dir.entryInfoList();
   for (int i = 0; i < list.size(); i++) {
     const QFileInfo& fi = list[i];
     std::string file_name = fi.fileName().toStdString();
     if (file_name == "." || file_name == "..") continue;
-    if (to_filter && QDir::match(q_filter, fi.fileName())) continue;
+    if (globs->matches(file_name)) continue;
 
     DirEntry entry;
     entry.name = file_name;
@@ -63,6 +71,42 @@ std::vector<DirEntry> FileIOProvider::list_dir(const std::string& abs_path, cons
     if (fi.isSymLink()) entry.type = DirEntryType::LINK;
     output.push_back(entry);
   }
+#else
+  // readdir gives the type of most entries for free, QFileInfo would stat every one of them.
+  DIR* dir = opendir(abs_path.c_str());
+  if (dir == nullptr) throw IOProviderError("Cannot read directory " + abs_path);
+
+  struct dirent* de;
+  while ((de = readdir(dir)) != nullptr) {
+    // Hidden files are skipped, as QDir does by default.
+    if (de->d_name[0] == '.') continue;
+    const std::string file_name(de->d_name);
+    if (globs->matches(file_name)) continue;
+
+    DirEntry entry;
+    entry.name = file_name;
+    entry.type = DirEntryType::FILE;
+    unsigned char d_type = de->d_type;
+    if (d_type == DT_UNKNOWN) {
+      // Some file systems do not fill in d_type.
+      struct stat st;
+      if (lstat(UtilPath::join_components(abs_path, file_name).c_str(), &st) == 0) {
+        if (S_ISDIR(st.st_mode)) d_type = DT_DIR;
+        else if (S_ISLNK(st.st_mode)) d_type = DT_LNK;
+      }
+    }
+    if (d_type == DT_DIR) entry.type = DirEntryType::DIR;
+    if (d_type == DT_LNK) entry.type = DirEntryType::LINK;
+    output.push_back(entry);
+  }
+  closedir(dir);
+
+  std::sort(output.begin(), output.end(), [](const DirEntry& a, const DirEntry& b) {
+    const int c = strcasecmp(a.name.c_str(), b.name.c_str());
+    if (c != 0) return c < 0;
+    return a.name < b.name;
+  });
+#endif
   return output;
 }
 
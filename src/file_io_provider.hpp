@@ -14,6 +14,7 @@ public:
   virtual void remove(const std::string& abs_path);
   virtual std::vector<char> read_file(const std::string& abs_path);
   virtual void write_file_safe(const std::string& abs_path, const char* data, unsigned int size);
+  virtual bool is_thread_safe() { return true; }
 };
 
 #endif
\ No newline at end of file
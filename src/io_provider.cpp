@@ -0,0 +1,28 @@
+#include "core/util_path.hpp"
+#include "io_provider.hpp"
+
+std::map<std::string, std::vector<DirEntry>> IOProvider::list_dir_recursive(const std::string& abs_path,
+    const std::string& filter, int max_depth) {
+  std::map<std::string, std::vector<DirEntry>> listings;
+
+  std::vector<std::string> level;
+  level.push_back(abs_path);
+  for (int depth = 0; !level.empty() && (max_depth < 0 || depth <= max_depth); depth++) {
+    std::vector<std::string> next_level;
+    for (const std::string& path : level) {
+      std::vector<DirEntry> entries;
+      try {
+        entries = list_dir(path, filter);
+      } catch (IOProviderError& e) {
+        // Unreadable directories are simply left out.
+        continue;
+      }
+      for (const DirEntry& de : entries) {
+        if (de.type == DirEntryType::DIR) next_level.push_back(UtilPath::join_components(path, de.name));
+      }
+      listings[path] = entries;
+    }
+    level.swap(next_level);
+  }
+  return listings;
+}
@@ -2,6 +2,7 @@
 #define SYNTAXIC_IO_PROVIDER_HPP
 
 #include <cstdint>
+#include <map>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -40,6 +41,18 @@ public:
   virtual bool parent_dir(const std::string& abs_path, std::string& output) = 0;
   virtual std::vector<DirEntry> list_dir(const std::string& abs_path, const std::string& filter) = 0;
   virtual unsigned long get_file_size(const std::string& abs_path) = 0;
+  /** List abs_path and all directories underneath it, down to max_depth levels (-1 for no limit).
+  Returns a map from absolute path of every listed directory to its entries.  Links are not
+  followed.  Default implementation calls list_dir for every directory, providers where each
+  call is expensive should override it. */
+  virtual std::map<std::string, std::vector<DirEntry>> list_dir_recursive(const std::string& abs_path,
+      const std::string& filter, int max_depth);
+  /** Drop any cached information about abs_path and everything underneath it. */
+  virtual void refresh(const std::string& /* abs_path */) {}
+  /** Can this provider be used from several threads at once? */
+  virtual bool is_thread_safe() { return false; }
+  /** Is the provider in the middle of an operation on abs_path, so that another one would fail? */
+  virtual bool is_busy(const std::string& /* abs_path */) { return false; }
 
 
   // Operate on the filesystem
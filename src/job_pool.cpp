@@ -0,0 +1,180 @@
+#include "core/utf8_util.hpp"
+#include "job_pool.hpp"
+
+#include <QProcess>
+#include <QString>
+#include <QTimer>
+
+JobPool::JobPool(int m) : num_running(0), max_running(m < 1 ? 1 : m), next_id(0) {
+  // Jobs are started from the event loop, so that callbacks never run before spawn() returns.
+  start_timer = new QTimer();
+  start_timer->setSingleShot(true);
+  start_timer->setInterval(0);
+  QObject::connect(start_timer, &QTimer::timeout, [this]() { start_pending(); });
+}
+
+JobPool::~JobPool() {
+  cancel_all();
+  delete start_timer;
+}
+
+int JobPool::spawn(const JobSpec& spec, JobOutputCallback on_output, JobFinishedCallback on_finished) {
+  const int id = next_id++;
+  std::unique_ptr<Job> job(new Job);
+  job->id = id;
+  job->spec = spec;
+  job->on_output = on_output;
+  job->on_finished = on_finished;
+  job->process = nullptr;
+  job->timer = nullptr;
+  job->result.exit_code = 0;
+  job->result.failed = false;
+  job->result.timed_out = false;
+  jobs[id] = std::move(job);
+  pending.push_back(id);
+  start_timer->start();
+  return id;
+}
+
+void JobPool::start_pending() {
+  while (num_running < max_running && !pending.empty()) {
+    const int id = pending.front();
+    pending.pop_front();
+    auto it = jobs.find(id);
+    if (it == jobs.end()) continue;
+    start_job(it->second.get());
+  }
+}
+
+void JobPool::start_job(Job* job) {
+  const int id = job->id;
+  QProcess* process = new QProcess();
+  job->process = process;
+  num_running++;
+
+  QObject::connect(process, &QProcess::readyReadStandardOutput, [this, id]() {
+    auto it = jobs.find(id);
+    if (it != jobs.end()) read_output(it->second.get(), ProcessOutputType::STD_OUT, false);
+  });
+  QObject::connect(process, &QProcess::readyReadStandardError, [this, id]() {
+    auto it = jobs.find(id);
+    if (it != jobs.end()) read_output(it->second.get(), ProcessOutputType::STD_ERR, false);
+  });
+  QObject::connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+      [this, id](int exit_code, QProcess::ExitStatus status) {
+    auto it = jobs.find(id);
+    if (it == jobs.end()) return;
+    JobResult& result = it->second->result;
+    result.exit_code = exit_code;
+    if (status == QProcess::CrashExit && !result.timed_out) {
+      result.failed = true;
+      result.error = "Crashed.";
+    }
+    finish_job(id);
+  });
+  // Finished is not emitted if the process never started.
+  QObject::connect(process, static_cast<void (QProcess::*)(QProcess::ProcessError)>(&QProcess::error),
+      [this, id](QProcess::ProcessError err) {
+    if (err != QProcess::FailedToStart) return;
+    auto it = jobs.find(id);
+    if (it == jobs.end()) return;
+    it->second->result.failed = true;
+    it->second->result.error = "Failed to start.";
+    finish_job(id);
+  });
+
+  if (job->spec.timeout > 0) {
+    job->timer = new QTimer();
+    job->timer->setSingleShot(true);
+    QObject::connect(job->timer, &QTimer::timeout, [this, id]() {
+      auto it = jobs.find(id);
+      if (it == jobs.end()) return;
+      it->second->result.failed = true;
+      it->second->result.timed_out = true;
+      it->second->result.error = "Timed out.";
+      it->second->process->kill();
+    });
+    job->timer->start(job->spec.timeout);
+  }
+
+  process->start(QString::fromStdString(job->spec.command));
+  // Written as soon as the process starts.
+  if (!job->spec.stdin_data.empty()) {
+    process->write(job->spec.stdin_data.data(), job->spec.stdin_data.size());
+  }
+  process->closeWriteChannel();
+}
+
+void JobPool::read_output(Job* job, ProcessOutputType::Type type, bool flush) {
+  QByteArray data;
+  if (type == ProcessOutputType::STD_OUT) data = job->process->readAllStandardOutput();
+  else data = job->process->readAllStandardError();
+
+  // Only whole lines are converted and delivered, so that multi-byte characters are never split.
+  std::string& partial = type == ProcessOutputType::STD_OUT ? job->partial_out : job->partial_err;
+  partial.append(data.constData(), data.size());
+  size_t end = partial.size();
+  if (!flush) {
+    end = partial.rfind('\n');
+    if (end == std::string::npos) return;
+    end++;
+  }
+  if (end == 0) return;
+
+  std::string text = utf8_convert_best(partial.data(), end);
+  partial.erase(0, end);
+  if (type == ProcessOutputType::STD_OUT) job->result.std_out += text;
+  else job->result.std_err += text;
+  // Callback may cancel the job, so job must not be touched after it.
+  if (job->on_output) job->on_output(job->id, text, type);
+}
+
+void JobPool::finish_job(int id) {
+  auto it = jobs.find(id);
+  if (it == jobs.end()) return;
+  std::unique_ptr<Job> job = std::move(it->second);
+  jobs.erase(it);
+  num_running--;
+
+  // Job is no longer in jobs, so output callbacks cannot cancel it from under us.
+  read_output(job.get(), ProcessOutputType::STD_OUT, true);
+  read_output(job.get(), ProcessOutputType::STD_ERR, true);
+  kill_job(job.get());
+
+  start_timer->start();
+  if (job->on_finished) job->on_finished(id, job->result);
+}
+
+void JobPool::kill_job(Job* job) {
+  // We may be inside one of the process' signals, hence deleteLater.
+  if (job->process != nullptr) {
+    job->process->disconnect();
+    if (job->process->state() != QProcess::NotRunning) job->process->kill();
+    job->process->deleteLater();
+    job->process = nullptr;
+  }
+  if (job->timer != nullptr) {
+    job->timer->disconnect();
+    job->timer->stop();
+    job->timer->deleteLater();
+    job->timer = nullptr;
+  }
+}
+
+void JobPool::cancel(int job_id) {
+  auto it = jobs.find(job_id);
+  if (it == jobs.end()) return;
+  if (it->second->process != nullptr) {
+    kill_job(it->second.get());
+    num_running--;
+    start_timer->start();
+  }
+  jobs.erase(it);
+}
+
+void JobPool::cancel_all() {
+  for (auto& p : jobs) kill_job(p.second.get());
+  jobs.clear();
+  pending.clear();
+  num_running = 0;
+}
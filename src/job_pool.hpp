@@ -0,0 +1,79 @@
+#ifndef SYNTAXIC_JOB_POOL_HPP
+#define SYNTAXIC_JOB_POOL_HPP
+
+#include "process_impl.hpp"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+class QProcess;
+class QTimer;
+
+struct JobSpec {
+  std::string command;
+  std::string stdin_data;
+  /** Kill the job after this many milliseconds, 0 for no limit. */
+  int timeout;
+};
+
+struct JobResult {
+  int exit_code;
+  /** Could not be started, crashed or timed out. */
+  bool failed;
+  bool timed_out;
+  std::string error;
+  std::string std_out;
+  std::string std_err;
+};
+
+typedef std::function<void(int job_id, const std::string& text, ProcessOutputType::Type type)> JobOutputCallback;
+typedef std::function<void(int job_id, const JobResult& result)> JobFinishedCallback;
+
+/** Runs external commands without blocking the event loop.  At most max_running run at once, the
+rest wait in order.  Output is delivered in whole lines as it arrives, and the complete output once
+the job is finished.  All callbacks are invoked on the event loop. */
+class JobPool {
+private:
+  struct Job {
+    int id;
+    JobSpec spec;
+    JobOutputCallback on_output;
+    JobFinishedCallback on_finished;
+    QProcess* process;
+    QTimer* timer;
+    JobResult result;
+    std::string partial_out, partial_err;
+  };
+
+  std::map<int, std::unique_ptr<Job>> jobs;
+  std::deque<int> pending;
+  int num_running;
+  int max_running;
+  int next_id;
+  QTimer* start_timer;
+
+  void start_pending();
+  void start_job(Job* job);
+  void read_output(Job* job, ProcessOutputType::Type type, bool flush);
+  void finish_job(int id);
+  void kill_job(Job* job);
+
+public:
+  JobPool(int max_running);
+  ~JobPool();
+
+  inline void set_max_running(int m) { max_running = m < 1 ? 1 : m; }
+
+  /** Returns id of the job.  on_output may be empty. */
+  int spawn(const JobSpec& spec, JobOutputCallback on_output, JobFinishedCallback on_finished);
+  /** Kill or dequeue the job.  No more callbacks are invoked for it. */
+  void cancel(int job_id);
+  void cancel_all();
+  inline int get_num_running() const { return num_running; }
+  inline int get_num_pending() const { return pending.size(); }
+};
+
+#endif
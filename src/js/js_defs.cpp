@@ -1,6 +1,8 @@
 #include "core/util_path.hpp"
 #include "master_io_provider.hpp"
 
+#include <stdexcept>
+
 DFUNC void duk_addOverlay(int handle, int row, int col, int type, const char* text) {
   Doc* doc = master.js_get_doc(handle);
   if (doc == nullptr) return;
@@ -10,7 +12,7 @@ DFUNC void duk_addOverlay(int handle, int row, int col, int type, const char* te
 
 DFUNC void duk_clearOverlays(int handle) {
   Doc* doc = master.js_get_doc(handle);
-  if (doc != nullptr) doc->get_appendage().rich_text.overlays.clear();
+  if (doc != nullptr) doc->get_appendage().rich_text.clear_overlays();
 }
 
 DFUNC void duk_clearPluginMenu() {
@@ -125,7 +127,7 @@ DFUNC std::string duk_promptText(const char* title, const char* text, const char
 static void syn_addMenu_callback(std::string name) {
   if (master_js->stored_menus.count(name) == 0) return;
   get_js_internal(global_ctx, name);
-  int rv = duk_pcall(global_ctx, 0);
+  int rv = master_js->call_profiled(name, 0);
   if (rv != DUK_EXEC_SUCCESS) {
     master.feedback("Javascript Error", duk_to_string(global_ctx, -1));
   }
@@ -194,6 +196,174 @@ static duk_ret_t syn_getDocSelection(duk_context* ctx) {
   return 1;
 }
 
+/** Push an array of lines [start, end) of the buffer, clamped to the buffer. */
+static void push_doc_lines(duk_context* ctx, const TextBuffer* tb, int start, int end) {
+  if (start < 0) start = 0;
+  if (end > tb->get_num_lines()) end = tb->get_num_lines();
+  duk_push_array(ctx);
+  std::string scratch;
+  for (int row = start; row < end; row++) {
+    scratch.clear();
+    tb->get_line(row).append_utf8(scratch);
+    duk_push_lstring(ctx, scratch.data(), scratch.size());
+    duk_put_prop_index(ctx, -2, row - start);
+  }
+}
+
+/** Syn.getDocLines( handle, start, end ) */
+static duk_ret_t syn_getDocLines(duk_context* ctx) {
+  int handle = duk_require_int(ctx, 0);
+  int start = duk_require_int(ctx, 1);
+  int end = duk_require_int(ctx, 2);
+  Doc* doc = master.js_get_doc(handle);
+  if (doc == nullptr) return 0;
+  push_doc_lines(ctx, doc->get_text_buffer(), start, end);
+  return 1;
+}
+
+/** Syn.getDocMemory( handle ) */
+static duk_ret_t syn_getDocMemory(duk_context* ctx) {
+  int handle = duk_require_int(ctx, 0);
+  Doc* doc = master.js_get_doc(handle);
+  if (doc == nullptr) return 0;
+  MemoryUsage usage;
+  master.get_document_memory(doc, usage);
+
+  duk_push_object(ctx);
+  for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+    duk_push_number(ctx, usage.bytes[i]); duk_put_prop_string(ctx, -2, MemoryUsage::get_name(i));
+  }
+  duk_push_number(ctx, usage.total()); duk_put_prop_string(ctx, -2, "total");
+  return 1;
+}
+
+/** Syn.getDocVersion( handle ) */
+static duk_ret_t syn_getDocVersion(duk_context* ctx) {
+  int handle = duk_require_int(ctx, 0);
+  Doc* doc = master.js_get_doc(handle);
+  if (doc == nullptr) return 0;
+  duk_push_number(ctx, doc->get_version());
+  return 1;
+}
+
+/** Lines of a doc buffer are converted in blocks of this many, on first access. */
+#define DOC_BUFFER_BLOCK 256
+/** Internal (non-enumerable) property holding the converted blocks. */
+#define DOC_BUFFER_BLOCKS "\xff" "blocks"
+
+/** Get the doc of 'this' doc buffer, error if it has been closed or edited since. */
+static Doc* doc_buffer_get_doc(duk_context* ctx) {
+  duk_push_this(ctx);
+  duk_get_prop_string(ctx, -1, "handle");
+  Doc* doc = master.js_get_doc(duk_require_int(ctx, -1));
+  duk_pop(ctx);
+  duk_get_prop_string(ctx, -1, "version");
+  const double version = duk_require_number(ctx, -1);
+  duk_pop_2(ctx);
+  if (doc == nullptr) duk_error(ctx, DUK_ERR_ERROR, "Document has been closed.");
+  if (doc->get_version() != version) duk_error(ctx, DUK_ERR_ERROR, "Document has changed.");
+  return doc;
+}
+
+/** buffer.line( row ) */
+static duk_ret_t syn_doc_buffer_line(duk_context* ctx) {
+  int row = duk_require_int(ctx, 0);
+  const TextBuffer* tb = doc_buffer_get_doc(ctx)->get_text_buffer();
+  if (row < 0 || row >= tb->get_num_lines()) return 0;
+  const int block = row / DOC_BUFFER_BLOCK;
+
+  duk_push_this(ctx);
+  duk_get_prop_string(ctx, -1, DOC_BUFFER_BLOCKS);
+  duk_get_prop_index(ctx, -1, block);
+  if (duk_is_undefined(ctx, -1)) {
+    duk_pop(ctx);
+    push_doc_lines(ctx, tb, block * DOC_BUFFER_BLOCK, (block + 1) * DOC_BUFFER_BLOCK);
+    duk_dup_top(ctx);
+    duk_put_prop_index(ctx, -3, block);
+  }
+  duk_get_prop_index(ctx, -1, row % DOC_BUFFER_BLOCK);
+  return 1;
+}
+
+/** buffer.lines( start, end ) */
+static duk_ret_t syn_doc_buffer_lines(duk_context* ctx) {
+  int start = duk_require_int(ctx, 0);
+  int end = duk_require_int(ctx, 1);
+  push_doc_lines(ctx, doc_buffer_get_doc(ctx)->get_text_buffer(), start, end);
+  return 1;
+}
+
+/** Syn.getDocBuffer( handle ) */
+static duk_ret_t syn_getDocBuffer(duk_context* ctx) {
+  int handle = duk_require_int(ctx, 0);
+  Doc* doc = master.js_get_doc(handle);
+  if (doc == nullptr) return 0;
+
+  duk_push_object(ctx);
+  duk_push_int(ctx, handle); duk_put_prop_string(ctx, -2, "handle");
+  duk_push_number(ctx, doc->get_version()); duk_put_prop_string(ctx, -2, "version");
+  duk_push_int(ctx, doc->get_text_buffer()->get_num_lines()); duk_put_prop_string(ctx, -2, "numLines");
+  duk_push_array(ctx); duk_put_prop_string(ctx, -2, DOC_BUFFER_BLOCKS);
+  duk_push_c_function(ctx, syn_doc_buffer_line, 1); duk_put_prop_string(ctx, -2, "line");
+  duk_push_c_function(ctx, syn_doc_buffer_lines, 2); duk_put_prop_string(ctx, -2, "lines");
+  return 1;
+}
+
+/** Read the edits array into replacements, returns false if it is malformed. */
+static bool read_doc_edits(duk_context* ctx, duk_idx_t idx, std::vector<TextReplacement>& replacements) {
+  if (!duk_is_array(ctx, idx)) return false;
+  const int len = duk_get_length(ctx, idx);
+  for (int i = 0; i < len; i++) {
+    duk_get_prop_index(ctx, idx, i);
+    if (!duk_is_object(ctx, -1)) {
+      duk_pop(ctx);
+      return false;
+    }
+    TextReplacement tr;
+    int* fields[] = { &tr.start.row, &tr.start.col, &tr.end.row, &tr.end.col };
+    const char* names[] = { "startRow", "startCol", "endRow", "endCol" };
+    bool ok = true;
+    for (int j = 0; j < 4; j++) {
+      duk_get_prop_string(ctx, -1, names[j]);
+      if (duk_is_number(ctx, -1)) *fields[j] = duk_get_int(ctx, -1);
+      else ok = false;
+      duk_pop(ctx);
+    }
+    duk_get_prop_string(ctx, -1, "text");
+    if (duk_is_string(ctx, -1)) tr.text = duk_get_string(ctx, -1);
+    duk_pop_2(ctx);
+    if (!ok) return false;
+    replacements.push_back(tr);
+  }
+  return true;
+}
+
+/** Syn.applyDocEdits( handle, edits ) */
+static duk_ret_t syn_applyDocEdits(duk_context* ctx) {
+  int handle = duk_require_int(ctx, 0);
+  Doc* doc = master.js_get_doc(handle);
+  if (doc == nullptr) return 0;
+
+  // duk_error does not unwind C++, so it is only raised once the vector is gone.
+  int rv = -1;
+  const char* error = nullptr;
+  {
+    std::vector<TextReplacement> replacements;
+    if (!read_doc_edits(ctx, 1, replacements)) {
+      error = "Edits must be an array of {startRow, startCol, endRow, endCol, text}.";
+    } else {
+      try {
+        rv = doc->handle_replacements(replacements);
+      } catch (std::invalid_argument&) {
+        error = "Edits must not overlap.";
+      }
+    }
+  }
+  if (error != nullptr) duk_error(ctx, DUK_ERR_RANGE_ERROR, "%s", error);
+  duk_push_int(ctx, rv);
+  return 1;
+}
+
 /** Syn.system( obj ) */
 static duk_ret_t syn_system(duk_context* ctx) {
   duk_require_object_coercible(ctx, 0);
@@ -241,6 +411,91 @@ static duk_ret_t syn_system(duk_context* ctx) {
   return 1;
 }
 
+/** Syn.spawn( obj, callback ) */
+static void syn_spawn_output(int job_id, const std::string& text, ProcessOutputType::Type type) {
+  get_js_internal(global_ctx, "spawn_obj_" + std::to_string(job_id));
+  duk_get_prop_string(global_ctx, -1, type == ProcessOutputType::STD_OUT ? "onStdout" : "onStderr");
+  if (!duk_is_function(global_ctx, -1)) {
+    duk_pop_3(global_ctx);
+    return;
+  }
+  duk_push_lstring(global_ctx, text.data(), text.size());
+  int rv = duk_pcall(global_ctx, 1);
+  if (rv != DUK_EXEC_SUCCESS) {
+    master.feedback("Javascript Error", duk_to_string(global_ctx, -1));
+  }
+  duk_pop_3(global_ctx);
+}
+
+static void syn_spawn_finished(int job_id, const JobResult& result) {
+  const std::string obj_name = "spawn_obj_" + std::to_string(job_id);
+  const std::string cb_name = "spawn_cb_" + std::to_string(job_id);
+  get_js_internal(global_ctx, cb_name);
+  if (duk_is_function(global_ctx, -1)) {
+    duk_push_object(global_ctx);
+    duk_push_int(global_ctx, result.exit_code);
+    duk_put_prop_string(global_ctx, -2, "exitCode");
+    duk_push_lstring(global_ctx, result.std_out.data(), result.std_out.size());
+    duk_put_prop_string(global_ctx, -2, "stdout");
+    duk_push_lstring(global_ctx, result.std_err.data(), result.std_err.size());
+    duk_put_prop_string(global_ctx, -2, "stderr");
+    duk_push_boolean(global_ctx, result.failed);
+    duk_put_prop_string(global_ctx, -2, "failed");
+    duk_push_boolean(global_ctx, result.timed_out);
+    duk_put_prop_string(global_ctx, -2, "timedOut");
+    duk_push_string(global_ctx, result.error.c_str());
+    duk_put_prop_string(global_ctx, -2, "error");
+    int rv = duk_pcall(global_ctx, 1);
+    if (rv != DUK_EXEC_SUCCESS) {
+      master.feedback("Javascript Error", duk_to_string(global_ctx, -1));
+    }
+  }
+  duk_pop_2(global_ctx);
+  delete_js_internal(global_ctx, obj_name);
+  delete_js_internal(global_ctx, cb_name);
+}
+
+static duk_ret_t syn_spawn(duk_context* ctx) {
+  duk_require_object_coercible(ctx, 0);
+
+  JobSpec spec;
+  duk_get_prop_string(ctx, 0, "command");
+  spec.command = std::string(duk_require_string(ctx, -1));
+  duk_pop(ctx);
+
+  duk_get_prop_string(ctx, 0, "stdin");
+  if (duk_get_type(ctx, -1) == DUK_TYPE_STRING) {
+    spec.stdin_data = std::string(duk_require_string(ctx, -1));
+  }
+  duk_pop(ctx);
+
+  duk_get_prop_string(ctx, 0, "timeout");
+  spec.timeout = 0;
+  if (duk_get_type(ctx, -1) == DUK_TYPE_NUMBER) {
+    spec.timeout = duk_get_int(ctx, -1);
+  }
+  duk_pop(ctx);
+
+  JobPool* job_pool = master_js->job_pool.get();
+  job_pool->set_max_running(master.pref_manager.get_int("plugins.max_jobs"));
+  // Jobs never start before we return, so callbacks can be attached after spawning.
+  int job_id = job_pool->spawn(spec, syn_spawn_output, syn_spawn_finished);
+  attach_js_internal(ctx, "spawn_obj_" + std::to_string(job_id), 0);
+  attach_js_internal(ctx, "spawn_cb_" + std::to_string(job_id), 1);
+
+  duk_push_int(ctx, job_id);
+  return 1;
+}
+
+/** Syn.cancelSpawn( id ) */
+static duk_ret_t syn_cancelSpawn(duk_context* ctx) {
+  int job_id = duk_require_int(ctx, 0);
+  master_js->job_pool->cancel(job_id);
+  delete_js_internal(ctx, "spawn_obj_" + std::to_string(job_id));
+  delete_js_internal(ctx, "spawn_cb_" + std::to_string(job_id));
+  return 0;
+}
+
 //////////////// INIT EXTRAS
 
 static void add_func(duk_context* ctx, duk_ret_t (*func)(duk_context*), const char* name, int num_params) {
@@ -254,8 +509,15 @@ static void init_extras(duk_context* ctx) {
   duk_get_global_string(ctx, "Syn");
   ADD_FUNC(addPluginMenuItem, 3);
   ADD_FUNC(addPluginCallback, 2);
+  ADD_FUNC(applyDocEdits, 2);
+  ADD_FUNC(cancelSpawn, 1);
+  ADD_FUNC(getDocBuffer, 1);
   ADD_FUNC(getDocCursorLocation, 1);
+  ADD_FUNC(getDocLines, 3);
+  ADD_FUNC(getDocMemory, 1);
   ADD_FUNC(getDocSelection, 1);
+  ADD_FUNC(getDocVersion, 1);
+  ADD_FUNC(spawn, 2);
   ADD_FUNC(system, 1);
   duk_pop(ctx); // Syn
 }
\ No newline at end of file
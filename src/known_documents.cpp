@@ -1,6 +1,9 @@
 #include "core/util.hpp"
 #include "known_documents.hpp"
 
+#include <algorithm>
+#include <functional>
+
 void KnownDocuments::add_document(const std::string& abs_path) {
   if (set_paths.count(abs_path) > 0) return;
   set_paths.insert(abs_path);
@@ -13,4 +16,108 @@ std::vector<KnownDocument> KnownDocuments::get() {
   }
 
   return vec;
-}
\ No newline at end of file
+}
+
+////////////////////////////////////////////////////////////// KnownDocumentIndex
+
+static inline bool is_separator(char c) {
+  return c == '/' || c == '\\';
+}
+
+/** Non-empty components of path, "." components left out. */
+static void split_components(const std::string& path, std::vector<std::string>& components) {
+  components.clear();
+  unsigned int start = 0;
+  for (unsigned int i = 0; i <= path.size(); i++) {
+    if (i < path.size() && !is_separator(path[i])) continue;
+    if (i > start && !(i == start + 1 && path[start] == '.')) {
+      components.push_back(path.substr(start, i - start));
+    }
+    start = i + 1;
+  }
+}
+
+/** Hash of the last num components, same whatever the separators. */
+static size_t hash_suffix(const std::vector<std::string>& components, int num) {
+  std::string suffix;
+  for (int i = components.size() - num; i < int(components.size()); i++) {
+    suffix += components[i];
+    suffix += '/';
+  }
+  return std::hash<std::string>()(suffix);
+}
+
+/** File name up to the first dot, like QFileInfo::baseName. */
+static std::string basename_of(const std::string& file_name) {
+  return file_name.substr(0, file_name.find('.'));
+}
+
+/** Number of trailing components common to both. */
+static int count_common_suffix(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+  int num = 0;
+  while (num < int(a.size()) && num < int(b.size())
+      && a[a.size() - num - 1] == b[b.size() - num - 1]) num++;
+  return num;
+}
+
+void KnownDocumentIndex::clear() {
+  paths.clear();
+  suffixes.clear();
+  basenames.clear();
+}
+
+void KnownDocumentIndex::add(const std::string& abs_path) {
+  std::vector<std::string> components;
+  split_components(abs_path, components);
+  if (components.empty()) return;
+
+  const int index = paths.size();
+  paths.push_back(abs_path);
+  const int depth = std::min<int>(components.size(), KNOWN_DOCUMENTS_SUFFIX_DEPTH);
+  for (int num = 1; num <= depth; num++) {
+    suffixes.insert(std::make_pair(hash_suffix(components, num), index));
+  }
+  basenames.insert(std::make_pair(std::hash<std::string>()(basename_of(components.back())), index));
+}
+
+void KnownDocumentIndex::find(const std::string& partial_path,
+    std::vector<KnownDocumentMatch>& matches) const {
+  std::vector<std::string> components, candidate;
+  split_components(partial_path, components);
+  // Leading ".." can never match.
+  while (!components.empty() && components.front() == "..") components.erase(components.begin());
+  if (components.empty()) return;
+
+  // Longest indexed suffix first, anything matched there is not looked at again.
+  std::unordered_map<int, int> found;
+  const int depth = std::min<int>(components.size(), KNOWN_DOCUMENTS_SUFFIX_DEPTH);
+  for (int num = depth; num >= 1; num--) {
+    auto range = suffixes.equal_range(hash_suffix(components, num));
+    for (auto it = range.first; it != range.second; ++it) {
+      if (found.count(it->second) > 0) continue;
+      split_components(paths[it->second], candidate);
+      const int common = count_common_suffix(components, candidate);
+      // Otherwise a hash collision.
+      if (common >= num) found[it->second] = common;
+    }
+  }
+
+  const size_t old_size = matches.size();
+  for (const auto& p : found) matches.push_back({ paths[p.first], p.second });
+
+  const std::string basename = basename_of(components.back());
+  auto range = basenames.equal_range(std::hash<std::string>()(basename));
+  for (auto it = range.first; it != range.second; ++it) {
+    if (found.count(it->second) > 0) continue;
+    split_components(paths[it->second], candidate);
+    if (basename_of(candidate.back()) != basename) continue;
+    found[it->second] = 0;
+    matches.push_back({ paths[it->second], 0 });
+  }
+
+  std::sort(matches.begin() + old_size, matches.end(),
+      [](const KnownDocumentMatch& a, const KnownDocumentMatch& b) {
+    if (a.num_components != b.num_components) return a.num_components > b.num_components;
+    return a.abs_path < b.abs_path;
+  });
+}
@@ -2,9 +2,14 @@
 #define SYNTAXIC_KNOWN_DOCUMENTS_HPP
 
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+/** Index only the last this many components of paths, longer partial paths are verified against
+the candidates of their last components. */
+#define KNOWN_DOCUMENTS_SUFFIX_DEPTH 4
+
 struct KnownDocument {
   std::string abs_path;
   std::string file_name;
@@ -17,6 +22,34 @@ private:
 public:
   void add_document(const std::string& abs_path);
   std::vector<KnownDocument> get();
+  inline const std::unordered_set<std::string>& get_paths() const { return set_paths; }
+};
+
+struct KnownDocumentMatch {
+  std::string abs_path;
+  /** Number of trailing components of the partial path matched, 0 if only the basename matched. */
+  int num_components;
+};
+
+/** Known documents by the trailing components of their paths (file name, "core/line.cpp", ...)
+and by basename, so that partial paths such as those in compiler output are resolved without
+going through every known document. */
+class KnownDocumentIndex {
+private:
+  std::vector<std::string> paths;
+  /** Hash of the last 1 to KNOWN_DOCUMENTS_SUFFIX_DEPTH components to index into paths. */
+  std::unordered_multimap<size_t, int> suffixes;
+  /** Hash of the basename to index into paths. */
+  std::unordered_multimap<size_t, int> basenames;
+
+public:
+  void clear();
+  void add(const std::string& abs_path);
+  inline int size() const { return paths.size(); }
+
+  /** Documents whose path ends with (some trailing components of) partial_path, longest match
+  first, followed by documents with the same basename as partial_path. */
+  void find(const std::string& partial_path, std::vector<KnownDocumentMatch>& matches) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -14,6 +14,10 @@
 
 #include "utf8.h"
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <utility>
 #include <QFileInfo>
 #include <QInputDialog>
 #include <QMessageBox>
@@ -23,7 +27,8 @@
 // TODO: Change to a pointer.
 Master master;
 
-Master::Master() : main_window(nullptr), markovian(0), markovian_avalanche(0) {}
+Master::Master() : main_window(nullptr), known_documents_dirty(true), last_memory_check(0),
+    markovian(0), markovian_avalanche(0), finishing_opens(false) {}
 
 Master::~Master() {}
 
@@ -46,10 +51,16 @@ void Master::init_master() {
     read_file(file_contents, under_root("syntaxic_meta.json"));
 
     // Load themes:
-    theme_engine.init_theme_engine(file_contents.data(), file_contents.size());
+    {
+      PhaseTimer timer(startup_trace, "Themes");
+      theme_engine.init_theme_engine(file_contents.data(), file_contents.size());
+    }
 
     // Load statlang meta.
-    stat_lang.init(file_contents.data(), file_contents.size());
+    {
+      PhaseTimer timer(startup_trace, "StatLang meta");
+      stat_lang.init(file_contents.data(), file_contents.size());
+    }
   } catch (std::exception& e) {
     std::string text = "Error while starting Syntaxic:\n\n";
     text += e.what();
@@ -59,8 +70,11 @@ void Master::init_master() {
         QString::fromStdString(text));
   }
 
-  pref_manager.init();
-  reload_settings();
+  {
+    PhaseTimer timer(startup_trace, "Preferences");
+    pref_manager.init();
+    reload_settings();
+  }
 
   // TODO: This is temporary
   // Create temporary document
@@ -72,6 +86,7 @@ void Master::add_file_provider(std::unique_ptr<STree> fp, bool expand) {
   main_window->add_file_provider(fp.get(), expand);
   file_providers.push_back(std::move(fp));
   save_file_providers();
+  invalidate_known_documents();
 }
 
 void Master::remove_file_provider(STree* provider) {
@@ -80,6 +95,7 @@ void Master::remove_file_provider(STree* provider) {
     if (file_providers[i].get() == provider) {
       file_providers.erase(file_providers.begin() + i);
       save_file_providers();
+      invalidate_known_documents();
       return;
     }
   }
@@ -115,16 +131,15 @@ void Master::new_document(UIWindow* pref_window) {
   pref_window->add_document(documents.back().get(), true);
 }
 
-void Master::open_document(const char* p, UIWindow* pref_window, int row, int col) {
-  std::string path = UtilPath::to_absolute(p);
-  recent_files->add(path);
-
-  if (UtilPath::get_lowercase_extension(path) == ".synproj") {
-    open_project(std::string(p));
-    return;
+UIWindow* Master::live_window(UIWindow* w) {
+  if (w == nullptr || w == main_window.get()) return main_window.get();
+  for (auto& uiw: uiwindows) {
+    if (uiw.get() == w) return w;
   }
+  return main_window.get();
+}
 
-  // Check that path is not already open?
+bool Master::go_to_open_document(const std::string& path, int row, int col) {
   for (auto& doc : documents) {
     Document* document = dynamic_cast<Document*>(doc.get());
     if (document == nullptr) continue;
@@ -134,32 +149,103 @@ void Master::open_document(const char* p, UIWindow* pref_window, int row, int co
       if (row > -1 && col > -1) {
         doc->handle_jump_to(row, col);
       }
-      return;
+      return true;
     }
   }
+  return false;
+}
 
-  // Find pref_window
-  if (pref_window == nullptr) {
-    pref_window = main_window.get();
+void Master::open_document(const char* p, UIWindow* pref_window, int row, int col) {
+  std::string path = UtilPath::to_absolute(p);
+  recent_files->add(path);
+
+  if (UtilPath::get_lowercase_extension(path) == ".synproj") {
+    open_project(std::string(p));
+    return;
+  }
+
+  // Check that path is not already open?
+  if (go_to_open_document(path, row, col)) return;
+
+  // Size and contents are fetched in the background, so that slow disks or remote files do not
+  // freeze the window.  Windows are looked up again once the results arrive.  Files are read in
+  // parallel, but added to tabs in the order they were requested.
+  std::shared_ptr<PendingOpen> open = std::make_shared<PendingOpen>();
+  open->path = path;
+  open->pref_window = pref_window;
+  open->row = row;
+  open->col = col;
+  open->is_big_file = false;
+  open->done = false;
+  open->ok = false;
+  pending_opens.push_back(open);
+  master_io_provider->get_file_size_async(path, [this, open](AsyncIOResult& result) {
+    open_document_sized(open, result);
+  });
+}
+
+void Master::open_document_sized(std::shared_ptr<PendingOpen> open, AsyncIOResult& result) {
+  UIWindow* pref_window = live_window(open->pref_window);
+
+  if (!result.ok) {
+    pref_window->get_user_input("Error getting file size", result.error, UI_OK | UI_WARNING);
+    open->done = true;
+    finish_pending_opens();
+    return;
   }
 
   // Check it's not too big
-  bool is_big_file = false;
-  try {
-    long int size = master_io_provider->get_file_size(path);
-    if (size > long(5*1024*1024)) {
-      float mbs = size / (1024.0*1024.0);
-      int answer = pref_window->get_user_input("Big file", "File '" + path + "' is big (" + std::to_string(mbs) + " MB).\n\nSyntaxic is not currently optimized for opening big files.  Performance may be bad and memory usage may be excessive.\n\nAre you sure you wish to continue opening this file?",
-          UI_YES | UI_NO | UI_WARNING);
-      if (answer == UI_NO) return;
-    }
-    if (size > long(pref_manager.get_int("loading.big_file_limit")*1024)) {
-      is_big_file = true;
+  long int size = result.size;
+  if (size > long(5*1024*1024)) {
+    float mbs = size / (1024.0*1024.0);
+    int answer = pref_window->get_user_input("Big file", "File '" + open->path + "' is big (" + std::to_string(mbs) + " MB).\n\nSyntaxic is not currently optimized for opening big files.  Performance may be bad and memory usage may be excessive.\n\nAre you sure you wish to continue opening this file?",
+        UI_YES | UI_NO | UI_WARNING);
+    if (answer == UI_NO) {
+      open->done = true;
+      finish_pending_opens();
+      return;
     }
-  } catch (IOProviderError& e) {
-    pref_window->get_user_input("Error getting file size", e.what(), UI_OK | UI_WARNING);
-    return;
   }
+  if (size > long(pref_manager.get_int("loading.big_file_limit")*1024)) {
+    open->is_big_file = true;
+  }
+
+  master_io_provider->read_file_async(open->path, 0, [this, open](AsyncIOResult& result) {
+    open_document_loaded(open, result);
+  });
+}
+
+void Master::open_document_loaded(std::shared_ptr<PendingOpen> open, AsyncIOResult& result) {
+  if (!result.ok) {
+    live_window(open->pref_window)->get_user_input("Error opening " + open->path, result.error,
+        UI_OK | UI_WARNING);
+  } else {
+    open->contents = std::move(result.contents);
+    open->ok = true;
+  }
+  open->done = true;
+  finish_pending_opens();
+}
+
+void Master::finish_pending_opens() {
+  // Adding a document may ask about encoding, and more opens can finish in that dialog's event
+  // loop.  The outermost call adds them.
+  if (finishing_opens) return;
+  finishing_opens = true;
+  while (!pending_opens.empty() && pending_opens.front()->done) {
+    std::shared_ptr<PendingOpen> open = pending_opens.front();
+    pending_opens.pop_front();
+    if (open->ok) add_opened_document(*open);
+  }
+  finishing_opens = false;
+}
+
+void Master::add_opened_document(PendingOpen& open) {
+  UIWindow* pref_window = live_window(open.pref_window);
+  const std::string& path = open.path;
+
+  // Might have been opened while we were reading.
+  if (go_to_open_document(path, open.row, open.col)) return;
 
   // Look at the last document in pref_window, is it a new document? If so, close it.
   if (documents.size() > 0) {
@@ -176,10 +262,7 @@ void Master::open_document(const char* p, UIWindow* pref_window, int row, int co
   tf->change_path(path);
   for (;;) {
     try {
-      tf->load();
-    } catch (IOProviderError& e) {
-      pref_window->get_user_input("Error opening " + path, e.what(), UI_OK | UI_WARNING);
-      return;
+      tf->load_contents(open.contents);
     } catch (EncodingError& e) {
       MainWindow* main_window = dynamic_cast<MainWindow*>(pref_window);
       if (main_window == nullptr) return;
@@ -203,12 +286,15 @@ void Master::open_document(const char* p, UIWindow* pref_window, int row, int co
     break;
   }
 
-  std::unique_ptr<Document> doc(new Document(std::move(tf), is_big_file));
-  documents.push_back(std::move(doc));
-  pref_window->add_document(documents.back().get(), true);
+  Document* document = new Document(std::move(tf), open.is_big_file);
+  documents.push_back(std::unique_ptr<Doc>(document));
+  // The dialog above may have closed the window.
+  pref_window = live_window(open.pref_window);
+  pref_window->add_document(document, true);
+  int row = open.row, col = open.col;
   if (col < 0) col = 0;
   if (row > -1 && col > -1) {
-    documents.back()->handle_jump_to(row, col);
+    document->handle_jump_to(row, col);
   }
 }
 
@@ -478,6 +564,148 @@ void Master::get_known_documents(std::vector<KnownDocument>& known_docs) {
   known_docs = kd.get();
 }
 
+void Master::find_known_documents(const std::string& partial_path,
+    std::vector<KnownDocumentMatch>& matches) {
+  if (known_documents_dirty) {
+    KnownDocuments kd;
+    for (auto& fp: file_providers) {
+      fp->populate_known_documents(&kd);
+    }
+    // Populating may itself load more of the trees, which is already accounted for.
+    known_documents_dirty = false;
+    known_document_index.clear();
+    for (const std::string& abs_path : kd.get_paths()) known_document_index.add(abs_path);
+  }
+
+  // Open documents come and go, and there are few of them.
+  KnownDocumentIndex open_index;
+  for (auto& doc: documents) {
+    Document* document = dynamic_cast<Document*>(doc.get());
+    if (document == nullptr) continue;
+    if (document->get_text_file()->is_new()) continue;
+    open_index.add(document->get_text_file()->get_absolute_path());
+  }
+  std::vector<KnownDocumentMatch> open_matches;
+  open_index.find(partial_path, open_matches);
+  known_document_index.find(partial_path, matches);
+
+  // Merge, best first.
+  std::unordered_set<std::string> seen;
+  for (const KnownDocumentMatch& m : matches) seen.insert(m.abs_path);
+  for (const KnownDocumentMatch& m : open_matches) {
+    if (seen.count(m.abs_path) == 0) matches.push_back(m);
+  }
+  std::stable_sort(matches.begin(), matches.end(), [](const KnownDocumentMatch& a, const KnownDocumentMatch& b) {
+    return a.num_components > b.num_components;
+  });
+}
+
+void Master::get_document_memory(Doc* doc, MemoryUsage& usage) {
+  doc->get_text_buffer()->add_memory_usage(usage);
+  Document* document = dynamic_cast<Document*>(doc);
+  if (document != nullptr) {
+    usage.bytes[MEM_UNDO] += document->get_text_file()->get_undo_manager().get_memory_usage();
+  }
+  const int id = doc->get_appendage().statlang_id;
+  if (id > 0) stat_lang.add_memory_usage(id, usage);
+  if (doc->get_collection() != nullptr) doc->get_collection()->add_view_memory_usage(doc, usage);
+}
+
+static bool is_background(Doc* doc) {
+  return doc->get_collection() == nullptr || doc->get_collection()->get_current_doc() != doc;
+}
+
+std::string Master::get_memory_report() {
+  std::vector<std::pair<MemoryUsage, Doc*>> usages;
+  MemoryUsage total;
+  for (auto& doc: documents) {
+    usages.push_back(std::make_pair(MemoryUsage(), doc.get()));
+    get_document_memory(doc.get(), usages.back().first);
+    total += usages.back().first;
+  }
+  std::stable_sort(usages.begin(), usages.end(), [](const std::pair<MemoryUsage, Doc*>& a,
+      const std::pair<MemoryUsage, Doc*>& b) {
+    return a.first.total() > b.first.total();
+  });
+
+  char line[128];
+  std::string output;
+  snprintf(line, sizeof(line), "Documents: %.1f KB, memory.budget: %d MB\n\n", total.total() / 1024.0,
+      pref_manager.get_int("memory.budget"));
+  output += line;
+  for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+    snprintf(line, sizeof(line), "  %-16s %12.1f KB\n", MemoryUsage::get_name(i), total.bytes[i] / 1024.0);
+    output += line;
+  }
+  for (const auto& p : usages) {
+    Doc* doc = p.second;
+    const int id = doc->get_appendage().statlang_id;
+    snprintf(line, sizeof(line), "\n%.1f KB  ", p.first.total() / 1024.0);
+    output += line;
+    output += doc->get_long_title();
+    if (is_background(doc)) output += " [background]";
+    if (id > 0 && stat_lang.is_released(id)) output += " [released]";
+    output += '\n';
+    for (int i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+      if (p.first.bytes[i] == 0) continue;
+      snprintf(line, sizeof(line), "  %-16s %12.1f KB\n", MemoryUsage::get_name(i), p.first.bytes[i] / 1024.0);
+      output += line;
+    }
+  }
+  return output;
+}
+
+void Master::document_shown(Doc* doc) {
+  const int id = doc->get_appendage().statlang_id;
+  const bool big_file = (doc->get_display_style() & DocFlag::BIG_DOC) != 0;
+  if (id > 0 && !big_file && stat_lang.is_released(id)) {
+    RichText* rich_text = &(doc->get_appendage().rich_text);
+    stat_lang.process_document(id, rich_text);
+    stat_lang.highlight_document(id, doc->get_cursor(), rich_text);
+  }
+
+  const double now = get_timestamp();
+  if (now - last_memory_check < MEMORY_PRESSURE_CHECK_INTERVAL) return;
+  last_memory_check = now;
+  relieve_memory_pressure();
+}
+
+size_t Master::relieve_memory_pressure() {
+  const size_t budget = size_t(pref_manager.get_int("memory.budget")) << 20;
+  std::vector<std::pair<size_t, Doc*>> background;
+  size_t total = 0;
+  for (auto& doc: documents) {
+    MemoryUsage usage;
+    get_document_memory(doc.get(), usage);
+    total += usage.total();
+    if (is_background(doc.get())) background.push_back(std::make_pair(usage.total(), doc.get()));
+  }
+  if (total <= budget) return 0;
+
+  std::stable_sort(background.begin(), background.end(), [](const std::pair<size_t, Doc*>& a,
+      const std::pair<size_t, Doc*>& b) {
+    return a.first > b.first;
+  });
+  size_t freed = 0;
+  for (const auto& p : background) {
+    if (total - freed <= budget) break;
+    Doc* doc = p.second;
+    MemoryUsage before;
+    get_document_memory(doc, before);
+
+    Document* document = dynamic_cast<Document*>(doc);
+    if (document != nullptr) document->get_text_file()->get_undo_manager().trim(MEMORY_PRESSURE_UNDO_BYTES);
+    // Big documents are never analyzed.
+    const int id = doc->get_appendage().statlang_id;
+    if (id > 0 && (doc->get_display_style() & DocFlag::BIG_DOC) == 0) stat_lang.release_document(id);
+
+    MemoryUsage after;
+    get_document_memory(doc, after);
+    freed += before.total() - after.total();
+  }
+  return freed;
+}
+
 void Master::reload_settings() {
   int tabdef = master.pref_manager.get_tabdef();
   for (auto& d: documents) {
@@ -587,16 +815,14 @@ void Master::go_to_navigable(const std::string& navigable) {
     }
   }
 
-  // Otherwise, get last component of parts1[0] and find a file that matches it among known files.
+  // Otherwise, find a known file whose path ends the same way as parts1[0].
   {
-    std::string last_comp = last_component(parts1[0]);
-
-    std::vector<KnownDocument> known_docs;
-    get_known_documents(known_docs);
+    std::vector<KnownDocumentMatch> matches;
+    find_known_documents(parts1[0], matches);
 
-    for (KnownDocument& kd: known_docs) {
-      if (kd.file_name == last_comp) {
-        open_document(kd.abs_path.c_str(), nullptr, row, col);
+    for (KnownDocumentMatch& m: matches) {
+      if (m.num_components > 0) {
+        open_document(m.abs_path.c_str(), nullptr, row, col);
         return;
       }
     }
@@ -610,92 +836,132 @@ void Master::go_to_navigable(const std::string& navigable) {
   }
 }
 
+/** Shared by the callbacks of a global find. */
+struct GlobalFindState {
+  std::string term;
+  std::vector<std::string> paths;
+  std::map<std::string, int> indices;
+  /** Matching (row, line) pairs and errors per file, so that the output does not depend on the
+  order in which files were read. */
+  std::vector<std::vector<std::pair<int, std::string>>> matches;
+  std::vector<std::string> errors;
+  int num_errors;
+  int num_binary;
+};
+
+static void global_find_search(GlobalFindState& state, AsyncIOResult& result) {
+  const int index = state.indices[result.abs_path];
+  if (!result.ok) {
+    state.num_errors += 1;
+    state.errors[index] = "Error while reading '" + result.abs_path + "': " + result.error + "\n";
+    return;
+  }
+  if (result.too_big) return;
+  if (is_binary_file(result.contents.data(), result.contents.size())) {
+    state.num_binary++;
+    return;
+  }
+  TextBuffer tb;
+  tb.from_utf8(utf8_convert_best(result.contents.data(), result.contents.size()));
+  for (int i = 0; i < tb.get_num_lines(); i++) {
+    std::string line = tb.get_line(i).to_string();
+    if (line.find(state.term) != std::string::npos) {
+      state.matches[index].push_back(std::make_pair(i, line));
+    }
+  }
+}
+
+static void global_find_output(GlobalFindState& state, TextBuffer& output) {
+  const std::string& term = state.term;
+  for (unsigned int i = 0; i < state.paths.size(); i++) {
+    for (auto& match: state.matches[i]) {
+      const std::string& line = match.second;
+      size_t found = line.find(term);
+      output.append(state.paths[i], 7);
+      output.append(std::string(":") + std::to_string(match.first+1) + ": ");
+      output.append(line.substr(0, found), 0);
+      output.append(line.substr(found, term.size()), 3);
+      output.append(line.substr(found + term.size()) + "\n");
+    }
+  }
+
+  if (state.num_binary > 0) {
+    output.append(std::to_string(state.num_binary) + " binary files ignored.\n", 2);
+  }
+  if (state.num_errors > 0) {
+    output.append(std::to_string(state.num_errors) + " errors:\n", 0);
+    std::string error_text;
+    for (const std::string& error: state.errors) error_text += error;
+    output.append(error_text, 10);
+  }
+}
+
 void Master::global_find(const std::string& term) {
   std::vector<KnownDocument> known_docs;
   get_known_documents(known_docs);
-  QProgressDialog progress("Global find...", "Cancel", 0, known_docs.size(), dynamic_cast<MainWindow*> (get_main_window()));
-  progress.setMinimumDuration(500);
-  progress.setWindowModality(Qt::WindowModal);
-
-  TextBuffer output;
-  int i = 0;
-  int num_errors = 0;
-  int num_binary = 0;
-  std::string error_text;
+
+  std::shared_ptr<GlobalFindState> state = std::make_shared<GlobalFindState>();
+  state->term = term;
+  state->num_errors = 0;
+  state->num_binary = 0;
+  std::vector<std::string>& paths = state->paths;
   for (KnownDocument& kd: known_docs) {
-    progress.setValue(i); i++;
-    if (progress.wasCanceled()) return;
-    try {
-      if (master_io_provider->get_file_size(kd.abs_path) < 1000000) {
-        std::vector<char> contents = master_io_provider->read_file(kd.abs_path);
-        if (is_binary_file(contents.data(), contents.size())) {
-          num_binary++;
-          continue;
-        }
-        TextBuffer tb;
-        tb.from_utf8(utf8_convert_best(contents.data(), contents.size()));
-        for (int i = 0; i < tb.get_num_lines(); i++) {
-          std::string line = tb.get_line(i).to_string();
-          size_t found = line.find(term);
-          if (found != std::string::npos) {
-            output.append(kd.abs_path, 7);
-            output.append(std::string(":") + std::to_string(i+1) + ": ");
-            output.append(line.substr(0, found), 0);
-            output.append(line.substr(found, term.size()), 3);
-            output.append(line.substr(found + term.size()) + "\n");
-          }
-        }
-      }
-    } catch (std::exception& e) {
-      num_errors += 1;
-      error_text += "Error while reading '" + kd.abs_path + "': " + e.what() + "\n";
-    }
+    state->indices[kd.abs_path] = paths.size();
+    paths.push_back(kd.abs_path);
   }
+  state->matches.resize(paths.size());
+  state->errors.resize(paths.size());
 
-  if (num_binary > 0) {
-    output.append(std::to_string(num_binary) + " binary files ignored.\n", 2);
-  }
-  if (num_errors > 0) {
-    output.append(std::to_string(num_errors) + " errors:\n", 0);
-    output.append(error_text, 10);
+  if (paths.empty()) {
+    TextBuffer output;
+    global_find_output(*state, output);
+    open_temp_read_only_document("Search results", output);
+    return;
   }
-  progress.setValue(known_docs.size());
-  open_temp_read_only_document("Search results", output);
+
+  // Files are read in the background, the dialog is not modal so that editing can go on.
+  QProgressDialog* progress = new QProgressDialog("Global find...", "Cancel", 0, paths.size(), dynamic_cast<MainWindow*> (get_main_window()));
+  progress->setMinimumDuration(500);
+  progress->setValue(0);
+
+  std::shared_ptr<AsyncIORequest> request = master_io_provider->read_files_async(paths, 1000000,
+      [state](AsyncIOResult& result) {
+        global_find_search(*state, result);
+      },
+      [this, state, progress](int num_done, int num_total) {
+        progress->setValue(num_done);
+        if (num_done < num_total) return;
+        progress->deleteLater();
+        TextBuffer output;
+        global_find_output(*state, output);
+        open_temp_read_only_document("Search results", output);
+      });
+  QObject::connect(progress, &QProgressDialog::canceled, [request, progress]() {
+    request->cancel();
+    progress->deleteLater();
+  });
 }
 
 int Master::js_get_current_doc() {
   MainWindow* mw = dynamic_cast<MainWindow*>(main_window.get());
   Doc* doc = mw->get_active_document();
-  int i = 0;
-  for (auto& d: documents) {
-    if (d.get() == doc) {
-      return i;
-    }
-    i++;
-  }
-  return -1;
+  if (doc == nullptr) return -1;
+  return js_get_doc_handle(doc);
 }
 
 int Master::js_get_shell_doc() {
-  int i = 0;
   for (auto& d: documents) {
     if (d->get_display_style() & DocFlag::SHELL_THEME) {
-      return i;
+      return js_get_doc_handle(d.get());
     }
-    i++;
   }
   return -1;
 }
 
 Doc* Master::js_get_doc(int handle) {
-  if (handle < 0) return nullptr;
-  if (handle >= int(documents.size())) return nullptr;
-  return documents[handle].get();
+  return doc_handles.get(handle);
 }
 
 int Master::js_get_doc_handle(Doc* doc) {
-  for (unsigned int i = 0; i < documents.size(); i++) {
-    if (documents[i].get() == doc) return i;
-  }
-  return -1;
+  return doc_handles.get_handle(doc);
 }
\ No newline at end of file
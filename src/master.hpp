@@ -2,6 +2,8 @@
 #define SYNTAXIC_MASTER_HPP
 
 #include "core/common.hpp"
+#include "core/handle_table.hpp"
+#include "core/phase_trace.hpp"
 #include "stree.hpp"
 #include "keymapper.hpp"
 #include "known_documents.hpp"
@@ -12,11 +14,15 @@
 #include "theme.hpp"
 #include "tool.hpp"
 
+#include <deque>
+#include <memory>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
 class Document;
 class Recents;
+struct AsyncIOResult;
 class UIWindow;
 
 struct Bookmark {
@@ -24,6 +30,11 @@ struct Bookmark {
   int row, col;
 };
 
+/** Undo history left to documents in background tabs under memory pressure (bytes). */
+#define MEMORY_PRESSURE_UNDO_BYTES (1 << 20)
+/** Memory pressure is checked at most this often (s), estimating it walks every line. */
+#define MEMORY_PRESSURE_CHECK_INTERVAL 2.0
+
 #define MARKOVIAN_NONE     0
 #define MARKOVIAN_BOOKMARK 1
 #define MARKOVIAN_KILL     2
@@ -33,6 +44,8 @@ private:
   std::vector<Bookmark> bookmarks;
   Bookmark temp_bookmark;
   std::vector<std::unique_ptr<Doc>> documents;
+  /** Handles of documents given to plugins. */
+  HandleTable<Doc> doc_handles;
   std::unique_ptr<Document> temp_doc;
 
   std::unique_ptr<UIWindow> main_window;
@@ -40,11 +53,40 @@ private:
   std::vector<std::unique_ptr<UIWindow>> uiwindows;
   std::vector<std::unique_ptr<SynTool>> tools;
   std::vector<std::unique_ptr<STree>> file_providers;
+  /** Documents of all file providers, rebuilt on the first lookup after they change. */
+  KnownDocumentIndex known_document_index;
+  bool known_documents_dirty;
+  double last_memory_check;
 
   KeyMapper key_mapper_main, key_mapper_navigation;
   int markovian;
   int markovian_avalanche;
 
+  /** w if it still exists, otherwise main window. */
+  UIWindow* live_window(UIWindow* w);
+  /** If path is already open, go to it and return true. */
+  bool go_to_open_document(const std::string& path, int row, int col);
+  /** A document being opened.  Documents are added in the order they were requested, no matter
+  in which order their contents arrive. */
+  struct PendingOpen {
+    std::string path;
+    UIWindow* pref_window;
+    int row, col;
+    bool is_big_file;
+    /** Set once contents arrived or the open failed or was declined. */
+    bool done;
+    bool ok;
+    std::vector<char> contents;
+  };
+  std::deque<std::shared_ptr<PendingOpen>> pending_opens;
+  bool finishing_opens;
+  /** Steps of open_document, once file size and file contents arrive. */
+  void open_document_sized(std::shared_ptr<PendingOpen> open, AsyncIOResult& result);
+  void open_document_loaded(std::shared_ptr<PendingOpen> open, AsyncIOResult& result);
+  /** Add documents of finished opens at the front of pending_opens. */
+  void finish_pending_opens();
+  void add_opened_document(PendingOpen& open);
+
 public:
   Master();
   Master(const Master&) = delete;
@@ -57,6 +99,8 @@ public:
   PrefManager pref_manager;
   std::unique_ptr<Recents> recent_projects;
   std::unique_ptr<Recents> recent_files;
+  /** Timings of startup, see qtmain. */
+  PhaseTrace startup_trace;
 
   void debug();
 
@@ -102,7 +146,8 @@ public:
   /** p is a utf-8 encoded path.  If preferred_window is not null-ptr, then that window will be
    used to open the file.
 
-   If file is already opened, then go_to_document() will be called instead. */
+   If file is already opened, then go_to_document() will be called instead.  File is read in the
+   background, so the document is not open yet when this returns. */
   void open_document(const char* p, UIWindow* preferred_window, int row=-1, int col=-1);
 
   /** Open up temp document in this window. */
@@ -163,6 +208,23 @@ public:
   /** Get all known documents. */
   void get_known_documents(std::vector<KnownDocument>& known_docs);
 
+  /** Known documents (open or in a file provider) matching a partial path, see KnownDocumentIndex. */
+  void find_known_documents(const std::string& partial_path, std::vector<KnownDocumentMatch>& matches);
+
+  /** File providers call this whenever the files they know of change. */
+  inline void invalidate_known_documents() { known_documents_dirty = true; }
+
+  /** Estimated memory held for a document, by subsystem. */
+  void get_document_memory(Doc* doc, MemoryUsage& usage);
+  /** Memory of every open document, largest first. */
+  std::string get_memory_report();
+  /** Collections call this when a document is brought to front.  Restores what memory pressure
+  released, then relieves pressure on the other documents. */
+  void document_shown(Doc* doc);
+  /** If documents hold more than memory.budget, trim undo history and release StatLang data of
+  documents in background tabs, largest first.  Return bytes freed. */
+  size_t relieve_memory_pressure();
+
   /** Trigger a settings reload for all documents. */
   void reload_settings();
 
@@ -185,11 +247,14 @@ public:
   void global_find(const std::string& term);
 
 
-  //////// Useful for JS interface having to do with doc handles.
+  //////// Useful for JS interface having to do with doc handles.  Handles stay valid while the
+  //////// document is open, and never refer to another document afterwards.
   int js_get_current_doc();
   int js_get_shell_doc();
   Doc* js_get_doc(int handle);
   int js_get_doc_handle(Doc* doc);
+  /** Invalidate the handle of a document that is being destroyed. */
+  inline void js_forget_doc(Doc* doc) { doc_handles.remove(doc); }
 };
 
 extern Master master;
@@ -19,6 +19,7 @@ MasterIOProvider::MasterIOProvider() {
 }
 
 MasterIOProvider::~MasterIOProvider() {
+  if (async_io) async_io->shutdown();
   master_io_provider = nullptr;
 }
 
@@ -58,6 +59,26 @@ unsigned long MasterIOProvider::get_file_size(const std::string& abs_path) {
   return 0;
 }
 
+std::map<std::string, std::vector<DirEntry>> MasterIOProvider::list_dir_recursive(
+    const std::string& abs_path, const std::string& filter, int max_depth) {
+  // Root of all providers is handled by the default implementation.
+  if (abs_path == "") return IOProvider::list_dir_recursive(abs_path, filter, max_depth);
+
+  IOProvider* iop = get_handling_provider(abs_path);
+  if (iop) return iop->list_dir_recursive(abs_path, filter, max_depth);
+  return std::map<std::string, std::vector<DirEntry>>();
+}
+
+void MasterIOProvider::refresh(const std::string& abs_path) {
+  if (abs_path == "") {
+    for (auto& provider : providers) provider->refresh(abs_path);
+    return;
+  }
+
+  IOProvider* iop = get_handling_provider(abs_path);
+  if (iop) iop->refresh(abs_path);
+}
+
 void MasterIOProvider::touch(const std::string& abs_path, DirEntryType::Type type) {
   IOProvider* iop = get_handling_provider(abs_path);
   if (iop) iop->touch(abs_path, type);
@@ -84,6 +105,84 @@ void MasterIOProvider::write_file_safe(const std::string& abs_path, const char*
   if (iop) iop->write_file_safe(abs_path, data, size);
 }
 
+bool MasterIOProvider::is_busy(const std::string& abs_path) {
+  IOProvider* iop = get_handling_provider(abs_path);
+  if (iop) return iop->is_busy(abs_path);
+  return false;
+}
+
+bool MasterIOProvider::is_local(const std::string& abs_path) {
+  return dynamic_cast<FileIOProvider*>(get_handling_provider(abs_path)) != nullptr;
+}
+
+std::shared_ptr<AsyncIORequest> MasterIOProvider::submit(std::shared_ptr<AsyncIOJob> job) {
+  if (!async_io) async_io = std::unique_ptr<AsyncIO>(new AsyncIO(this));
+
+  job->request = std::make_shared<AsyncIORequest>(job->abs_paths.size());
+  for (const std::string& abs_path : job->abs_paths) {
+    // Providers are resolved here, on the GUI thread, as the list of providers may change.
+    IOProvider* iop = get_handling_provider(abs_path);
+    if (iop != nullptr && iop->is_thread_safe()) async_io->run_in_pool(iop, job, abs_path);
+    else async_io->enqueue(job, abs_path);
+  }
+  return job->request;
+}
+
+static std::shared_ptr<AsyncIOJob> make_job(AsyncIOOp::Type op, const std::string& abs_path,
+    AsyncIOCallback callback) {
+  std::shared_ptr<AsyncIOJob> job = std::make_shared<AsyncIOJob>();
+  job->op = op;
+  job->abs_paths.push_back(abs_path);
+  job->max_size = 0;
+  job->callback = callback;
+  return job;
+}
+
+std::shared_ptr<AsyncIORequest> MasterIOProvider::get_file_size_async(const std::string& abs_path,
+    AsyncIOCallback callback) {
+  return submit(make_job(AsyncIOOp::GET_FILE_SIZE, abs_path, callback));
+}
+
+std::shared_ptr<AsyncIORequest> MasterIOProvider::list_dir_async(const std::string& abs_path,
+    const std::string& filter, AsyncIOCallback callback) {
+  std::shared_ptr<AsyncIOJob> job = make_job(AsyncIOOp::LIST_DIR, abs_path, callback);
+  job->filter = filter;
+  return submit(job);
+}
+
+std::shared_ptr<AsyncIORequest> MasterIOProvider::list_dir_recursive_async(const std::string& abs_path,
+    const std::string& filter, AsyncIOCallback callback) {
+  std::shared_ptr<AsyncIOJob> job = make_job(AsyncIOOp::LIST_DIR_RECURSIVE, abs_path, callback);
+  job->filter = filter;
+  return submit(job);
+}
+
+std::shared_ptr<AsyncIORequest> MasterIOProvider::read_file_async(const std::string& abs_path,
+    unsigned long max_size, AsyncIOCallback callback) {
+  std::shared_ptr<AsyncIOJob> job = make_job(AsyncIOOp::READ_FILE, abs_path, callback);
+  job->max_size = max_size;
+  return submit(job);
+}
+
+std::shared_ptr<AsyncIORequest> MasterIOProvider::read_files_async(
+    const std::vector<std::string>& abs_paths, unsigned long max_size, AsyncIOCallback callback,
+    AsyncIOProgress progress) {
+  std::shared_ptr<AsyncIOJob> job = std::make_shared<AsyncIOJob>();
+  job->op = AsyncIOOp::READ_FILE;
+  job->abs_paths = abs_paths;
+  job->max_size = max_size;
+  job->callback = callback;
+  job->progress = progress;
+  return submit(job);
+}
+
+std::shared_ptr<AsyncIORequest> MasterIOProvider::write_file_safe_async(const std::string& abs_path,
+    const std::vector<char>& data, AsyncIOCallback callback) {
+  std::shared_ptr<AsyncIOJob> job = make_job(AsyncIOOp::WRITE_FILE_SAFE, abs_path, callback);
+  job->data = data;
+  return submit(job);
+}
+
 void MasterIOProvider::add_ssh(const std::string& name, const std::string& cmd_line, const std::string& actions) {
   providers.insert(providers.begin(), std::unique_ptr<IOProvider>(new SSHIOProvider(name, cmd_line, actions)));
 }
@@ -98,5 +197,7 @@ void MasterIOProvider::remove_io_provider(IOProvider* iop) {
 }
 
 void MasterIOProvider::clear_io_providers() {
+  // Nothing may be running on the thread pool once providers are gone.
+  if (async_io) async_io->shutdown();
   providers.clear();
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef SYNTAXIC_MASTER_IO_PROVIDER_HPP
 #define SYNTAXIC_MASTER_IO_PROVIDER_HPP
 
+#include "async_io.hpp"
 #include "io_provider.hpp"
 
 #include <memory>
@@ -10,6 +11,10 @@ private:
   std::vector<std::unique_ptr<IOProvider>> providers;
   IOProvider* get_handling_provider(const std::string& abs_path);
 
+  /** Created on first asynchronous operation. */
+  std::unique_ptr<AsyncIO> async_io;
+  std::shared_ptr<AsyncIORequest> submit(std::shared_ptr<AsyncIOJob> job);
+
 public:
   MasterIOProvider();
   virtual ~MasterIOProvider();
@@ -18,14 +23,39 @@ public:
   virtual bool parent_dir(const std::string& abs_path, std::string& output);
   virtual std::vector<DirEntry> list_dir(const std::string& abs_path, const std::string& filter);
   virtual unsigned long get_file_size(const std::string& abs_path);
+  virtual std::map<std::string, std::vector<DirEntry>> list_dir_recursive(const std::string& abs_path,
+      const std::string& filter, int max_depth);
+  virtual void refresh(const std::string& abs_path);
   virtual void touch(const std::string& abs_path, DirEntryType::Type type);
   virtual void rename(const std::string& abs_path_old, const std::string& abs_path_new);
   virtual void remove(const std::string& abs_path);
   virtual std::vector<char> read_file(const std::string& abs_path);
   virtual void write_file_safe(const std::string& abs_path, const char* data, unsigned int size);
+  virtual bool is_busy(const std::string& abs_path);
+
+  // Asynchronous versions of the above.  Callbacks are invoked on the GUI thread, errors are
+  // reported in AsyncIOResult rather than thrown.
+
+  std::shared_ptr<AsyncIORequest> get_file_size_async(const std::string& abs_path,
+      AsyncIOCallback callback);
+  std::shared_ptr<AsyncIORequest> list_dir_async(const std::string& abs_path,
+      const std::string& filter, AsyncIOCallback callback);
+  /** List the whole tree under abs_path, see list_dir_recursive. */
+  std::shared_ptr<AsyncIORequest> list_dir_recursive_async(const std::string& abs_path,
+      const std::string& filter, AsyncIOCallback callback);
+  /** If max_size is not 0, larger files are not read (AsyncIOResult::too_big is set instead). */
+  std::shared_ptr<AsyncIORequest> read_file_async(const std::string& abs_path,
+      unsigned long max_size, AsyncIOCallback callback);
+  /** Read many files, callback is invoked once per file and progress after every file. */
+  std::shared_ptr<AsyncIORequest> read_files_async(const std::vector<std::string>& abs_paths,
+      unsigned long max_size, AsyncIOCallback callback, AsyncIOProgress progress);
+  std::shared_ptr<AsyncIORequest> write_file_safe_async(const std::string& abs_path,
+      const std::vector<char>& data, AsyncIOCallback callback);
 
   // Other
 
+  /** True if abs_path is on the local file system. */
+  bool is_local(const std::string& abs_path);
   void add_ssh(const std::string& name, const std::string& cmd_line, const std::string& actions);
   void remove_io_provider(IOProvider* iop);
   void clear_io_providers();
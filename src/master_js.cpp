@@ -8,14 +8,34 @@
 #include "qtgui/qtmain.hpp"
 
 #include "duktape.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <functional>
+#include <vector>
 #include <QFile>
 #include <QProcess>
 
 struct MasterJSImpl {
   duk_context *ctx;
+  /** Counted by the allocation functions of the heap. */
+  unsigned long num_allocs;
 };
 
+static void* js_alloc(void* udata, duk_size_t size) {
+  static_cast<MasterJSImpl*>(udata)->num_allocs++;
+  return malloc(size);
+}
+
+static void* js_realloc(void* udata, void* ptr, duk_size_t size) {
+  if (ptr == nullptr) static_cast<MasterJSImpl*>(udata)->num_allocs++;
+  return realloc(ptr, size);
+}
+
+static void js_free(void* /* udata */, void* ptr) {
+  free(ptr);
+}
+
 MasterJS* master_js = nullptr;
 duk_context* global_ctx = nullptr;
 
@@ -31,11 +51,14 @@ static void fatal_function(duk_context* /* ctx */, duk_errcode_t /* code */, con
   }
 }
 
-MasterJS::MasterJS() : pimpl(new MasterJSImpl) {
+MasterJS::MasterJS() : pimpl(new MasterJSImpl), load_time(0), load_allocs(0) {
   master_js = this;
   pimpl->ctx = nullptr;
+  pimpl->num_allocs = 0;
+  // Preferences are not loaded yet, Syn.spawn sets the real limit.
+  job_pool = std::unique_ptr<JobPool>(new JobPool(1));
   reboot_heap();
-  hook = all_docs_hook.add(std::bind(&MasterJS::hook_callback, this, std::placeholders::_1, std::placeholders::_2));
+  hook = all_docs_hook.add(std::bind(&MasterJS::hook_callback, this, std::placeholders::_1, std::placeholders::_2), "Plugins");
 }
 
 MasterJS::~MasterJS() {
@@ -43,6 +66,11 @@ MasterJS::~MasterJS() {
 }
 
 void MasterJS::hook_callback(Doc* doc, int type) {
+  if (type & DocEvent::CLOSING) {
+    master.js_forget_doc(doc);
+    return;
+  }
+
   std::string stype;
   if (type & DocEvent::BEFORE_SAVE) {
     stype = "before_save";
@@ -59,7 +87,7 @@ void MasterJS::hook_callback(Doc* doc, int type) {
   for (std::string& func_name: stored_events[stype]) {
     get_js_internal(global_ctx, func_name);
     duk_push_int(global_ctx, master.js_get_doc_handle(doc));
-    int rv = duk_pcall(global_ctx, 1);
+    int rv = call_profiled(func_name, 1);
     if (rv != DUK_EXEC_SUCCESS) {
       errors += duk_to_string(global_ctx, -1);
     }
@@ -137,7 +165,8 @@ static void attach_js_internal(duk_context* ctx, const std::string& name, int st
   duk_push_heap_stash(ctx);
   duk_dup(ctx, stack_idx);
   duk_put_prop_string(ctx, -2, name.c_str());
-  duk_pop_2(ctx);
+  // put_prop_string already consumed the duplicate, only the stash is left.
+  duk_pop(ctx);
 }
 
 /** Stacks 2 things, of which -1 is what we want. */
@@ -151,6 +180,7 @@ static void delete_js_internal(duk_context* ctx, const std::string& name) {
   master_js->stored_objs.erase(name);
   duk_push_heap_stash(ctx);
   duk_del_prop_string(ctx, -1, name.c_str());
+  duk_pop(ctx);
 }
 
 /////// API
@@ -163,12 +193,15 @@ static void delete_js_internal(duk_context* ctx, const std::string& name) {
 
 
 void MasterJS::reboot_heap() {
+  // Callbacks of running jobs live in the old heap.
+  job_pool->cancel_all();
   stored_objs.clear();
   stored_menus.clear();
   stored_events.clear();
+  profiles.clear();
 
   if (pimpl->ctx) duk_destroy_heap(pimpl->ctx);
-  pimpl->ctx = duk_create_heap(nullptr, nullptr, nullptr, nullptr, fatal_function);
+  pimpl->ctx = duk_create_heap(js_alloc, js_realloc, js_free, pimpl.get(), fatal_function);
   global_ctx = pimpl->ctx;
 
   // This will instantiate Syn object
@@ -220,9 +253,98 @@ std::string MasterJS::eval_syntaxic_js_file() {
 
   reboot_heap();
 
+  load_time = 0;
+  load_allocs = 0;
   std::string path = get_syntaxic_js_file();
   if (UtilPath::is_existing_file(path)) {
-    return eval_file(path);
+    const double start = get_timestamp();
+    const unsigned long start_allocs = pimpl->num_allocs;
+    std::string output = eval_file(path);
+    load_time = get_timestamp() - start;
+    load_allocs = pimpl->num_allocs - start_allocs;
+    return output;
   }
   return "";
+}
+
+int MasterJS::call_profiled(const std::string& name, int num_args) {
+  auto it = profiles.find(name);
+  if (it == profiles.end()) {
+    JSProfile profile;
+    profile.label = name;
+    // Function is below its arguments.
+    duk_get_prop_string(global_ctx, -num_args - 1, "name");
+    if (duk_is_string(global_ctx, -1) && duk_get_length(global_ctx, -1) > 0) {
+      profile.label += std::string(" (") + duk_get_string(global_ctx, -1) + ")";
+    }
+    duk_pop(global_ctx);
+    profile.num_calls = 0;
+    profile.total_time = 0;
+    profile.max_time = 0;
+    profile.num_allocs = 0;
+    profile.num_overruns = 0;
+    profile.disabled = false;
+    it = profiles.insert(std::make_pair(name, profile)).first;
+  }
+
+  JSProfile& profile = it->second;
+  if (profile.disabled) {
+    duk_pop_n(global_ctx, num_args + 1);
+    duk_push_undefined(global_ctx);
+    return DUK_EXEC_SUCCESS;
+  }
+
+  const double start = get_timestamp();
+  const unsigned long start_allocs = pimpl->num_allocs;
+  int rv = duk_pcall(global_ctx, num_args);
+  const double elapsed = get_timestamp() - start;
+
+  // Callback may have rebooted the heap (and with it the profiles), so look it up again.
+  it = profiles.find(name);
+  if (it == profiles.end()) return rv;
+  JSProfile& after = it->second;
+  after.num_calls++;
+  after.total_time += elapsed;
+  after.max_time = std::max(after.max_time, elapsed);
+  after.num_allocs += pimpl->num_allocs - start_allocs;
+
+  // Duktape cannot interrupt a running callback, but a slow one is not called again.
+  const double budget = master.pref_manager.get_int("plugins.callback_budget") / 1000.0;
+  if (elapsed > budget) {
+    after.num_overruns++;
+    if (after.num_overruns >= JS_MAX_OVERRUNS) {
+      after.disabled = true;
+      master.feedback("Plugin callback disabled", after.label + " took longer than plugins.callback_budget "
+          + std::to_string(JS_MAX_OVERRUNS) + " times.  It will not be called until plugins are reloaded.  See Plugins->Plugin profile.");
+    }
+  }
+  return rv;
+}
+
+std::string MasterJS::get_profile_report() const {
+  std::vector<const JSProfile*> sorted;
+  for (const auto& p : profiles) sorted.push_back(&p.second);
+  std::sort(sorted.begin(), sorted.end(), [](const JSProfile* a, const JSProfile* b) {
+    return a->total_time > b->total_time;
+  });
+
+  char buf[256];
+  std::string output;
+  snprintf(buf, sizeof(buf), "Loading syntaxic.js: %.1f ms, %lu allocations\n\n", load_time * 1000, load_allocs);
+  output += buf;
+  snprintf(buf, sizeof(buf), "%8s %10s %10s %10s %12s %8s  %s\n", "Calls", "Total ms", "Avg ms", "Max ms",
+      "Allocations", "Overruns", "Callback");
+  output += buf;
+  for (const JSProfile* profile : sorted) {
+    const double avg = profile->num_calls > 0 ? profile->total_time / profile->num_calls : 0;
+    snprintf(buf, sizeof(buf), "%8d %10.2f %10.2f %10.2f %12lu %8d  ", profile->num_calls,
+        profile->total_time * 1000, avg * 1000, profile->max_time * 1000, profile->num_allocs,
+        profile->num_overruns);
+    output += buf;
+    output += profile->label;
+    if (profile->disabled) output += " [disabled]";
+    output += '\n';
+  }
+  if (sorted.empty()) output += "No plugin callbacks have been called yet.\n";
+  return output;
 }
\ No newline at end of file
@@ -3,13 +3,30 @@
 
 #include "core/hooks.hpp"
 #include "doc.hpp"
+#include "job_pool.hpp"
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 
+/** Callback that overruns plugins.callback_budget this many times is disabled until reload. */
+#define JS_MAX_OVERRUNS 3
+
 struct MasterJSImpl;
 
+/** Accumulated cost of a stored JS callback. */
+struct JSProfile {
+  std::string label;
+  int num_calls;
+  double total_time;
+  double max_time;
+  /** Number of allocations made by the Duktape heap during the calls. */
+  unsigned long num_allocs;
+  int num_overruns;
+  bool disabled;
+};
+
 class MasterJS {
 private:
   std::unique_ptr<MasterJSImpl> pimpl;
@@ -21,6 +38,13 @@ public:
   std::unordered_set<std::string> stored_menus;
   std::unordered_set<std::string> stored_objs;
   std::unordered_map<std::string, std::vector<std::string>> stored_events;
+  /** Commands started with Syn.spawn. */
+  std::unique_ptr<JobPool> job_pool;
+  /** Keyed by name of the stored callback, reset when the heap is rebooted. */
+  std::map<std::string, JSProfile> profiles;
+  /** Time and allocations spent evaluating syntaxic.js. */
+  double load_time;
+  unsigned long load_allocs;
 
   MasterJS();
   ~MasterJS();
@@ -31,6 +55,12 @@ public:
   void make_default_syntaxic_js_file();
   std::string get_syntaxic_js_file();
   std::string eval_syntaxic_js_file();
+
+  /** Like duk_pcall on global_ctx for the stored callback name, but timed and accounted to its
+  profile.  Disabled callbacks are not called, and succeed with undefined. */
+  int call_profiled(const std::string& name, int num_args);
+  /** Human readable table of profiles. */
+  std::string get_profile_report() const;
 };
 
 extern MasterJS* master_js;
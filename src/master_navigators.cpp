@@ -7,6 +7,9 @@
 
 #include <cctype>
 
+/** Confidence of a word that is a path to an existing file, above that of any known document. */
+#define CONFIDENCE_EXISTING_FILE 1000
+
 MasterNavigators::MasterNavigators() {
   master_navigators = this;
 }
@@ -93,25 +96,15 @@ void MasterNavigators::process_destination(std::vector<NavigationDestination>& o
 
   // First, is it an existing file?
   if (UtilPath::is_existing_file(word)) {
-    output.push_back({3, word, row, col});
+    output.push_back({CONFIDENCE_EXISTING_FILE, word, row, col});
   }
 
-  // Second, is the filename a known document?
-  std::vector<KnownDocument> known_docs;
-  master.get_known_documents(known_docs);
-  std::string filename = UtilPath::last_component(word);
-  for (KnownDocument& kd : known_docs) {
-    if (filename == kd.file_name) {
-      output.push_back({2, kd.abs_path, row, col});
-    }
-  }
-
-  // Third, is the basename a known document.
-  std::string basename = UtilPath::get_basename(filename);
-  for (KnownDocument& kd : known_docs) {
-    if (basename == UtilPath::get_basename(kd.file_name)) {
-      output.push_back({1, kd.abs_path, row, col});
-    }
+  // Then known documents, the more trailing components of the word their paths match the better,
+  // and last those with the same basename.
+  std::vector<KnownDocumentMatch> matches;
+  master.find_known_documents(word, matches);
+  for (KnownDocumentMatch& m : matches) {
+    output.push_back({m.num_components + 1, m.abs_path, row, col});
   }
 }
 
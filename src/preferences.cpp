@@ -92,6 +92,13 @@ void PrefManager::init_specs() {
     spec_categories.push_back(cat);
   }
 
+  {
+    PrefSpecCategory cat("console");
+    cat.spec(PREF_INT, "console.scrollback_lines", "Scrollback lines").def_int(1000).min_max(100, 10000000).long_text("Number of lines of output kept in shells and consoles.");
+    cat.spec(PREF_BOOL, "console.spill_scrollback", "Keep full scrollback on disk").def_bool(false).long_text("Lines that no longer fit in the scrollback are compressed into a temporary file instead of being discarded.");
+    spec_categories.push_back(cat);
+  }
+
   {
     PrefSpecCategory cat("folding");
     cat.spec(PREF_INT, "folding.line_height", "Fold line height").def_int(4).min_max(0, 8).long_text("Height of the folded line preview in pixels.  If set to 0, then no preview will be shown.");
@@ -228,6 +235,19 @@ void PrefManager::init_specs() {
     spec_categories.push_back(cat);
   }
 
+  {
+    PrefSpecCategory cat("memory");
+    cat.spec(PREF_INT, "memory.budget", "Memory budget (MB)").def_int(1024).min_max(64, 65536).long_text("When open documents are estimated to hold more than this, undo history of documents in background tabs is trimmed and their syntax analysis is released, largest documents first.  Analysis is redone when the tab is shown again.  See Help->Memory usage.");
+    spec_categories.push_back(cat);
+  }
+
+  {
+    PrefSpecCategory cat("plugins");
+    cat.spec(PREF_INT, "plugins.callback_budget", "Plugin callback budget (ms)").def_int(500).min_max(10, 60000).long_text("Plugin callbacks (menu items, document events) that take longer than this three times are not called again until plugins are reloaded.  Timings are shown in Plugins->Plugin profile.");
+    cat.spec(PREF_INT, "plugins.max_jobs", "Parallel plugin jobs").def_int(4).min_max(1, 64).long_text("Maximum number of external commands started with Syn.spawn that run at the same time.  Others wait until one finishes.");
+    spec_categories.push_back(cat);
+  }
+
   {
     PrefSpecCategory cat("ruler");
     cat.spec(PREF_BOOL, "ruler.show", "Show the ruler").def_bool(true).long_text("Display the ruler. Ruler is a differently colored area to the right of the editor.");
@@ -4,11 +4,12 @@
 #include "core/utf8_util.hpp"
 #include "qtgui/main_window.hpp"
 
+#include <algorithm>
 #include <QEventLoop>
 #include <QMessageBox>
 #include <QThread>
 
-Process::Process() {
+Process::Process() : ansi_markup(0) {
   prompt = "";
 }
 Process::~Process() {}
@@ -41,6 +42,7 @@ bool Process::start_process(const std::vector<std::string>& command_line, const
   }
 
   pimpl = std::unique_ptr<ProcessImpl>(new ProcessImpl(this, program, args, cwd));
+  pimpl->set_coalesce_output(true);
   return true;
 }
 
@@ -54,6 +56,7 @@ bool Process::start_shell(const std::string& cwd) {
 
   pwa = wrap_with_tty(pwa);
   pimpl = std::unique_ptr<ProcessImpl>(new ProcessImpl(this, pwa.program, pwa.args, cwd));
+  pimpl->set_coalesce_output(true);
   return true;
 }
 
@@ -81,88 +84,85 @@ void Process::process_timer() {
 
 }
 
+static inline void add_run(std::vector<ConsoleRun>& runs, std::string& text, uint8_t markup) {
+  if (text.empty()) return;
+  #ifdef CMAKE_WINDOWS
+  text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+  #endif
+  runs.push_back({ text, markup });
+  text.clear();
+}
+
 void Process::console_output_ansi(const std::string& contents) {
-  std::vector<uint32_t> vec = utf8_string_to_vector(contents);
+  // Escape sequences are pure ASCII and never appear inside a UTF-8 sequence, so the bytes can be
+  // scanned directly and copied into runs in slices.
+  std::vector<ConsoleRun> runs;
   std::string tmp;
-  uint8_t markup = 0;
-
-  for (unsigned int i = 0; i < vec.size(); i++) {
-    uint32_t c = vec[i];
-
-    #ifdef CMAKE_WINDOWS
-    if (c == '\r') continue;
-    #endif
-
-    if (c == 27) {
-      i++;
-      if (i >= vec.size()) break;
-      c = vec[i];
-      if (c == '[') {
-        // CSI
-
-        int multiparam = 0;
-        int param1 = 0, param2 = 0, param3 = 0;
-
+  const unsigned int size = contents.size();
+
+  unsigned int i = 0;
+  while (i < size) {
+    size_t esc = contents.find('\x1b', i);
+    if (esc == std::string::npos) esc = size;
+    tmp.append(contents, i, esc - i);
+    if (esc >= size) break;
+
+    i = esc + 1;
+    if (i >= size) break;
+    unsigned char c = contents[i];
+    i++;
+    if (c == '[') {
+      // CSI
+
+      int multiparam = 0;
+      int param1 = 0, param2 = 0, param3 = 0;
+
+      while (i < size) {
+        c = contents[i];
         i++;
-        while (i < vec.size()) {
-          c = vec[i];
-          if (c == ';') {
-            multiparam++;
-          } else if (isdigit(c)) {
-            if (multiparam == 0) {
-              param1 = param1*10 + (c - '0');
-            } else if (multiparam == 1) {
-              param2 = param2*10 + (c - '0');
-            } else if (multiparam == 2) {
-              param3 = param3*10 + (c - '0');
+        if (c == ';') {
+          multiparam++;
+        } else if (isdigit(c)) {
+          if (multiparam == 0) {
+            param1 = param1*10 + (c - '0');
+          } else if (multiparam == 1) {
+            param2 = param2*10 + (c - '0');
+          } else if (multiparam == 2) {
+            param3 = param3*10 + (c - '0');
+          }
+        } else if (isalpha(c)) {
+          uint8_t markup = ansi_markup;
+          if (param1 == 0) markup = 0;
+          else {
+            if (param1 >= 30 && param1 <= 37) {
+              markup = (uint8_t) (param1 - 30);
             }
-          } else if (isalpha(c)) {
-            if (!tmp.empty()) {
-              console_output(tmp, markup);
-              tmp = "";
+            if (param2 >= 30 && param2 <= 37) {
+              markup = (uint8_t) (param2 - 30);
             }
-            if (param1 == 0) markup = 0;
-            else {
-              if (param1 >= 30 && param1 <= 37) {
-                markup = (uint8_t) (param1 - 30);
-              }
-              if (param2 >= 30 && param2 <= 37) {
-                markup = (uint8_t) (param2 - 30);
-              }
-              if (param3 >= 30 && param3 <= 37) {
-                markup = (uint8_t) (param3 - 30);
-              }
+            if (param3 >= 30 && param3 <= 37) {
+              markup = (uint8_t) (param3 - 30);
             }
-
-            break;
           }
-          i++;
-        }
-        continue;
-
-      } else if (c == ']') {
-        // OSC
-
-        // Ignore characters until BELL
-        i++;
-        while (i < vec.size()) {
-          c = vec[i];
-          // This is bell:
-          if (c == 7) break;
-          i++;
+          if (markup != ansi_markup) {
+            add_run(runs, tmp, ansi_markup);
+            ansi_markup = markup;
+          }
+          break;
         }
-        continue;
-      } else {
-        // printf("%d\n", c);
       }
-    } else {
-      utf8_append(tmp, c);
+    } else if (c == ']') {
+      // OSC
+
+      // Ignore characters until BELL
+      size_t bell = contents.find('\x07', i);
+      if (bell == std::string::npos) i = size;
+      else i = bell + 1;
     }
   }
 
-  if (!tmp.empty()) {
-    console_output(tmp, markup);
-  }
+  add_run(runs, tmp, ansi_markup);
+  console_output_runs(runs);
 }
 
 void Process::console_input(const std::string& contents) {
@@ -15,6 +15,8 @@ private:
   std::unique_ptr<ProcessImpl> pimpl;
 
   void console_output_ansi(const std::string& contents);
+  /** Current color, carried over between chunks of output. */
+  uint8_t ansi_markup;
   std::string process_name;
 
 public:
@@ -7,6 +7,9 @@
 #include <QEventLoop>
 #include <QTimer>
 
+/** Milliseconds between deliveries of coalesced output, roughly one frame. */
+#define PROCESS_FRAME_INTERVAL 16
+
 ProgramWithArgs wrap_with_tty(ProgramWithArgs pwa) {
 #ifdef CMAKE_WINDOWS
   return pwa;
@@ -52,11 +55,14 @@ ProgramWithArgs parse_command_line(const std::string& cmd_line) {
   return pwa;
 }
 
-ProcessImpl::ProcessImpl(ProcessCallback* cb, const std::string& program, const std::vector<std::string>& args, const std::string& cwd) : callback(cb), timed_flush(false) {
+ProcessImpl::ProcessImpl(ProcessCallback* cb, const std::string& program, const std::vector<std::string>& args, const std::string& cwd) : callback(cb), timed_flush(false), coalesce_output(false) {
   event_loop = new QEventLoop(this);
   timer = new QTimer(this);
   connect(timer, &QTimer::timeout, this, &ProcessImpl::slot_timer);
   timer->start(1000);
+  frame_timer = new QTimer(this);
+  frame_timer->setSingleShot(true);
+  connect(frame_timer, &QTimer::timeout, this, &ProcessImpl::slot_frame_timer);
 
   connect(this, &QProcess::started, this, &ProcessImpl::slot_started);
   connect(this, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
@@ -75,21 +81,64 @@ ProcessImpl::ProcessImpl(ProcessCallback* cb, const std::string& program, const
   running = true;
 }
 
-void ProcessImpl::add_line_char(char c) {
-  if (ignore_buffer.size() > 0) {
-    if (c == '\r' && ignore_buffer[0] == '\n') return;
-    if (ignore_buffer[0] == c) {
-      ignore_buffer.erase(0, 1);
-      return;
+/** Remove '\r' characters which precede a '\n'. */
+static void strip_carriage_returns(std::string& text) {
+  unsigned int out = 0;
+  for (unsigned int i = 0; i < text.size(); i++) {
+    if (text[i] == '\r' && i + 1 < text.size() && text[i+1] == '\n') continue;
+    text[out] = text[i];
+    out++;
+  }
+  text.resize(out);
+}
+
+void ProcessImpl::add_output(const char* data, int size) {
+  if (ignore_buffer.empty()) {
+    line_buffer.append(data, size);
+  } else {
+    // Echo suppression is only used for short inputs, so do it character by character.
+    for (int i = 0; i < size; i++) {
+      const char c = data[i];
+      if (ignore_buffer.size() > 0) {
+        if (c == '\r' && ignore_buffer[0] == '\n') continue;
+        if (ignore_buffer[0] == c) {
+          ignore_buffer.erase(0, 1);
+          continue;
+        }
+      }
+      line_buffer.push_back(c);
     }
   }
-  if (c == '\n' && line_buffer.size() > 0 && line_buffer.back() == '\r') line_buffer.pop_back();
-  line_buffer.push_back(c);
-  if (c == '\n') {
-    callback->process_output(line_buffer, ProcessOutputType::STD_OUT);
-    line_buffer = "";
-    timed_flush = false;
+
+  // Hand over all complete lines at once, keep the partial line for later.
+  const size_t last_newline = line_buffer.rfind('\n');
+  if (last_newline == std::string::npos) return;
+  std::string lines = line_buffer.substr(0, last_newline + 1);
+  line_buffer.erase(0, last_newline + 1);
+  strip_carriage_returns(lines);
+  timed_flush = false;
+  deliver_output(lines);
+}
+
+void ProcessImpl::deliver_output(const std::string& text) {
+  if (!coalesce_output) {
+    callback->process_output(text, ProcessOutputType::STD_OUT);
+    return;
   }
+  pending_output += text;
+  if (!frame_timer->isActive()) frame_timer->start(PROCESS_FRAME_INTERVAL);
+}
+
+void ProcessImpl::flush_pending_output() {
+  frame_timer->stop();
+  if (pending_output.empty()) return;
+  std::string text;
+  text.swap(pending_output);
+  callback->process_output(text, ProcessOutputType::STD_OUT);
+}
+
+void ProcessImpl::slot_frame_timer() {
+  flush_pending_output();
 }
 
 void ProcessImpl::slot_timer() {
@@ -97,7 +146,7 @@ void ProcessImpl::slot_timer() {
   if (!timed_flush) timed_flush = true;
   if (timed_flush) {
     if (!line_buffer.empty()) {
-      callback->process_output(line_buffer, ProcessOutputType::STD_OUT);
+      deliver_output(line_buffer);
       line_buffer = "";
       timed_flush = false;
     }
@@ -109,29 +158,25 @@ void ProcessImpl::slot_started() {
 }
 
 void ProcessImpl::slot_finished(int exit_code) {
+  flush_pending_output();
   callback->process_finished(exit_code);
   running = false;
 }
 
 void ProcessImpl::slot_error(QProcess::ProcessError err) {
+  flush_pending_output();
   callback->process_error(err);
   running = false;
 }
 
 void ProcessImpl::slot_ready_out() {
   QByteArray out = readAllStandardOutput();
-  std::string text(out.data(), out.size());
-  for (unsigned int i = 0; i < text.size(); i++ ){
-    add_line_char(text[i]);
-  }
+  add_output(out.data(), out.size());
 }
 
 void ProcessImpl::slot_ready_err() {
   QByteArray out = readAllStandardError();
-  std::string text(out.data(), out.size());
-  for (unsigned int i = 0; i < text.size(); i++ ){
-    add_line_char(text[i]);
-  }
+  add_output(out.data(), out.size());
 }
 
 void ProcessImpl::add_to_ignore_buffer(const std::string& txt) {
@@ -42,7 +42,14 @@ private:
 
   bool timed_flush;
   std::string line_buffer;
-  void add_line_char(char c);
+  void add_output(const char* data, int size);
+
+  /** Complete lines waiting for the frame timer, used when output is coalesced. */
+  bool coalesce_output;
+  std::string pending_output;
+  QTimer* frame_timer;
+  void deliver_output(const std::string& text);
+  void flush_pending_output();
 
 private slots:
   void slot_started();
@@ -51,12 +58,15 @@ private slots:
   void slot_ready_out();
   void slot_ready_err();
   void slot_timer();
+  void slot_frame_timer();
 
 public:
   ProcessImpl(ProcessCallback* callback, const std::string& program, const std::vector<std::string>& args, const std::string& cwd);
 
   inline QEventLoop* get_event_loop() { return event_loop; }
   inline bool is_running() { return running; }
+  /** If set, output is delivered at most once per frame instead of on every read. */
+  inline void set_coalesce_output(bool b) { coalesce_output = b; }
 
   std::string ignore_buffer;
   void add_to_ignore_buffer(const std::string& txt);
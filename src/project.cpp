@@ -21,6 +21,8 @@ void Project::context_do(const STreeNode* fpn, const std::string& context, STree
 void Project::reconfigure_project() {
   set_project(project_spec.project_name);
   filter = "*.synproj " + project_spec.filtering_pattern;
+  project_index.reset(new ProjectIndex(current_dir_abs, filter));
+  project_index->set_on_indexed([this]() { master.stat_lang.prewarm(project_index->get_files()); });
 }
 
 void Project::save_project() {
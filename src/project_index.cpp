@@ -0,0 +1,289 @@
+#include "core/util_path.hpp"
+#include "master.hpp"
+#include "master_io_provider.hpp"
+#include "project_index.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <QDir>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTimer>
+
+#define PROJECT_INDEX_HEADER "SYNTAXIC_PROJECT_INDEX 1"
+
+ProjectIndex::ProjectIndex(const std::string& r, const std::string& f) : root_path(r), filter(f),
+    has_listings(false), crawl_id(0), num_crawl_outstanding(0), num_relist_outstanding(0),
+    files_dirty(true), watcher(nullptr), unsaved(false) {
+  update_timer = new QTimer();
+  update_timer->setSingleShot(true);
+  update_timer->setInterval(PROJECT_INDEX_UPDATE_DELAY);
+  QObject::connect(update_timer, &QTimer::timeout, [this]() { update_changed_dirs(); });
+
+  save_timer = new QTimer();
+  save_timer->setSingleShot(true);
+  save_timer->setInterval(PROJECT_INDEX_SAVE_DELAY);
+  QObject::connect(save_timer, &QTimer::timeout, [this]() { save(); });
+
+  // Only local directories can be watched.
+  if (master_io_provider->is_local(root_path)) {
+    watcher = new QFileSystemWatcher();
+    QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, [this](const QString& path) {
+      changed_dirs.insert(path.toStdString());
+      update_timer->start();
+    });
+  }
+
+  has_listings = load();
+  if (has_listings) watch_dirs();
+  rescan();
+}
+
+ProjectIndex::~ProjectIndex() {
+  for (auto& request : requests) request->cancel();
+  if (unsaved) save();
+  delete update_timer;
+  delete save_timer;
+  delete watcher;
+}
+
+void ProjectIndex::rescan() {
+  for (auto& request : requests) request->cancel();
+  requests.clear();
+  crawl_listings.clear();
+  num_crawl_outstanding = 0;
+  num_relist_outstanding = 0;
+  crawl_id++;
+  if (master_io_provider->is_local(root_path)) list_tree(root_path, true);
+  else list_tree_recursive();
+}
+
+void ProjectIndex::list_tree(const std::string& dir, bool crawl) {
+  if (crawl) num_crawl_outstanding++;
+  else num_relist_outstanding++;
+  const unsigned int id = crawl_id;
+  requests.push_back(master_io_provider->list_dir_async(dir, filter,
+      [this, dir, crawl, id](AsyncIOResult& result) {
+    if (id != crawl_id) return;
+    int& num_outstanding = crawl ? num_crawl_outstanding : num_relist_outstanding;
+    num_outstanding--;
+
+    // Unreadable directories are simply left out.
+    if (result.ok) {
+      for (const DirEntry& de : result.entries) {
+        if (de.type == DirEntryType::DIR) list_tree(UtilPath::join_components(dir, de.name), crawl);
+      }
+      if (crawl) {
+        crawl_listings[dir] = std::move(result.entries);
+      } else {
+        listings[dir] = std::move(result.entries);
+        if (watcher != nullptr && int(watcher->directories().size()) < PROJECT_INDEX_MAX_WATCHES) {
+          watcher->addPath(QString::fromStdString(dir));
+        }
+        changed();
+      }
+    }
+    if (num_outstanding == 0) {
+      prune_requests();
+      if (crawl) finish_crawl();
+    }
+  }));
+}
+
+void ProjectIndex::list_tree_recursive() {
+  num_crawl_outstanding++;
+  const unsigned int id = crawl_id;
+  requests.push_back(master_io_provider->list_dir_recursive_async(root_path, filter,
+      [this, id](AsyncIOResult& result) {
+    if (id != crawl_id) return;
+    num_crawl_outstanding--;
+
+    // Unreadable directories are simply left out.
+    if (result.ok) crawl_listings = std::move(result.listings);
+    prune_requests();
+    finish_crawl();
+  }));
+}
+
+void ProjectIndex::prune_requests() {
+  requests.erase(std::remove_if(requests.begin(), requests.end(),
+      [](const std::shared_ptr<AsyncIORequest>& r) { return r->is_finished(); }), requests.end());
+}
+
+void ProjectIndex::finish_crawl() {
+  listings.swap(crawl_listings);
+  crawl_listings.clear();
+  has_listings = true;
+  watch_dirs();
+  changed();
+  if (on_indexed) on_indexed();
+}
+
+void ProjectIndex::set_on_indexed(std::function<void()> callback) {
+  on_indexed = callback;
+  if (has_listings && on_indexed) on_indexed();
+}
+
+void ProjectIndex::set_listings(const std::map<std::string, std::vector<DirEntry>>& new_listings) {
+  if (has_listings || new_listings.empty()) return;
+  listings = new_listings;
+  has_listings = true;
+  watch_dirs();
+  changed();
+  if (on_indexed) on_indexed();
+}
+
+void ProjectIndex::update_changed_dirs() {
+  prune_requests();
+  for (const std::string& dir : changed_dirs) {
+    if (listings.count(dir) > 0) relist_dir(dir);
+  }
+  changed_dirs.clear();
+}
+
+void ProjectIndex::relist_dir(const std::string& dir) {
+  requests.push_back(master_io_provider->list_dir_async(dir, filter, [this, dir](AsyncIOResult& result) {
+    if (!result.ok) {
+      remove_tree(dir);
+      changed();
+      return;
+    }
+
+    std::set<std::string> old_dirs, new_dirs;
+    for (const DirEntry& de : listings[dir]) {
+      if (de.type == DirEntryType::DIR) old_dirs.insert(de.name);
+    }
+    for (const DirEntry& de : result.entries) {
+      if (de.type == DirEntryType::DIR) new_dirs.insert(de.name);
+    }
+    for (const std::string& name : old_dirs) {
+      if (new_dirs.count(name) == 0) remove_tree(UtilPath::join_components(dir, name));
+    }
+    for (const std::string& name : new_dirs) {
+      if (old_dirs.count(name) == 0) list_tree(UtilPath::join_components(dir, name), false);
+    }
+    listings[dir] = std::move(result.entries);
+    changed();
+  }));
+}
+
+void ProjectIndex::remove_tree(const std::string& dir) {
+  auto it = listings.find(dir);
+  if (it == listings.end()) return;
+  for (const DirEntry& de : it->second) {
+    if (de.type == DirEntryType::DIR) remove_tree(UtilPath::join_components(dir, de.name));
+  }
+  listings.erase(dir);
+  if (watcher != nullptr) watcher->removePath(QString::fromStdString(dir));
+}
+
+void ProjectIndex::watch_dirs() {
+  if (watcher == nullptr) return;
+  const QStringList watched = watcher->directories();
+  if (!watched.isEmpty()) watcher->removePaths(watched);
+
+  QStringList paths;
+  for (const auto& p : listings) {
+    if (paths.size() >= PROJECT_INDEX_MAX_WATCHES) break;
+    paths.push_back(QString::fromStdString(p.first));
+  }
+  if (!paths.isEmpty()) watcher->addPaths(paths);
+}
+
+void ProjectIndex::changed() {
+  files_dirty = true;
+  unsaved = true;
+  master.invalidate_known_documents();
+  save_timer->start();
+}
+
+const std::vector<std::string>& ProjectIndex::get_files() {
+  if (files_dirty) {
+    files.clear();
+    for (const auto& p : listings) {
+      for (const DirEntry& de : p.second) {
+        if (de.type != DirEntryType::DIR) files.push_back(UtilPath::join_components(p.first, de.name));
+      }
+    }
+    files_dirty = false;
+  }
+  return files;
+}
+
+std::string ProjectIndex::get_cache_path() const {
+  const std::string dir = UtilPath::join_components(
+      QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation).toStdString(), "syntaxic");
+  char name[64];
+  snprintf(name, sizeof(name), "project_index_%zx", std::hash<std::string>()(root_path + '\n' + filter));
+  return UtilPath::join_components(dir, name);
+}
+
+// Format is a header, root path and filter, followed by a "D <abs path>" line for every directory,
+// each followed by "F <name>", "S <name>" (subdirectory) or "L <name>" lines for its entries.
+
+bool ProjectIndex::load() {
+  QFile qfile(QString::fromStdString(get_cache_path()));
+  if (!qfile.open(QIODevice::ReadOnly)) return false;
+  const QByteArray data = qfile.readAll();
+
+  std::map<std::string, std::vector<DirEntry>> loaded;
+  std::vector<DirEntry>* current = nullptr;
+  int line_num = 0;
+  int start = 0;
+  while (start < data.size()) {
+    int end = data.indexOf('\n', start);
+    if (end < 0) end = data.size();
+    const std::string line(data.constData() + start, end - start);
+    start = end + 1;
+
+    // Anything unexpected and the index is rebuilt from scratch.
+    switch (line_num++) {
+      case 0: if (line != PROJECT_INDEX_HEADER) return false; continue;
+      case 1: if (line != root_path) return false; continue;
+      case 2: if (line != filter) return false; continue;
+    }
+    if (line.size() < 3 || line[1] != ' ') return false;
+    const std::string name = line.substr(2);
+    if (line[0] == 'D') {
+      current = &loaded[name];
+      continue;
+    }
+    if (current == nullptr) return false;
+    if (line[0] == 'F') current->push_back({ name, DirEntryType::FILE });
+    else if (line[0] == 'S') current->push_back({ name, DirEntryType::DIR });
+    else if (line[0] == 'L') current->push_back({ name, DirEntryType::LINK });
+    else return false;
+  }
+  if (loaded.empty()) return false;
+
+  listings.swap(loaded);
+  files_dirty = true;
+  return true;
+}
+
+void ProjectIndex::save() {
+  unsaved = false;
+  if (!has_listings) return;
+
+  std::string data = PROJECT_INDEX_HEADER "\n" + root_path + "\n" + filter + "\n";
+  for (const auto& p : listings) {
+    if (p.first.find('\n') != std::string::npos) continue;
+    data += "D " + p.first + "\n";
+    for (const DirEntry& de : p.second) {
+      if (de.name.find('\n') != std::string::npos) continue;
+      data += de.type == DirEntryType::DIR ? "S " : (de.type == DirEntryType::LINK ? "L " : "F ");
+      data += de.name;
+      data += '\n';
+    }
+  }
+
+  const std::string path = get_cache_path();
+  QDir().mkpath(QString::fromStdString(UtilPath::parent_components(path)));
+  QFile qfile(QString::fromStdString(path));
+  if (!qfile.open(QIODevice::WriteOnly) || qfile.write(data.data(), data.size()) != qint64(data.size())) {
+    printf("WARNING: Could not write project index '%s'.\n", path.c_str());
+  }
+}
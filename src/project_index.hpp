@@ -0,0 +1,97 @@
+#ifndef SYNTAXIC_PROJECT_INDEX_HPP
+#define SYNTAXIC_PROJECT_INDEX_HPP
+
+#include "async_io.hpp"
+#include "io_provider.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+class QFileSystemWatcher;
+class QTimer;
+
+/** How long to wait for more changes before relisting changed directories (ms). */
+#define PROJECT_INDEX_UPDATE_DELAY 300
+/** How long to wait for more changes before writing the index to disk (ms). */
+#define PROJECT_INDEX_SAVE_DELAY 5000
+/** At most this many directories are watched, inotify watches are a limited resource. */
+#define PROJECT_INDEX_MAX_WATCHES 4096
+
+/** All files of a project.  The index is loaded from disk when the project is opened and recrawled
+in the background.  Local projects are crawled with one asynchronous listing per directory, listed
+in parallel.  Remote ones are listed recursively in a single request, which the provider batches
+into a few round trips.  Local projects are then kept current by watching their directories.  The
+index is written back to disk whenever it changes, so that it is available instantly on the next launch. */
+class ProjectIndex {
+private:
+  std::string root_path;
+  std::string filter;
+  /** Absolute path of every directory in the project to its entries. */
+  std::map<std::string, std::vector<DirEntry>> listings;
+  /** Set once listings cover the whole project (from disk or from a crawl). */
+  bool has_listings;
+
+  /** Listings of the crawl in progress, replace listings once it is done. */
+  std::map<std::string, std::vector<DirEntry>> crawl_listings;
+  /** Incremented on every rescan, results of older crawls are ignored. */
+  unsigned int crawl_id;
+  /** Listings still to come for the crawl, and for new directories found by relisting. */
+  int num_crawl_outstanding;
+  int num_relist_outstanding;
+  std::vector<std::shared_ptr<AsyncIORequest>> requests;
+
+  std::vector<std::string> files;
+  bool files_dirty;
+
+  QFileSystemWatcher* watcher;
+  std::set<std::string> changed_dirs;
+  QTimer* update_timer;
+  QTimer* save_timer;
+  bool unsaved;
+
+  std::function<void()> on_indexed;
+
+  /** List dir and everything under it, into crawl_listings if crawl, otherwise into listings. */
+  void list_tree(const std::string& dir, bool crawl);
+  /** Crawl a remote project with one recursive listing. */
+  void list_tree_recursive();
+  void finish_crawl();
+  /** Drop requests that are done. */
+  void prune_requests();
+  /** Relist directories reported by the watcher. */
+  void update_changed_dirs();
+  void relist_dir(const std::string& dir);
+  /** Forget dir and everything under it. */
+  void remove_tree(const std::string& dir);
+  void watch_dirs();
+  void changed();
+
+  std::string get_cache_path() const;
+  bool load();
+  void save();
+
+public:
+  ProjectIndex(const std::string& root_path, const std::string& filter);
+  ~ProjectIndex();
+  ProjectIndex(const ProjectIndex&) = delete;
+  ProjectIndex& operator=(const ProjectIndex&) = delete;
+
+  /** Crawl the whole project again, in the background. */
+  void rescan();
+  /** Invoke callback whenever the whole project has been indexed, and right away if it already is. */
+  void set_on_indexed(std::function<void()> callback);
+  /** Use listings fetched by someone else until the crawl is done. */
+  void set_listings(const std::map<std::string, std::vector<DirEntry>>& new_listings);
+
+  /** False until the project has been indexed at least once (in this or in an earlier session). */
+  inline bool is_ready() const { return has_listings; }
+  inline bool is_crawling() const { return num_crawl_outstanding > 0; }
+  /** Absolute paths of all files (and links) in the project. */
+  const std::vector<std::string>& get_files();
+};
+
+#endif
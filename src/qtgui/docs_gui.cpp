@@ -35,7 +35,7 @@ DocsGui::DocsGui(MainWindow* mw) : main_window(mw) {
     root_widget->setLayout(vlayout);
   }
 
-  doc_hook = all_docs_hook.add(std::bind(&DocsGui::doc_callback, this, std::placeholders::_1, std::placeholders::_2));
+  doc_hook = all_docs_hook.add(std::bind(&DocsGui::doc_callback, this, std::placeholders::_1, std::placeholders::_2), "Tabs");
 }
 
 void DocsGui::doc_callback(Doc* doc, int flags) {
@@ -77,6 +77,7 @@ void DocsGui::set_current_index(int index) {
   current_index = index;
   Doc* doc = get_current_doc();
   main_window->set_current_doc(doc);
+  if (doc != nullptr) master.document_shown(doc);
   editor->set_document(doc);
   restore_scroll_info();
   if (index >= 0) {
@@ -176,6 +177,11 @@ void DocsGui::go_to_doc(Doc* doc) {
   }
 }
 
+void DocsGui::add_view_memory_usage(Doc* doc, MemoryUsage& usage) {
+  // The editor only holds anything for the document it shows.
+  if (doc == get_current_doc()) editor->add_memory_usage(usage);
+}
+
 void DocsGui::slot_tab_closed(int index) {
   master.set_markovian(MARKOVIAN_NONE);
   Doc* doc = docs.at(index);
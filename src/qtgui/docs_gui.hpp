@@ -40,6 +40,7 @@ public:
   virtual void add_doc(Doc* doc, bool switch_to_doc) override;
   virtual void remove_doc(Doc* doc) override;
   virtual void go_to_doc(Doc* doc) override;
+  virtual void add_view_memory_usage(Doc* doc, MemoryUsage& usage) override;
 
 //  void refresh_tab(int tab_index);
 
@@ -1,3 +1,4 @@
+#include "core/perf.hpp"
 #include "core/rich_text.hpp"
 #include "core/utf8_util.hpp"
 #include "core/util.hpp"
@@ -5,11 +6,13 @@
 #include "qtgui/editor.hpp"
 #include "qtgui/main_window.hpp"
 
+#include <cstdio>
 #include <cstdlib>
 #include <QApplication>
 #include <QFontDatabase>
 #include <QGuiApplication>
 #include <QImage>
+#include <QLabel>
 #include <QPainter>
 #include <QPaintEvent>
 #include <QScrollArea>
@@ -47,7 +50,7 @@ void MyScrollArea::get_visible_extent(int& x1, int& x2, int& y1, int& y2) {
   y2 = bar->value() + bar->pageStep();
 }
 
-Editor::Editor(QWidget* parent, MainWindow* mw) : QWidget(parent), main_window(mw), document(nullptr), cursor_visible(true), last_blink_time(0), navigation_mode(false), glyph_store(font), glyph_store_bold(bold_font), glyph_store_italic(italic_font), fold_line_height(4), fold_alpha(100), ruler_width(100), line_numbers_visible(true), highlight_cursor_line(true), word_wrap(true), draw_word_wrap_guides(true), editor_width(0), editor_height(0) {
+Editor::Editor(QWidget* parent, MainWindow* mw) : QWidget(parent), main_window(mw), document(nullptr), cursor_visible(true), last_blink_time(0), navigation_mode(false), perf_hud(nullptr), glyph_store(font), glyph_store_bold(bold_font), glyph_store_italic(italic_font), fold_line_height(4), fold_alpha(100), ruler_width(100), line_numbers_visible(true), highlight_cursor_line(true), word_wrap(true), draw_word_wrap_guides(true), editor_width(0), editor_height(0) {
   q_timer = new QTimer(this);
   connect(q_timer, &QTimer::timeout, this, &Editor::slot_timer);
   q_timer->start(100);
@@ -176,6 +179,7 @@ void Editor::ensure_visible(int x, int y, int size) {
 }
 
 void Editor::reflow() {
+  PerfTimer timer(PERF_REFLOW);
   if (document == nullptr) {
     editor_width = 300;
     editor_height = 300;
@@ -226,12 +230,17 @@ void Editor::set_document(Doc* d) {
   // Add document hook
   document_hook = d->get_doc_hook()->add(
       std::bind(&Editor::document_callback, this, std::placeholders::_1,
-      std::placeholders::_2));
+      std::placeholders::_2), "Editor");
 
   // Update cursor to IBeam.
   setCursor(Qt::IBeamCursor);
 }
 
+void Editor::add_memory_usage(MemoryUsage& usage) const {
+  usage.bytes[MEM_FLOW_GRID] += flow_grid.get_memory_usage();
+  for (const FoldImageCache& c : fold_images) usage.bytes[MEM_FOLD_IMAGES] += c.image.byteCount();
+}
+
 void Editor::set_navigation_mode(bool nm) {
   navigation_mode = nm;
   update();
@@ -327,6 +336,31 @@ void Editor::slot_timer() {
   if (cursor_visible != last_cursor_visible) {
     update(cursor_position_x-4, cursor_position_y, 8, cursor_size);
   }
+  if (perf_hud != nullptr && perf_hud->isVisible()) refresh_perf_hud();
+}
+
+void Editor::set_perf_hud(bool visible) {
+  if (perf_hud == nullptr) {
+    if (!visible) return;
+    perf_hud = new QLabel(scroll_area->viewport());
+    perf_hud->setAttribute(Qt::WA_TransparentForMouseEvents);
+    perf_hud->setFont(overlay_font);
+    perf_hud->setStyleSheet("QLabel { background: rgba(0, 0, 0, 180); color: white; padding: 4px; }");
+  }
+  perf_hud->setVisible(visible);
+  if (visible) refresh_perf_hud();
+}
+
+void Editor::refresh_perf_hud() {
+  char text[256];
+  snprintf(text, sizeof(text), "frame %.2f ms (%.0f/s)\nreflow %.2f ms\nhighlight %.2f ms\nevents %.0f/s",
+      perf.get_last(PERF_PAINT) * 1000, perf.get_rate(PERF_PAINT), perf.get_last(PERF_REFLOW) * 1000,
+      (perf.get_last(PERF_PROCESS_DOCUMENT) + perf.get_last(PERF_HIGHLIGHT)) * 1000,
+      perf.get_rate(PERF_DOC_EVENTS));
+  perf_hud->setText(text);
+  perf_hud->adjustSize();
+  perf_hud->move(scroll_area->viewport()->width() - perf_hud->width() - 8, 8);
+  perf_hud->raise();
 }
 
 int Editor::line_height() { return glyph_store.get_line_height(); }
@@ -356,6 +390,8 @@ void Editor::keyPressEvent(QKeyEvent* event) {
   event->accept();
 
   if (document == nullptr) return;
+  // Cursor movement maps through the flow grid, which must be current.
+  doc_events.flush(document);
 
   // Set VisualPayload for this document
   {
@@ -445,6 +481,7 @@ void Editor::mouseDoubleClickEvent(QMouseEvent* event){
   if (document == nullptr) return;
 
   if (event->buttons() & Qt::LeftButton) {
+    doc_events.flush(document);
     CursorLocation cl = flow_grid.unmap(event->x(), event->y());
     reset_blink();
     document->handle_mouse(cl.row, cl.col, false, false, true);
@@ -461,6 +498,8 @@ void Editor::mouseMoveEvent(QMouseEvent* event){
 
   if (event->buttons() & Qt::LeftButton) {
     if (document == nullptr) return;
+    // The flow grid must be current to map the mouse.
+    doc_events.flush(document);
     CursorLocation cl = flow_grid.unmap(event->x(), event->y());
     reset_blink();
     document->handle_mouse(cl.row, cl.col, true, false);
@@ -476,6 +515,7 @@ void Editor::mousePressEvent(QMouseEvent* event){
     return;
   }
 
+  doc_events.flush(document);
   CursorLocation cl = flow_grid.unmap(event->x(), event->y());
   reset_blink();
   document->handle_mouse(cl.row, cl.col, QGuiApplication::keyboardModifiers() & Qt::ShiftModifier, QGuiApplication::keyboardModifiers() & Qt::ControlModifier);
@@ -503,6 +543,10 @@ void render_box(QPainter* painter, FlowGrid* flow_grid, int row, int col1, int c
 }
 
 void Editor::paintEvent(QPaintEvent* event) {
+  PerfTimer timer(PERF_PAINT);
+  // Events of this frame must be processed (reflown, highlighted) before it is painted.
+  if (document != nullptr) doc_events.flush(document);
+
   QPainter painter(this);
   painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing);
 
@@ -699,7 +743,10 @@ void Editor::paintEvent(QPaintEvent* event) {
   overlay_line_pen.setColor(theme.overlay_line_color);
   painter.setFont(overlay_font);
 
-  for (const Overlay &overlay : document->get_appendage().rich_text.overlays) {
+  std::vector<const Overlay*> visible_overlays;
+  document->get_appendage().rich_text.get_overlays(start_paint_row, end_paint_row, visible_overlays);
+  for (const Overlay* o : visible_overlays) {
+    const Overlay& overlay = *o;
     // Check the overlay.
     const int drow = overlay.drow, dcol = overlay.dcol;
     if (drow < 0 || drow >= tf->get_num_lines()) {
@@ -15,6 +15,7 @@
 
 class Editor;
 class MainWindow;
+class QLabel;
 class QResizeEvent;
 class QTimer;
 
@@ -67,6 +68,10 @@ private:
   /** Is it navigation mode? */
   bool navigation_mode;
 
+  /** Overlay with timings of the last frame, created when first shown. */
+  QLabel* perf_hud;
+  void refresh_perf_hud();
+
   //////////////////////////////////////////////////////////// Cursor position
 
   /** Mouse is being held. */
@@ -160,6 +165,9 @@ public:
   int line_height();
   void set_document(Doc* d);
   void set_navigation_mode(bool nm);
+  void set_perf_hud(bool visible);
+  /** Add memory held by the flow grid and fold images. */
+  void add_memory_usage(MemoryUsage& usage) const;
 
   void reload_settings();
 
@@ -68,7 +68,7 @@ void JfDialog::showEvent(QShowEvent* event) {
   q_file_name->setFocus();
 
   int i = 0;
-  choice_list.choices.clear();
+  choice_list.clear();
   for (KnownDocument& kd : known_documents) {
     choice_list.add_choice(kd.abs_path, i);
     i++;
@@ -89,6 +89,8 @@ void JfDialog::slot_text_changed(const QString& new_text) {
 void JfDialog::slot_text_return() {
   int current = q_file_list->currentRow();
   if (current < 0) current = 0;
+  // Nothing matches the query.
+  if (current >= int(choice_list.chosen.size())) return;
 
   Choice* choice = choice_list.chosen[current];
   KnownDocument& kd = known_documents[choice->num];
@@ -97,7 +99,9 @@ void JfDialog::slot_text_return() {
 }
 
 void JfDialog::slot_list_double_clicked(QListWidgetItem* item) {
-  Choice* choice = choice_list.chosen[item->type()];
+  const int index = item->type();
+  if (index < 0 || index >= int(choice_list.chosen.size())) return;
+  Choice* choice = choice_list.chosen[index];
   KnownDocument& kd = known_documents[choice->num];
   master.open_document(kd.abs_path.c_str(), main_window);
   hide();
@@ -1,8 +1,10 @@
+#include "console.hpp"
 #include "keymapper.hpp"
 #include "lm.hpp"
 #include "master.hpp"
 #include "master_io_provider.hpp"
 #include "master_js.hpp"
+#include "core/perf.hpp"
 #include "core/util.hpp"
 #include "core/util_path.hpp"
 #include "core/utf8_util.hpp"
@@ -286,6 +288,10 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), menu_manager(new
     connect(q_action_edit_find_replace, &QAction::triggered, this, &MainWindow::slot_find_replace);
     q_menu_edit->addAction(q_action_edit_find_replace);
 
+    // Only shown in the context menu of a console.
+    q_action_console_history = new QAction("Full &Scrollback", this);
+    connect(q_action_console_history, &QAction::triggered, this, &MainWindow::slot_console_history);
+
     q_action_edit_global_find = new QAction("&Global Find...", this);
     q_action_edit_global_find->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_F));
     connect(q_action_edit_global_find, &QAction::triggered, this, &MainWindow::slot_global_find);
@@ -417,6 +423,10 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), menu_manager(new
     connect(q_action_plugins_reload, &QAction::triggered, this, &MainWindow::slot_plugins_reload);
     q_menu_plugins->addAction(q_action_plugins_reload);
 
+    q_action_plugins_profile = new QAction("Plugin profile", this);
+    connect(q_action_plugins_profile, &QAction::triggered, this, &MainWindow::slot_plugins_profile);
+    q_menu_plugins->addAction(q_action_plugins_profile);
+
     q_menu_plugins->addSeparator();
 
     q_menu_plugins_actions = new QActionGroup(this);
@@ -438,6 +448,31 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), menu_manager(new
     q_action_help_online = new QAction("&Online Help", this);
     connect(q_action_help_online, &QAction::triggered, this, &MainWindow::slot_help_online);
     q_menu_help->addAction(q_action_help_online);
+
+    q_action_help_startup_trace = new QAction("Startup trace", this);
+    connect(q_action_help_startup_trace, &QAction::triggered, this, &MainWindow::slot_help_startup_trace);
+    q_menu_help->addAction(q_action_help_startup_trace);
+
+    q_action_help_event_profile = new QAction("Event profile", this);
+    connect(q_action_help_event_profile, &QAction::triggered, this, &MainWindow::slot_help_event_profile);
+    q_menu_help->addAction(q_action_help_event_profile);
+
+    q_action_help_memory_usage = new QAction("Memory usage", this);
+    connect(q_action_help_memory_usage, &QAction::triggered, this, &MainWindow::slot_help_memory_usage);
+    q_menu_help->addAction(q_action_help_memory_usage);
+
+    q_action_help_perf_hud = new QAction("Performance HUD", this);
+    q_action_help_perf_hud->setCheckable(true);
+    connect(q_action_help_perf_hud, &QAction::triggered, this, &MainWindow::slot_help_perf_hud);
+    q_menu_help->addAction(q_action_help_perf_hud);
+
+    q_action_help_perf_report = new QAction("Performance report", this);
+    connect(q_action_help_perf_report, &QAction::triggered, this, &MainWindow::slot_help_perf_report);
+    q_menu_help->addAction(q_action_help_perf_report);
+
+    q_action_help_perf_trace = new QAction("Export performance trace...", this);
+    connect(q_action_help_perf_trace, &QAction::triggered, this, &MainWindow::slot_help_perf_trace);
+    q_menu_help->addAction(q_action_help_perf_trace);
   }
 
   std::function<void()> func;
@@ -560,6 +595,10 @@ void MainWindow::editor_context(QPoint p) {
   menu.addAction(q_action_edit_uncomment);
   menu.addSeparator();
   menu.addAction(q_action_edit_find_replace);
+  if (dynamic_cast<Console*>(get_active_document()) != nullptr) {
+    menu.addSeparator();
+    menu.addAction(q_action_console_history);
+  }
   menu.exec(p);
 }
 
@@ -1175,6 +1214,11 @@ void MainWindow::slot_plugins_reload() {
   master.feedback("Plugins reloaded", output);
 }
 
+void MainWindow::slot_plugins_profile() {
+  master.set_markovian(MARKOVIAN_NONE);
+  master.open_temp_read_only_document("Plugin profile", master_js->get_profile_report());
+}
+
 
 void MainWindow::slot_tools_invoke() {
   master.set_markovian(MARKOVIAN_NONE);
@@ -1197,6 +1241,51 @@ void MainWindow::slot_help_online() {
   master.set_markovian(MARKOVIAN_NONE);
   QDesktopServices::openUrl(QUrl("https://syntaxiceditor.com/help/"));
 }
+void MainWindow::slot_help_startup_trace() {
+  master.set_markovian(MARKOVIAN_NONE);
+  master.open_temp_read_only_document("Startup trace", master.startup_trace.report());
+}
+void MainWindow::slot_help_event_profile() {
+  master.set_markovian(MARKOVIAN_NONE);
+  master.open_temp_read_only_document("Event profile", doc_events.get_profile_report());
+}
+void MainWindow::slot_help_memory_usage() {
+  master.set_markovian(MARKOVIAN_NONE);
+  master.open_temp_read_only_document("Memory usage", master.get_memory_report());
+}
+
+void MainWindow::slot_console_history() {
+  master.set_markovian(MARKOVIAN_NONE);
+  Console* console = dynamic_cast<Console*>(get_active_document());
+  if (console == nullptr) return;
+  master.open_temp_read_only_document("Scrollback", console->get_full_history());
+}
+void MainWindow::slot_help_perf_hud() {
+  master.set_markovian(MARKOVIAN_NONE);
+  const bool visible = q_action_help_perf_hud->isChecked();
+  // Timers only record while the HUD is up.
+  perf.set_enabled(visible);
+  for (int i = 0; i < 2; i++) {
+    docs_guis[i]->editor->set_perf_hud(visible);
+  }
+}
+void MainWindow::slot_help_perf_report() {
+  master.set_markovian(MARKOVIAN_NONE);
+  master.open_temp_read_only_document("Performance report", perf.report());
+}
+void MainWindow::slot_help_perf_trace() {
+  master.set_markovian(MARKOVIAN_NONE);
+  std::string out_file;
+  if (get_user_file(out_file, "Export performance trace...", "Trace files (*.json)",
+      UF_SAVE | UF_OVERWRITE_PROMPT) != UI_YES) return;
+  const std::string trace = perf.chrome_trace();
+  try {
+    write_file(trace.c_str(), trace.size(), out_file);
+  } catch (std::exception& e) {
+    QMessageBox::critical(this, "Export performance trace", QString::fromStdString(
+        std::string("Failed to write trace: ") + e.what()));
+  }
+}
 
 /////////////////////////////////////////////////////////////////////// Implement UIWindow interface
 
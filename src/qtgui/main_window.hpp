@@ -84,6 +84,7 @@ private:
     QAction* q_action_edit_uncomment;
     QAction* q_action_edit_complete;
     QAction* q_action_edit_find_replace;
+    QAction* q_action_console_history;
     QAction* q_action_edit_global_find;
     QAction* q_action_edit_navigation_mode;
     QAction* q_action_edit_preferences;
@@ -104,11 +105,18 @@ private:
   QMenu* q_menu_plugins;
     QAction* q_action_plugins_manage;
     QAction* q_action_plugins_reload;
+    QAction* q_action_plugins_profile;
     QActionGroup* q_menu_plugins_actions;
   QMenu* q_menu_help;
     QAction* q_action_help_about;
     QAction* q_action_help_enter_license;
     QAction* q_action_help_online;
+    QAction* q_action_help_startup_trace;
+    QAction* q_action_help_event_profile;
+    QAction* q_action_help_memory_usage;
+    QAction* q_action_help_perf_hud;
+    QAction* q_action_help_perf_report;
+    QAction* q_action_help_perf_trace;
 
   QSplitter* q_splitter;
     // Sidebar:
@@ -220,9 +228,17 @@ private slots:
   void slot_tools_invoke();
   void slot_plugins_manage();
   void slot_plugins_reload();
+  void slot_plugins_profile();
   void slot_help_about();
   void slot_help_enter_license();
   void slot_help_online();
+  void slot_help_startup_trace();
+  void slot_help_event_profile();
+  void slot_help_memory_usage();
+  void slot_console_history();
+  void slot_help_perf_hud();
+  void slot_help_perf_report();
+  void slot_help_perf_trace();
 
 public slots:
   void slot_document_next();
@@ -13,6 +13,7 @@
 #include "qtgui/qtmain.hpp"
 
 #include <cstdio>
+#include <functional>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDesktopServices>
@@ -29,6 +30,7 @@
 #include <QStandardPaths>
 #include <QStyleFactory>
 #include <QTextStream>
+#include <QTimer>
 
 MyApplication* my_application;
 
@@ -93,6 +95,115 @@ void MyApplication::slot_network_request_finished() {
 
 #ifndef NO_QT_MAIN
 
+/** If the main window is never painted (e.g. starts minimized), deferred startup runs after this
+many milliseconds anyway. */
+#define STARTUP_DEFER_TIMEOUT 1000
+
+/** Invokes a callback, once, right after the first paint of the widget it filters. */
+class FirstPaintFilter : public QObject {
+private:
+  std::function<void()> callback;
+
+public:
+  FirstPaintFilter(std::function<void()> cb) : callback(cb) {}
+
+  virtual bool eventFilter(QObject* /* obj */, QEvent* ev) override {
+    // Top level widgets paint themselves and their children on UpdateRequest, so the next turn of
+    // the event loop comes after the first paint.
+    if (ev->type() == QEvent::UpdateRequest && callback) {
+      QTimer::singleShot(0, callback);
+      callback = nullptr;
+    }
+    return false;
+  }
+};
+
+static void check_for_updates() {
+  QNetworkAccessManager* manager = new QNetworkAccessManager(my_application);
+  QNetworkRequest req(QUrl("https://syntaxiceditor.com/version/0.9.3"));
+  req.setRawHeader( "User-Agent" , "Syntaxic");
+  my_application->network_reply = manager->get(req);
+  QObject::connect(my_application->network_reply, &QNetworkReply::finished, my_application, &MyApplication::slot_network_request_finished);
+}
+
+/** Directory of the last file given on the command line, the default file browser starts there. */
+static std::string command_line_dir;
+
+static void restore_file_providers() {
+  // Check the saved state of file providers. If there are any projects open, then open them now.
+  bool default_file_browser = true;
+  {
+    std::vector<STreeSave> fpss = master.settings.get_sidebar_state();
+    if (fpss.size() > 0) {
+      if (fpss.size() > 1 || fpss[0].type != FILE_PROVIDER_SAVE_FILE_BROWSER) {
+        for (STreeSave& fps: fpss) {
+          switch(fps.type) {
+            case FILE_PROVIDER_SAVE_FILE_BROWSER:
+            //  {
+            //    std::unique_ptr<STree> fp(new FileBrowser(fps.path));
+            //    master.add_file_provider(std::move(fp));
+            //  }
+              break;
+            case FILE_PROVIDER_SAVE_PROJECT:
+              master.open_project(fps.path);
+              default_file_browser = false;
+              break;
+          }
+        }
+        //default_file_browser = false;
+      }
+    }
+  }
+
+  // Start a file browser if no other file providers are recorded
+  if (default_file_browser) {
+    // Documents from the command line may still be loading, so go by their paths.
+    std::string path = command_line_dir;
+    if (path.empty()) {
+      path = master.settings.get_current_path();
+    }
+    if (path.empty()) {
+    //     * If started from a dir, and this dir:
+    //         - does not contain syntaxic
+    //         - is a subdir of home
+    }
+    if (path.empty()) {
+      path = QDir::homePath().toStdString();
+    }
+    std::unique_ptr<STree> fp(new FileBrowser(path));
+    master.add_file_provider(std::move(fp));
+  }
+}
+
+static void load_plugins() {
+  try {
+    master_js->make_default_syntaxic_js_file();
+    master_js->eval_syntaxic_js_file();
+  } catch (std::exception& e) {
+    QMessageBox::critical(nullptr, "Failed to initialize plugin system", QString::fromStdString(std::string("Check '") + master_js->get_syntaxic_js_file() + "'."));
+  }
+}
+
+/** Everything that is not needed to paint the main window, run once it has been painted. */
+static void deferred_startup() {
+  master.startup_trace.mark("First paint");
+  {
+    PhaseTimer timer(master.startup_trace, "Restore file providers");
+    restore_file_providers();
+  }
+  {
+    PhaseTimer timer(master.startup_trace, "Load plugins");
+    load_plugins();
+  }
+  {
+    PhaseTimer timer(master.startup_trace, "Update check");
+    check_for_updates();
+  }
+  if (qgetenv("SYNTAXIC_STARTUP_TRACE").size() > 0) {
+    printf("Startup trace:\n%s", master.startup_trace.report().c_str());
+  }
+}
+
 int main(int argc, char **argv) {
   MyApplication app(argc, argv);
   my_application = &app;
@@ -113,13 +224,10 @@ int main(int argc, char **argv) {
       printf("WARNING: Could not create %s/syntaxic.  Functionality will be broken.\n", generic_dir.c_str());
     }
   }
+  master.startup_trace.mark("QApplication created");
 
-  // Make a check for updated version
-  QNetworkAccessManager manager;
-  QNetworkRequest req(QUrl("https://syntaxiceditor.com/version/0.9.3"));
-  req.setRawHeader( "User-Agent" , "Syntaxic");
-  my_application->network_reply = manager.get(req);
-  QObject::connect(my_application->network_reply, &QNetworkReply::finished, my_application, &MyApplication::slot_network_request_finished);
+  // Document events are coalesced and delivered once per pass of the event loop.
+  doc_events.set_scheduler([]() { QTimer::singleShot(0, []() { doc_events.flush(); }); });
 
   // Fusion style:
 //  app.setStyle(QStyleFactory::create("Fusion"));
@@ -143,8 +251,11 @@ int main(int argc, char **argv) {
 
   MasterIOProvider _master_io_provider;
   MasterNavigators _master_navigators;
+  const double master_js_start = get_timestamp();
   MasterJS _master_js;
+  master.startup_trace.add("Plugin heap", master_js_start);
   try {
+    PhaseTimer timer(master.startup_trace, "Master");
     master.init_master();
   } catch (std::exception& e) {
     std::string text = "Error while starting Syntaxic:\n\n";
@@ -157,92 +268,52 @@ int main(int argc, char **argv) {
   app.reload_settings();
 
   try {
+    PhaseTimer timer(master.startup_trace, "Main window");
     master.create_main_window();
   } catch (std::exception& e) {
     QMessageBox::critical(nullptr, "Failed to create window", "Could not create a window. Please report this problem to support@kpartite.com.");
     return 1;
   }
 
-  if (argc <= 1) master.new_document(nullptr);
-  else {
-    for (int i = 1; i < argc; i++) {
-      char* arg = argv[i];
-      master.open_document(arg, nullptr);
-    }
-  }
-
-  // Check the saved state of file providers. If there are any projects open, then open them now.
-  bool default_file_browser = true;
   {
-    std::vector<STreeSave> fpss = master.settings.get_sidebar_state();
-    if (fpss.size() > 0) {
-      if (fpss.size() > 1 || fpss[0].type != FILE_PROVIDER_SAVE_FILE_BROWSER) {
-        for (STreeSave& fps: fpss) {
-          switch(fps.type) {
-            case FILE_PROVIDER_SAVE_FILE_BROWSER:
-            //  {
-            //    std::unique_ptr<STree> fp(new FileBrowser(fps.path));
-            //    master.add_file_provider(std::move(fp));
-            //  }
-              break;
-            case FILE_PROVIDER_SAVE_PROJECT:
-              master.open_project(fps.path);
-              default_file_browser = false;
-              break;
-          }
-        }
-        //default_file_browser = false;
+    PhaseTimer timer(master.startup_trace, "Open documents");
+    if (argc <= 1) master.new_document(nullptr);
+    else {
+      for (int i = 1; i < argc; i++) {
+        char* arg = argv[i];
+        master.open_document(arg, nullptr);
+        command_line_dir = QFileInfo(QString::fromLocal8Bit(arg)).absolutePath().toStdString();
       }
     }
-  }
 
-  // Start a file browser if no other file providers are recorded
-  if (default_file_browser) {
-    std::string path = "";
-    {
-      std::vector<std::unique_ptr<Doc>>& documents = master.get_documents();
-      if (documents.size() > 0) {
-        Document* last_doc = dynamic_cast<Document*>(documents.back().get());
-        if (last_doc != nullptr && !last_doc->get_text_file()->is_new()) {
-          std::string abs_path = last_doc->get_text_file()->get_absolute_path();
-          QFileInfo fi(QString::fromStdString(abs_path));
-          path = fi.absolutePath().toStdString();
-        }
-      }
-    }
-    if (path.empty()) {
-      path = master.settings.get_current_path();
+    // Open welcome page
+    if (master.settings.get_first_time()) {
+      master.open_welcome();
+      master.settings.set_first_time();
     }
-    if (path.empty()) {
-    //     * If started from a dir, and this dir:
-    //         - does not contain syntaxic
-    //         - is a subdir of home
-    }
-    if (path.empty()) {
-      path = QDir::homePath().toStdString();
-    }
-    std::unique_ptr<STree> fp(new FileBrowser(path));
-    master.add_file_provider(std::move(fp));
   }
 
-  // Open welcome page
-  if (master.settings.get_first_time()) {
-    master.open_welcome();
-    master.settings.set_first_time();
-  }
+  // File providers (which may list remote directories), plugins and the update check only start
+  // once the window is on screen.
+  {
+    bool started = false;
+    std::function<void()> start = [&started]() {
+      if (started) return;
+      started = true;
+      deferred_startup();
+    };
+    MainWindow* mw = dynamic_cast<MainWindow*>(master.get_main_window());
+    FirstPaintFilter first_paint_filter(start);
+    if (mw != nullptr) mw->installEventFilter(&first_paint_filter);
+    QTimer::singleShot(STARTUP_DEFER_TIMEOUT, start);
 
-  // Load plugins
-  try {
-    master_js->make_default_syntaxic_js_file();
-    master_js->eval_syntaxic_js_file();
-  } catch (std::exception& e) {
-    QMessageBox::critical(nullptr, "Failed to initialize plugin system", QString::fromStdString(std::string("Check '") + master_js->get_syntaxic_js_file() + "'."));
+    int rv = app.exec();
+    if (mw != nullptr) mw->removeEventFilter(&first_paint_filter);
+    doc_events.set_scheduler(nullptr);
+    master_io_provider->clear_io_providers();
+    master.delete_windows();
+    return rv;
   }
-
-  int rv = app.exec();
-  master_io_provider->clear_io_providers();
-  master.delete_windows();
-  return rv;
 }
 
 #endif
\ No newline at end of file
@@ -116,6 +116,7 @@ void SidebarModel::end_rows_insert() {
 void SidebarModel::add_provider(STree* provider) {
   begin_rows_insert(nullptr, providers.size(), 1);
   provider->get_root_node()->set_index(providers.size());
+  provider->set_change_notifier(this);
   providers.push_back(provider);
   end_rows_insert();
 }
@@ -123,6 +124,7 @@ void SidebarModel::add_provider(STree* provider) {
 void SidebarModel::add_provider_first(STree* provider) {
   begin_rows_insert(nullptr, 0, 1);
   provider->get_root_node()->set_index(0);
+  provider->set_change_notifier(this);
   providers.insert(providers.begin(), provider);
   for (unsigned int i = 1; i < providers.size(); i++) {
     providers[i]->get_root_node()->set_index(i);
@@ -134,6 +136,7 @@ void SidebarModel::remove_provider(STree* provider) {
   for (unsigned int i = 0; i < providers.size(); i++) {
     STree* fp = providers[i];
     if (fp == provider) {
+      provider->set_change_notifier(nullptr);
       begin_rows_delete(nullptr, i, 1);
       providers.erase(providers.begin() + i);
       end_rows_delete();
@@ -0,0 +1,154 @@
+#include "io_provider.hpp"
+#include "remote_transfer.hpp"
+
+#include <cstdio>
+#include <QByteArray>
+
+namespace RemoteTransfer {
+
+uint32_t checksum(const char* data, unsigned int size) {
+  const unsigned char* udata = reinterpret_cast<const unsigned char*>(data);
+  uint32_t a = 1, b = 0;
+  for (unsigned int i = 0; i < size; i++) {
+    a = (a + udata[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+std::string encode_path(const std::string& path) {
+  QByteArray arr = QByteArray(path.data(), path.size()).toBase64();
+  return std::string(arr.constData(), arr.size());
+}
+
+std::string encode_frames(const char* data, unsigned int size, bool compress) {
+  std::string frames;
+  for (unsigned int pos = 0; pos < size; pos += REMOTE_TRANSFER_CHUNK_SIZE) {
+    unsigned int chunk_size = size - pos;
+    if (chunk_size > REMOTE_TRANSFER_CHUNK_SIZE) chunk_size = REMOTE_TRANSFER_CHUNK_SIZE;
+
+    QByteArray payload;
+    char mode = 'R';
+    if (compress) {
+      // qCompress prepends 4 bytes of expected size, the rest is a plain zlib stream.
+      QByteArray compressed = qCompress(reinterpret_cast<const uchar*>(data + pos), chunk_size);
+      if (compressed.size() - 4 < int(chunk_size)) {
+        payload = compressed.mid(4);
+        mode = 'Z';
+      }
+    }
+    if (mode == 'R') payload = QByteArray(data + pos, chunk_size);
+
+    frames += "[CHUNK ";
+    frames += mode;
+    frames += " " + std::to_string(chunk_size) + " " + std::to_string(payload.size()) + " ";
+    QByteArray encoded = payload.toBase64();
+    frames.append(encoded.constData(), encoded.size());
+    frames += "]\n";
+  }
+
+  char adler[16];
+  snprintf(adler, sizeof(adler), "%08x", checksum(data, size));
+  frames += "[END " + std::to_string(size) + " " + adler + "]\n";
+  return frames;
+}
+
+/** Split "[A B C]" into {"A", "B", "C"}.  Returns false if line is not a frame. */
+static bool split_frame(const std::string& output, size_t start, size_t end,
+    std::vector<std::string>& args) {
+  if (end - start < 2 || output[start] != '[' || output[end-1] != ']') return false;
+  start++;
+  end--;
+
+  args.clear();
+  while (start < end) {
+    size_t space = output.find(' ', start);
+    if (space == std::string::npos || space > end) space = end;
+    if (space > start) args.push_back(output.substr(start, space - start));
+    start = space + 1;
+  }
+  return !args.empty();
+}
+
+static unsigned long to_number(const std::string& s, int base) {
+  try {
+    return std::stoul(s, nullptr, base);
+  } catch (...) {
+    throw IOProviderError("Invalid number in transfer: '" + s + "'");
+  }
+}
+
+std::vector<char> decode_frames(const std::string& output) {
+  std::vector<char> data;
+  std::vector<std::string> args;
+
+  size_t start = 0;
+  while (start < output.size()) {
+    const size_t next = output.find('\n', start);
+    size_t end = (next == std::string::npos) ? output.size() : next;
+    if (end > start && output[end-1] == '\r') end--;
+
+    if (split_frame(output, start, end, args)) {
+      if (args[0] == "CHUNK") {
+        if (args.size() != 5) throw IOProviderError("Invalid chunk in transfer.");
+        const unsigned long raw_size = to_number(args[2], 10);
+        const unsigned long payload_size = to_number(args[3], 10);
+        QByteArray payload = QByteArray::fromBase64(QByteArray(args[4].data(), args[4].size()));
+        if ((unsigned long) payload.size() != payload_size) {
+          throw IOProviderError("Corrupted chunk in transfer.");
+        }
+        if (args[1] == "Z") {
+          // qUncompress expects the 4 byte big-endian size in front of the zlib stream.
+          QByteArray with_size(4, 0);
+          with_size[0] = char((raw_size >> 24) & 0xff);
+          with_size[1] = char((raw_size >> 16) & 0xff);
+          with_size[2] = char((raw_size >> 8) & 0xff);
+          with_size[3] = char(raw_size & 0xff);
+          with_size.append(payload);
+          payload = qUncompress(with_size);
+        }
+        if ((unsigned long) payload.size() != raw_size) {
+          throw IOProviderError("Corrupted chunk in transfer.");
+        }
+        data.insert(data.end(), payload.constData(), payload.constData() + payload.size());
+      } else if (args[0] == "END") {
+        if (args.size() != 3) throw IOProviderError("Invalid end of transfer.");
+        if (to_number(args[1], 10) != data.size()) {
+          throw IOProviderError("Size mismatch in transfer.");
+        }
+        if (to_number(args[2], 16) != checksum(data.data(), data.size())) {
+          throw IOProviderError("Checksum mismatch in transfer.");
+        }
+        return data;
+      } else if (args[0] == "ERROR") {
+        throw IOProviderError(output.substr(start + 7, end - start - 8));
+      }
+    }
+    if (next == std::string::npos) break;
+    start = next + 1;
+  }
+  throw IOProviderError("Transfer is incomplete.");
+}
+
+void check_reply(const std::string& output) {
+  std::vector<std::string> args;
+
+  size_t start = 0;
+  while (start < output.size()) {
+    const size_t next = output.find('\n', start);
+    size_t end = (next == std::string::npos) ? output.size() : next;
+    if (end > start && output[end-1] == '\r') end--;
+
+    if (split_frame(output, start, end, args)) {
+      if (args[0] == "OK") return;
+      if (args[0] == "ERROR") {
+        throw IOProviderError(output.substr(start + 7, end - start - 8));
+      }
+    }
+    if (next == std::string::npos) break;
+    start = next + 1;
+  }
+  throw IOProviderError("No reply from remote agent.");
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef SYNTAXIC_REMOTE_TRANSFER_HPP
+#define SYNTAXIC_REMOTE_TRANSFER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Maximum raw size of a single chunk.  Must not be larger than CHUNK_SIZE in
+code/src/remote_edit.c.  Kept small so that a base64 encoded frame stays under
+REMOTE_TRANSFER_MAX_LINE. */
+#define REMOTE_TRANSFER_CHUNK_SIZE 2048
+
+/** A tty in canonical mode drops everything past 4095 bytes of a line.  Frames we send must be
+shorter than this in case they reach the remote side before the agent switches its tty to raw. */
+#define REMOTE_TRANSFER_MAX_LINE 4095
+
+/** Framing used to talk to the remote agent (syntaxic_remote_editor).  See code/src/remote_edit.c
+for the description of the protocol. */
+namespace RemoteTransfer {
+  /** Adler-32 of the data. */
+  uint32_t checksum(const char* data, unsigned int size);
+
+  /** Encode a path so that it can be passed as a single command argument. */
+  std::string encode_path(const std::string& path);
+
+  /** Encode data as [CHUNK ...] frames followed by an [END ...] frame.  If compress is set, chunks
+  are zlib compressed whenever that makes them smaller. */
+  std::string encode_frames(const char* data, unsigned int size, bool compress);
+
+  /** Decode frames out of agent's output.  Lines that are not frames are ignored.  Throws
+  IOProviderError on [ERROR ...], on incomplete transfer or on size or checksum mismatch. */
+  std::vector<char> decode_frames(const std::string& output);
+
+  /** Check the reply to a command that does not return data.  Throws IOProviderError unless
+  there is an [OK] frame. */
+  void check_reply(const std::string& output);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "core/util.hpp"
+#include "core/util_glob.hpp"
 #include "core/util_path.hpp"
 #include "core/utf8_util.hpp"
 #include "file_browser.hpp"
@@ -6,12 +7,13 @@
 #include "master_io_provider.hpp"
 #include "process.hpp"
 #include "process_impl.hpp"
+#include "remote_transfer.hpp"
 #include "ssh_io_provider.hpp"
 #include "qtgui/dock.hpp"
 #include "qtgui/main_window.hpp"
 
+#include <map>
 #include <string>
-#include <QDir>
 #include <QEventLoop>
 #include <QMessageBox>
 #include <QThread>
@@ -282,7 +284,7 @@ int SSHImpl::consume_until_match(const std::string& text, bool case_sensitive) {
   return rv;
 }
 
-SSHIOProvider::SSHIOProvider(const std::string& n, const std::string& cmd_line, const std::string& actions) : name(n), ssh_dock(nullptr), finished_login(false) {
+SSHIOProvider::SSHIOProvider(const std::string& n, const std::string& cmd_line, const std::string& actions) : name(n), ssh_dock(nullptr), finished_login(false), agent_probed(false), agent_available(false), agent_zlib(false), agent_ready(false) {
   prefix = "ssh://" + name;
 
   ssh_dock = (dynamic_cast<MainWindow*>(master.get_main_window()))->add_new_dock();
@@ -313,6 +315,10 @@ void SSHIOProvider::check_loop() {
   }
 }
 
+bool SSHIOProvider::is_busy(const std::string& /* abs_path */) {
+  return pimpl->process_impl->get_event_loop()->isRunning();
+}
+
 void SSHIOProvider::update_status_text() {
   if (pimpl->process_impl->is_running()) {
     if (pimpl->state == SSHState::IDLE) {
@@ -385,53 +391,201 @@ bool SSHIOProvider::parent_dir(const std::string& abs_path, std::string& output)
   return true;
 }
 
-std::vector<DirEntry> SSHIOProvider::list_dir(const std::string& abs_path, const std::string& filter) {
-  check_loop();
+std::vector<DirEntry> SSHIOProvider::parse_ls(const std::string& output) {
+  std::vector<DirEntry> vec;
+  std::vector<std::string> splitted;
+  utf8_string_split(splitted, output, '\n');
+  for (unsigned int i = 0; i < splitted.size(); i++) {
+    DirEntryType::Type type = DirEntryType::FILE;
+    std::string& name = splitted[i];
+    if (name.empty()) continue;
+    // Error messages, in case stderr got mixed in.
+    if (is_prefix("ls: ", name)) continue;
+    char last_char = name[name.size()-1];
+    if (last_char == '/') {
+      type = DirEntryType::DIR;
+      name.erase(name.end() - 1);
+    } else if (last_char == '@') {
+      type = DirEntryType::LINK;
+      name.erase(name.end() - 1);
+    } else if (last_char == '*' || last_char == '=' || last_char == '>' || last_char == '|') {
+      name.erase(name.end() - 1);
+    }
+    vec.push_back(DirEntry( {name, type} ));
+  }
+  return vec;
+}
+
+/** Remote paths always use '/', regardless of the local platform. */
+static std::string remote_join(const std::string& dir, const std::string& name) {
+  if (!dir.empty() && dir[dir.size()-1] == '/') return dir + name;
+  return dir + "/" + name;
+}
 
-  const QString q_filter = QString::fromStdString(filter);
-  const bool to_filter = !filter.empty();
+static std::string remote_parent(const std::string& path) {
+  size_t x = path.find_last_of('/');
+  if (x == std::string::npos || x == 0) return "/";
+  return path.substr(0, x);
+}
 
+static std::vector<DirEntry> filter_entries(const std::vector<DirEntry>& entries, const std::string& filter) {
+  if (filter.empty()) return entries;
+  const std::shared_ptr<const UtilGlob::GlobSet> globs = UtilGlob::compile_filter(filter);
   std::vector<DirEntry> vec;
+  for (const DirEntry& de : entries) {
+    if (globs->matches(de.name)) continue;
+    vec.push_back(de);
+  }
+  return vec;
+}
+
+std::vector<SSHBatchResult> SSHIOProvider::run_batch(const std::vector<std::string>& commands) {
+  // All commands are sent at once, each followed by its own tag, so the whole batch costs a single
+  // round trip.
+  std::string batch;
+  for (unsigned int i = 0; i < commands.size(); i++) {
+    const std::string tag = std::to_string(i);
+    batch += commands[i] + " && echo OK_SYNTAXIC_TAG_" + tag + " || echo NO_SYNTAXIC_TAG_" + tag + "\n";
+  }
+  batch += "echo SYNTAXIC_TERMINATOR\n";
+  write_to_process(batch);
+  pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
+
+  const std::string& consumed = pimpl->consumed;
+  std::vector<SSHBatchResult> results;
+  size_t pos = 0;
+  for (unsigned int i = 0; i < commands.size(); i++) {
+    const std::string tag = "_SYNTAXIC_TAG_" + std::to_string(i) + "\n";
+    size_t loc = consumed.find(tag, pos);
+    if (loc == std::string::npos || loc < pos + 2) {
+      throw IOProviderError("Failed command '" + commands[i] + "': no output");
+    }
+    SSHBatchResult result;
+    result.ok = consumed.compare(loc - 2, 2, "OK") == 0;
+    result.output = consumed.substr(pos, loc - 2 - pos);
+    results.push_back(result);
+    pos = loc + tag.size();
+  }
+  return results;
+}
+
+bool SSHIOProvider::get_cached_listing(const std::string& path, std::vector<DirEntry>& entries) {
+  auto it = listing_cache.find(path);
+  if (it == listing_cache.end()) return false;
+  if (get_timestamp() - it->second.timestamp > SSH_CACHE_TTL) {
+    listing_cache.erase(it);
+    return false;
+  }
+  entries = it->second.entries;
+  return true;
+}
+
+void SSHIOProvider::invalidate_cache(const std::string& path) {
+  const std::string parent = remote_parent(path);
+  listing_cache.erase(parent);
+  size_cache.erase(path);
+
+  // Everything under path (in case it was a directory).
+  const std::string prefix_dir = path + "/";
+  for (auto it = listing_cache.begin(); it != listing_cache.end(); ) {
+    if (it->first == path || is_prefix(prefix_dir, it->first)) it = listing_cache.erase(it);
+    else ++it;
+  }
+  for (auto it = size_cache.begin(); it != size_cache.end(); ) {
+    if (is_prefix(prefix_dir, it->first)) it = size_cache.erase(it);
+    else ++it;
+  }
+}
 
+void SSHIOProvider::refresh(const std::string& abs_path) {
+  if (abs_path.size() <= prefix.size()) {
+    listing_cache.clear();
+    size_cache.clear();
+    return;
+  }
+  invalidate_cache(abs_path.substr(prefix.size()));
+}
+
+std::vector<DirEntry> SSHIOProvider::list_dir(const std::string& abs_path, const std::string& filter) {
   if (abs_path == "") {
+    std::vector<DirEntry> vec;
     vec.push_back(DirEntry( { prefix + "/", DirEntryType::DIR } ));
     return vec;
   }
   std::string path = abs_path.substr(prefix.size());
+
+  std::vector<DirEntry> entries;
+  if (get_cached_listing(path, entries)) return filter_entries(entries, filter);
+
+  check_loop();
   std::string cmd = "ls -F1 '" + path + "' && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
   write_to_process(cmd);
   pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
+  entries = parse_ls(check_consumed(cmd, pimpl->consumed));
+  listing_cache[path] = { get_timestamp(), entries };
+  return filter_entries(entries, filter);
+}
 
-  // Parse output of ls.
-  {
-    std::vector<std::string> splitted;
-    std::string consumed = check_consumed(cmd, pimpl->consumed);
-    utf8_string_split(splitted, consumed, '\n');
-    for (unsigned int i = 0; i < splitted.size(); i++) {
-      DirEntryType::Type type = DirEntryType::FILE;
-      std::string& name = splitted[i];
-      if (name.empty()) continue;
-      char last_char = name[name.size()-1];
-      if (last_char == '/') {
-        type = DirEntryType::DIR;
-        name.erase(name.end() - 1);
-      } else if (last_char == '@') {
-        type = DirEntryType::LINK;
-        name.erase(name.end() - 1);
-      } else if (last_char == '*' || last_char == '=' || last_char == '>' || last_char == '|') {
-        name.erase(name.end() - 1);
+std::map<std::string, std::vector<DirEntry>> SSHIOProvider::list_dir_recursive(const std::string& abs_path,
+    const std::string& filter, int max_depth) {
+  std::map<std::string, std::vector<DirEntry>> listings;
+  if (abs_path == "") {
+    listings[abs_path] = list_dir(abs_path, filter);
+    return listings;
+  }
+
+  // Breadth first, every level of the tree is listed in one batch.
+  std::vector<std::string> level;
+  level.push_back(abs_path.substr(prefix.size()));
+  for (int depth = 0; !level.empty() && (max_depth < 0 || depth <= max_depth); depth++) {
+    std::vector<std::string> to_list;
+    for (const std::string& path : level) {
+      std::vector<DirEntry> entries;
+      if (!get_cached_listing(path, entries)) to_list.push_back(path);
+    }
+
+    for (unsigned int start = 0; start < to_list.size(); start += SSH_MAX_BATCH) {
+      check_loop();
+      std::vector<std::string> commands;
+      for (unsigned int i = start; i < to_list.size() && i < start + SSH_MAX_BATCH; i++) {
+        // Directories may vanish or be unreadable, their errors must not end up in the output.
+        commands.push_back("ls -F1 '" + to_list[i] + "' 2>/dev/null");
+      }
+      std::vector<SSHBatchResult> results = run_batch(commands);
+      const double timestamp = get_timestamp();
+      for (unsigned int i = 0; i < results.size(); i++) {
+        // Unreadable directories are simply left out.
+        if (!results[i].ok) continue;
+        listing_cache[to_list[start + i]] = { timestamp, parse_ls(results[i].output) };
+      }
+    }
+
+    std::vector<std::string> next_level;
+    for (const std::string& path : level) {
+      std::vector<DirEntry> entries;
+      if (!get_cached_listing(path, entries)) continue;
+      entries = filter_entries(entries, filter);
+      for (const DirEntry& de : entries) {
+        if (de.type == DirEntryType::DIR) next_level.push_back(remote_join(path, de.name));
       }
-      if (to_filter && QDir::match(q_filter, QString::fromStdString(name))) continue;
-      vec.push_back(DirEntry( {name, type} ));
+      listings[prefix + path] = entries;
     }
+    level.swap(next_level);
   }
-  return vec;
+  return listings;
 }
 
 unsigned long SSHIOProvider::get_file_size(const std::string& abs_path) {
-  check_loop();
-
   std::string path = abs_path.substr(prefix.size());
+  {
+    auto it = size_cache.find(path);
+    if (it != size_cache.end()) {
+      if (get_timestamp() - it->second.timestamp <= SSH_CACHE_TTL) return it->second.size;
+      size_cache.erase(it);
+    }
+  }
+
+  check_loop();
   std::string cmd = "wc -c '" + path + "' && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
 
   write_to_process(cmd);
@@ -443,11 +597,14 @@ unsigned long SSHIOProvider::get_file_size(const std::string& abs_path) {
     std::string consumed = check_consumed(cmd, pimpl->consumed);
     utf8_string_split_whitespace(splitted, consumed);
     if (splitted.size() == 0) throw IOProviderError("Could not get size of " + abs_path);
+    unsigned long size;
     try {
-      return std::stoi(splitted[0]);
+      size = std::stoul(splitted[0]);
     } catch (...) {
       throw IOProviderError("Invalid output of wc -c");
     }
+    size_cache[path] = { get_timestamp(), size };
+    return size;
   }
 }
 
@@ -462,6 +619,7 @@ void SSHIOProvider::touch(const std::string& abs_path, DirEntryType::Type type)
   } else {
     cmd = "mkdir '" + path + "' && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
   }
+  invalidate_cache(path);
   write_to_process(cmd);
   pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
   check_consumed(cmd, pimpl->consumed);
@@ -473,6 +631,8 @@ void SSHIOProvider::rename(const std::string& abs_path_old, const std::string& a
   std::string path_new = abs_path_new.substr(prefix.size());
 
   std::string cmd = "mv '" + path_old + "' '" + path_new + "' && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
+  invalidate_cache(path_old);
+  invalidate_cache(path_new);
   write_to_process(cmd);
   pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
   check_consumed(cmd, pimpl->consumed);
@@ -483,15 +643,66 @@ void SSHIOProvider::remove(const std::string& abs_path) {
   std::string path = abs_path.substr(prefix.size());
 
   std::string cmd = "rm -r '" + path + "' && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
+  invalidate_cache(path);
   write_to_process(cmd);
   pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
   check_consumed(cmd, pimpl->consumed);
 }
 
+#define AGENT_COMMAND "syntaxic_remote_editor"
+
+void SSHIOProvider::probe_agent() {
+  if (agent_probed) return;
+  agent_probed = true;
+
+  std::string cmd = AGENT_COMMAND " --features && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
+  write_to_process(cmd);
+  pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
+  if (!check_consumed_is_ok(cmd, pimpl->consumed)) {
+    log_message("Remote agent not found, using plain transfers.\n");
+    return;
+  }
+  agent_available = pimpl->consumed.find("frames") != std::string::npos;
+  agent_zlib = pimpl->consumed.find("zlib") != std::string::npos;
+  agent_ready = pimpl->consumed.find("ready") != std::string::npos;
+}
+
+void SSHIOProvider::start_agent() {
+  write_to_process(AGENT_COMMAND " && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n");
+  // Agent puts its tty into raw mode without echo and then announces itself.  Anything sent
+  // before that would be echoed back and cut at the canonical line limit.
+  if (agent_ready) pimpl->consume_until_match("[READY]", true);
+}
+
+std::vector<char> SSHIOProvider::read_file_framed(const std::string& path) {
+  std::string cmd = AGENT_COMMAND " && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
+  start_agent();
+  write_to_process("[READ " + std::string(agent_zlib ? "Z " : "R ") + RemoteTransfer::encode_path(path) + "]\n[QUIT]\n", false);
+  pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
+  std::string consumed = check_consumed(cmd, pimpl->consumed);
+  return RemoteTransfer::decode_frames(consumed);
+}
+
+void SSHIOProvider::write_file_framed(const std::string& path, const char* data, unsigned int size) {
+  // The agent writes into a temporary file and moves it over the original only once the whole
+  // transfer has been verified, so no backup is needed.
+  std::string cmd = AGENT_COMMAND " && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
+  start_agent();
+  write_to_process("[WRITE " + RemoteTransfer::encode_path(path) + "]\n", false);
+  write_to_process(RemoteTransfer::encode_frames(data, size, agent_zlib), false);
+  write_to_process("[QUIT]\n", false);
+  pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
+  std::string consumed = check_consumed(cmd, pimpl->consumed);
+  RemoteTransfer::check_reply(consumed);
+}
+
 std::vector<char> SSHIOProvider::read_file(const std::string& abs_path) {
   check_loop();
 
   std::string path = abs_path.substr(prefix.size());
+  probe_agent();
+  if (agent_available) return read_file_framed(path);
+
   std::string cmd = "cat '" + path + "' && echo OK_SYNTAXIC_TERMINATOR || echo NO_SYNTAXIC_TERMINATOR\n";
   write_to_process(cmd);
   pimpl->consume_until_match("SYNTAXIC_TERMINATOR", true);
@@ -504,6 +715,12 @@ void SSHIOProvider::write_file_safe(const std::string& abs_path, const char* dat
   check_loop();
 
   std::string path = abs_path.substr(prefix.size());
+  invalidate_cache(path);
+  probe_agent();
+  if (agent_available) {
+    write_file_framed(path, data, size);
+    return;
+  }
 
   // First check if file exists already.
   bool saved_backup = false;
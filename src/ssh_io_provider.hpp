@@ -4,11 +4,24 @@
 #include "io_provider.hpp"
 #include "qtgui/dock.hpp"
 
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
+
+/** How long (in seconds) are remote listings and file sizes cached. */
+#define SSH_CACHE_TTL 10.0
+/** Maximum number of commands sent in one batch. */
+#define SSH_MAX_BATCH 64
 
 class SSHImpl;
 
+/** Output of a single command in a batch. */
+struct SSHBatchResult {
+  bool ok;
+  std::string output;
+};
+
 class SSHIOProvider : public IOProvider, public DockNotifier {
 friend class SSHImpl;
 
@@ -28,7 +41,39 @@ private:
 
   void check_loop();
 
+  /** Send all commands in one write and collect their outputs, costs a single round trip. */
+  std::vector<SSHBatchResult> run_batch(const std::vector<std::string>& commands);
+
+  /** Unfiltered listings and file sizes, keyed by remote path.  Entries expire after SSH_CACHE_TTL
+  and are invalidated by any operation that modifies the path. */
+  struct CachedListing {
+    double timestamp;
+    std::vector<DirEntry> entries;
+  };
+  struct CachedSize {
+    double timestamp;
+    unsigned long size;
+  };
+  std::map<std::string, CachedListing> listing_cache;
+  std::map<std::string, CachedSize> size_cache;
+  bool get_cached_listing(const std::string& path, std::vector<DirEntry>& entries);
+  void invalidate_cache(const std::string& path);
+
+  /** Remote agent (syntaxic_remote_editor) is used for binary-safe, compressed transfers if it is
+  installed on the remote side.  Otherwise cat and heredocs are used. */
+  bool agent_probed;
+  bool agent_available;
+  bool agent_zlib;
+  bool agent_ready;
+  void start_agent();
+  void probe_agent();
+  std::vector<char> read_file_framed(const std::string& path);
+  void write_file_framed(const std::string& path, const char* data, unsigned int size);
+
 public:
+  /** Parse output of "ls -F1". */
+  static std::vector<DirEntry> parse_ls(const std::string& output);
+
   SSHIOProvider(const std::string& name, const std::string& cmd_line, const std::string& actions);
   virtual ~SSHIOProvider();
 
@@ -37,6 +82,10 @@ public:
   virtual bool parent_dir(const std::string& abs_path, std::string& output);
   virtual std::vector<DirEntry> list_dir(const std::string& abs_path, const std::string& filter);
   virtual unsigned long get_file_size(const std::string& abs_path);
+  virtual std::map<std::string, std::vector<DirEntry>> list_dir_recursive(const std::string& abs_path,
+      const std::string& filter, int max_depth);
+  virtual void refresh(const std::string& abs_path);
+  virtual bool is_busy(const std::string& abs_path);
   virtual void touch(const std::string& abs_path, DirEntryType::Type type);
   virtual void rename(const std::string& abs_path_old, const std::string& abs_path_new);
   virtual void remove(const std::string& abs_path);
@@ -4,45 +4,67 @@
 #include "master_io_provider.hpp"
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <QCoreApplication>
 #include <vector>
 
+static void usage() {
+  fprintf(stderr, "usage: slindep [--threads N] [--output FILE] DIR\n");
+}
+
 int main(int argc, char** argv) {
   QCoreApplication qca(argc, argv);
   MasterIOProvider miop;
 
-  if (argc > 1) {
-    StatLang stat_lang;
-
-    {
-      // Load statlang meta.
-      std::vector<char> file_contents;
-      read_file(file_contents, under_root("syntaxic_meta.json"));
-      stat_lang.init(file_contents.data(), file_contents.size());
+  std::string root, output_path;
+  int num_threads = std::thread::hardware_concurrency();
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      num_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (argv[i][0] == '-' || !root.empty()) {
+      usage();
+      return 1;
+    } else {
+      root = argv[i];
     }
+  }
+  if (root.empty()) {
+    usage();
+    return 1;
+  }
+  if (num_threads < 1) num_threads = 1;
 
-    std::vector<std::string> paths = UtilPath::walk(argv[1]);
-    std::vector<std::unique_ptr<TextFile>> files;
+  StatLang stat_lang;
+  {
+    // Load statlang meta.
+    std::vector<char> file_contents;
+    read_file(file_contents, under_root("syntaxic_meta.json"));
+    stat_lang.init(file_contents.data(), file_contents.size());
+  }
 
-    for (auto& path: paths) {
-      fprintf(stderr, "processing %s...\n", path.c_str());
+  const double start = get_timestamp();
+  std::vector<std::string> paths = UtilPath::walk(root);
+  SymbolIndex index;
+  stat_lang.run_analysis(paths, num_threads, index);
+  fprintf(stderr, "%d files, %d symbols, %.2f s on %d threads\n", int(paths.size()),
+      int(index.symbols.size()), get_timestamp() - start, num_threads);
 
-      try {
-        std::unique_ptr<TextFile> tf(new TextFile(master_io_provider));
-        tf->change_path(path);
-        tf->load();
-        int sl_id = stat_lang.add_document(tf.get());
-        stat_lang.infer_document_type(sl_id, tf->get_file_name());
-        stat_lang.process_document(sl_id, nullptr);
-        files.push_back(std::move(tf));
-      } catch (std::exception& e) {
-        fprintf(stderr, "error: %s\n", e.what());
-      }
+  FILE* out = stdout;
+  if (!output_path.empty()) {
+    out = fopen(output_path.c_str(), "w");
+    if (out == nullptr) {
+      fprintf(stderr, "error: could not write '%s'\n", output_path.c_str());
+      return 1;
     }
-
-    stat_lang.run_analysis();
   }
-}
\ No newline at end of file
+  index.write_json(out);
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "document.hpp"
 #include "core/cont_file.hpp"
+#include "core/perf.hpp"
 #include "core/util.hpp"
 #include "core/util_glob.hpp"
 #include "core/utf8_util.hpp"
@@ -86,9 +87,11 @@ struct StatLangData {
   std::vector<StatLangToken> tokens;
   std::vector<StatLangBlock> blocks;
   SymbolDatabase symbol_db;
+  /** Tokens, blocks and symbols were dropped, see StatLang::release_document. */
+  bool released;
 
-  StatLangData(int _id, TextBuffer* tb) : id(_id), text_buffer(tb) { type = "Text"; }
-  StatLangData() : id(0), text_buffer(nullptr) {}
+  StatLangData(int _id, TextBuffer* tb) : id(_id), text_buffer(tb), released(false) { type = "Text"; }
+  StatLangData() : id(0), text_buffer(nullptr), released(false) {}
 
   int token_starting_at(unsigned int row, unsigned int col) {
     // TODO: Switch to binary search
@@ -135,15 +138,18 @@ void SymbolMetadata::debug(){
 
 ////////////////////////////////////////////////////////////// StatLang
 
-StatLang::StatLang() : max_id(1) {}
+StatLang::StatLang() : prewarm_running(false), prewarm_stop(false), max_id(1) {}
 
-StatLang::~StatLang() {}
+StatLang::~StatLang() {
+  prewarm_stop = true;
+  if (prewarm_thread.joinable()) prewarm_thread.join();
+}
 
 void StatLang::init(const char* json_contents, int json_size) {
   // Hook up to documents
   document_hook = all_docs_hook.add(
       std::bind(&StatLang::document_callback, this, std::placeholders::_1,
-      std::placeholders::_2));
+      std::placeholders::_2), "StatLang");
 
   // Parse JSON
   Json::Reader json_reader;
@@ -162,13 +168,13 @@ void StatLang::init(const char* json_contents, int json_size) {
     available_file_types.push_back(lang_name);
     Json::Value lang_obj = lang_root[lang_name];
     std::string meta_file = lang_obj["meta_file"].asString();
-    Json::Value globs = lang_obj["globs"];
+    Json::Value lang_globs = lang_obj["globs"];
 
     // Map globs
-    for (unsigned int i = 0; i < globs.size(); i++) {
-      std::string glob = globs[i].asString();
-      glob_map[glob] = lang_name;
+    for (unsigned int i = 0; i < lang_globs.size(); i++) {
+      globs.add(lang_globs[i].asString(), glob_types.size());
     }
+    glob_types.push_back(lang_name);
 
     // Map meta file
     meta_map[lang_name] = meta_file;
@@ -234,13 +240,8 @@ void StatLang::infer_document_type(int id, const std::string& filename) {
     return;
   }
   StatLangData* sld = internal_data[id].get();
-  for (auto& pair: glob_map) {
-    if (UtilGlob::matches(pair.first, filename)) {
-      sld->type = pair.second;
-      return;
-    }
-  }
-  sld->type = "Text";
+  const int glob_type = globs.match(filename);
+  sld->type = glob_type >= 0 ? glob_types[glob_type] : "Text";
 }
 
 void StatLang::set_document_type(int id, const std::string& type) {
@@ -266,32 +267,101 @@ LanguageDefs* StatLang::get_language_def(int id) {
   StatLangData* sld = internal_data[id].get();
   const std::string& file_type = sld->type;
   if (file_type == "Text") return nullptr;
-  if (language_defs.count(file_type) == 0) {
-    if (meta_map.count(file_type) == 0) {
-      printf("Warning: no meta for file_type: %s\n", file_type.c_str());
-      return nullptr;
+  {
+    std::lock_guard<std::mutex> lock(defs_mutex);
+    auto it = language_defs.find(file_type);
+    if (it != language_defs.end()) return it->second.get();
+  }
+
+  if (meta_map.count(file_type) == 0) {
+    printf("Warning: no meta for file_type: %s\n", file_type.c_str());
+    return nullptr;
+  }
+  std::string meta_file = meta_map[file_type];
+  std::unique_ptr<LanguageDefs> lang_def;
+  try {
+    std::vector<char> contents;
+    read_file(contents, under_root2("languages", meta_file + ".json"));
+    lang_def = std::unique_ptr<LanguageDefs>(new LanguageDefs(contents.data(), contents.size()));
+  } catch (std::exception& e) {
+    printf("ERROR: While trying to load language meta file for %s: %s\n", meta_file.c_str(),
+        e.what());
+    return nullptr;
+  }
+
+  // The prewarm thread may have got there first.
+  std::lock_guard<std::mutex> lock(defs_mutex);
+  std::unique_ptr<LanguageDefs>& slot = language_defs[file_type];
+  if (!slot) slot = std::move(lang_def);
+  return slot.get();
+}
+
+void StatLang::prewarm(const std::vector<std::string>& file_names) {
+  std::set<int> glob_type_set;
+  for (const std::string& file_name : file_names) {
+    const size_t slash = file_name.find_last_of("/\\");
+    const std::string base = slash == std::string::npos ? file_name : file_name.substr(slash + 1);
+    const int glob_type = globs.match(utf8_string_lower(base));
+    if (glob_type >= 0) glob_type_set.insert(glob_type);
+  }
+
+  std::lock_guard<std::mutex> lock(defs_mutex);
+  for (int glob_type : glob_type_set) {
+    const std::string& file_type = glob_types[glob_type];
+    if (language_defs.count(file_type) > 0 || meta_map.count(file_type) == 0) continue;
+    // Paths are resolved here, on the GUI thread.
+    prewarm_queue.push_back(std::make_pair(file_type, under_root2("languages", meta_map[file_type] + ".json")));
+  }
+  if (prewarm_queue.empty() || prewarm_running) return;
+
+  // Previous thread has run out of work, it only remains to reap it.
+  if (prewarm_thread.joinable()) prewarm_thread.join();
+  prewarm_running = true;
+  prewarm_thread = std::thread(&StatLang::prewarm_loop, this);
+}
+
+void StatLang::prewarm_loop() {
+  for (;;) {
+    std::pair<std::string, std::string> item;
+    {
+      std::lock_guard<std::mutex> lock(defs_mutex);
+      if (prewarm_queue.empty() || prewarm_stop) {
+        prewarm_queue.clear();
+        prewarm_running = false;
+        return;
+      }
+      item = prewarm_queue.back();
+      prewarm_queue.pop_back();
+      if (language_defs.count(item.first) > 0) continue;
     }
-    std::string meta_file = meta_map[file_type];
+
+    std::unique_ptr<LanguageDefs> lang_def;
     try {
       std::vector<char> contents;
-      read_file(contents, under_root2("languages", meta_file + ".json"));
-      language_defs[file_type] = std::unique_ptr<LanguageDefs>(new LanguageDefs(contents.data(), contents.size()));
+      read_file(contents, item.second);
+      lang_def = std::unique_ptr<LanguageDefs>(new LanguageDefs(contents.data(), contents.size()));
+      // Nothing is waiting on this, so compile everything now rather than as modes are entered.
+      lang_def->tokenizer.compile_all();
     } catch (std::exception& e) {
-      printf("ERROR: While trying to load language meta file for %s: %s\n", meta_file.c_str(),
-          e.what());
-      return nullptr;
+      printf("WARNING: Could not prewarm grammar '%s': %s\n", item.second.c_str(), e.what());
+      continue;
     }
+
+    std::lock_guard<std::mutex> lock(defs_mutex);
+    std::unique_ptr<LanguageDefs>& slot = language_defs[item.first];
+    if (!slot) slot = std::move(lang_def);
   }
-  return language_defs[file_type].get();
 }
 
 void StatLang::process_document(int id, RichText* rich_text) {
+  PerfTimer timer(PERF_PROCESS_DOCUMENT);
   if (internal_data.count(id) == 0) {
     printf("Warning: StatLang: no such id: %d\n", id);
     return;
   }
 
   StatLangData* sld = internal_data[id].get();
+  sld->released = false;
   LanguageDefs* lang_def = get_language_def(id);
   if (lang_def == nullptr) return;
   TextBuffer* text_buffer = sld->text_buffer;
@@ -424,9 +494,9 @@ void StatLang::process_document(int id, RichText* rich_text) {
     unsigned int token_index = 0;
     unsigned int symbol_index = 0;
     for (;;) {
+      if (symbol_index >= data.size()) break;
       SymbolData& sd = data[symbol_index];
       const CursorLocation cl_sd(sd.row, sd.col);
-      if (symbol_index >= data.size()) break;
       if (token_index < sld->tokens.size() - 1) {
         // Token can go further
         const StatLangToken& tok = sld->tokens[token_index+1];
@@ -592,6 +662,7 @@ static void highlight_parens(StatLangData* sld, LanguageDefs* lang_def, RichText
 }
 
 void StatLang::highlight_document(int id, CursorLocation cursor, RichText* rich_text) {
+  PerfTimer timer(PERF_HIGHLIGHT);
   if (internal_data.count(id) == 0) {
     printf("Warning: StatLang: no such id: %d\n", id);
     return;
@@ -628,6 +699,28 @@ void StatLang::remove_document(int id) {
   internal_data.erase(id);
 }
 
+void StatLang::add_memory_usage(int id, MemoryUsage& usage) {
+  StatLangData* sld = get_data_for_id(id);
+  if (sld == nullptr) return;
+  usage.bytes[MEM_STATLANG_TOKENS] += sld->tokens.capacity() * sizeof(StatLangToken);
+  usage.bytes[MEM_STATLANG_BLOCKS] += sld->blocks.capacity() * sizeof(StatLangBlock);
+  usage.bytes[MEM_SYMBOL_DB] += sld->symbol_db.get_memory_usage();
+}
+
+void StatLang::release_document(int id) {
+  StatLangData* sld = get_data_for_id(id);
+  if (sld == nullptr) return;
+  std::vector<StatLangToken>().swap(sld->tokens);
+  std::vector<StatLangBlock>().swap(sld->blocks);
+  sld->symbol_db.release();
+  sld->released = true;
+}
+
+bool StatLang::is_released(int id) {
+  StatLangData* sld = get_data_for_id(id);
+  return sld != nullptr && sld->released;
+}
+
 /// OTHER
 
 bool StatLang::get_document_comment(int id, std::string& prefix, std::string& postfix) {
@@ -745,43 +838,155 @@ void StatLang::get_symbol_metadata_vector(const std::string& symbol, std::vector
   std::sort(metadata.begin(), metadata.end(), SortMetadataByDefinitionScore());
 }
 
-static void debug_context(StatLangData* sld, int row) {
-  if (sld == nullptr) return;
-  printf("  (%04d)  %s\n", row, sld->text_buffer->get_line(row).to_string().c_str());
+/** Score occurrences of one symbol as definition candidates, as get_symbol_metadata_vector does,
+and sort them best first. */
+static void score_occurrences(std::vector<SymbolOccurrence>& occurrences) {
+  std::unordered_map<uint32_t, int> hash_map;
+  for (const SymbolOccurrence& so : occurrences) hash_map[so.hashes[0] ^ so.hashes[1]]++;
+  for (SymbolOccurrence& so : occurrences) {
+    int penalty = hash_map[so.hashes[0] ^ so.hashes[1]];
+    if (penalty > MAX_HASH_PENALTY) penalty = MAX_HASH_PENALTY;
+    so.definition_score = -so.block_depth*BLOCK_PENALTY - HASH_PENALTY*penalty;
+  }
+  std::sort(occurrences.begin(), occurrences.end(), [](const SymbolOccurrence& a, const SymbolOccurrence& b) {
+    if (a.definition_score != b.definition_score) return a.definition_score > b.definition_score;
+    if (a.file != b.file) return a.file < b.file;
+    if (a.row != b.row) return a.row < b.row;
+    return a.col < b.col;
+  });
 }
 
-void StatLang::run_analysis() {
-  // Get all symbols
-  std::set<std::string> all_symbols;
+void StatLang::collect_occurrences(int id, int file,
+    std::unordered_map<std::string, std::vector<SymbolOccurrence>>& symbols) {
+  StatLangData* sld = get_data_for_id(id);
+  if (sld == nullptr) return;
 
-  for (auto& pair: internal_data) {
-    SymbolDatabase& sdb = pair.second->symbol_db;
-    const std::vector<SymbolData>& data = sdb.get_data();
-    for (const SymbolData& sd : data) {
-      all_symbols.insert(sd.symbol);
+  // Innermost closed block around every token, in one sweep.  Blocks nest and come in order of
+  // their opening token.
+  std::vector<int> token_block(sld->tokens.size(), -1);
+  std::vector<int> open_blocks;
+  unsigned int next_block = 0;
+  for (unsigned int t = 0; t < sld->tokens.size(); t++) {
+    while (next_block < sld->blocks.size() && sld->blocks[next_block].token1 <= int(t)) {
+      if (sld->blocks[next_block].token2 >= int(t)) open_blocks.push_back(next_block);
+      next_block++;
+    }
+    while (!open_blocks.empty() && sld->blocks[open_blocks.back()].token2 < int(t)) open_blocks.pop_back();
+    if (!open_blocks.empty()) token_block[t] = open_blocks.back();
+  }
+
+  for (const SymbolData& sd : sld->symbol_db.get_data()) {
+    SymbolOccurrence so;
+    so.file = file;
+    so.row = sd.row;
+    so.col = sd.col;
+    so.token_type = 0;
+    so.block_depth = 0;
+    if (sd.token >= 0 && sd.token < int(sld->tokens.size())) {
+      so.token_type = sld->tokens[sd.token].token_type;
+      if (token_block[sd.token] >= 0) so.block_depth = sld->blocks[token_block[sd.token]].depth;
     }
+    so.hashes[0] = get_token_hash(sld, sd.token-1);
+    so.hashes[1] = get_token_hash(sld, sd.token+1);
+    so.definition_score = 0;
+    symbols[sd.symbol].push_back(so);
   }
+}
 
-  for (const std::string& s: all_symbols) {
-    printf("%s\n", s.c_str());
-    std::vector<SymbolMetadata> metadata;
-    get_symbol_metadata_vector(s, metadata);
-    for (auto& md: metadata) {
-      md.debug();
-      debug_context(get_data_for_id(md.statlang_id), md.symbol_data.row);
+void StatLang::run_analysis(const std::vector<std::string>& paths, int num_threads, SymbolIndex& index) {
+  if (num_threads < 1) num_threads = 1;
+  index.files = paths;
+  index.symbols.clear();
+
+  // STEP 1: Tokenize files in parallel.  RE2 is built without thread support, so every thread has
+  // its own StatLang and with it its own tokenizers.
+  std::vector<std::unique_ptr<StatLang>> workers;
+  std::vector<std::unordered_map<std::string, std::vector<SymbolOccurrence>>> local_symbols(num_threads);
+  std::atomic<unsigned int> next_file(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    workers.push_back(std::unique_ptr<StatLang>(new StatLang()));
+    StatLang* worker = workers.back().get();
+    worker->globs = globs;
+    worker->glob_types = glob_types;
+    worker->meta_map = meta_map;
+    threads.push_back(std::thread([worker, &paths, &next_file, &local_symbols, t]() {
+      std::vector<char> contents;
+      for (;;) {
+        const unsigned int file = next_file++;
+        if (file >= paths.size()) return;
+        const std::string& path = paths[file];
+        if (worker->globs.match(utf8_string_lower(last_component(path))) < 0) continue;
+
+        TextBuffer text_buffer;
+        try {
+          read_file(contents, path);
+        } catch (std::exception& e) {
+          fprintf(stderr, "error: %s\n", e.what());
+          continue;
+        }
+        if (is_binary_file(contents.data(), contents.size())
+            || !utf8_check(contents.data(), contents.size())) continue;
+        text_buffer.from_utf8(std::string(contents.data(), contents.size()));
+
+        const int id = worker->add_document(&text_buffer);
+        worker->infer_document_type(id, utf8_string_lower(last_component(path)));
+        worker->process_document(id, nullptr);
+        worker->collect_occurrences(id, file, local_symbols[t]);
+        worker->remove_document(id);
+      }
+    }));
+  }
+  for (std::thread& thread : threads) thread.join();
+  threads.clear();
+
+  // STEP 2: One index of all symbols.
+  for (auto& local : local_symbols) {
+    for (auto& pair : local) {
+      std::vector<SymbolOccurrence>& occurrences = index.symbols[pair.first];
+      if (occurrences.empty()) occurrences.swap(pair.second);
+      else occurrences.insert(occurrences.end(), pair.second.begin(), pair.second.end());
     }
+    local.clear();
   }
 
-//  for (auto& pair: internal_data) {
-//    const std::vector<StatLangBlock>& blocks = pair.second->blocks;
-//    const std::vector<StatLangToken>& tokens = pair.second->tokens;
-//    for (auto& b : blocks) {
-//
-//      printf("%d %d %d\n", b.token1, b.token2, b.parent_block);
-//      tokens[b.token1].debug();
-//      if (b.token2 > 0) {
-//        tokens[b.token2].debug();
-//      }
-//    }
-//  }
-}
\ No newline at end of file
+  // STEP 3: Score every symbol, in parallel, each symbol on its own.
+  std::vector<std::vector<SymbolOccurrence>*> all_occurrences;
+  all_occurrences.reserve(index.symbols.size());
+  for (auto& pair : index.symbols) all_occurrences.push_back(&pair.second);
+  std::atomic<unsigned int> next_symbol(0);
+  for (int t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&all_occurrences, &next_symbol]() {
+      for (;;) {
+        const unsigned int i = next_symbol++;
+        if (i >= all_occurrences.size()) return;
+        score_occurrences(*all_occurrences[i]);
+      }
+    }));
+  }
+  for (std::thread& thread : threads) thread.join();
+}
+
+void SymbolIndex::write_json(FILE* out) const {
+  fprintf(out, "{\n\"files\": [");
+  for (unsigned int i = 0; i < files.size(); i++) {
+    fprintf(out, "%s\n  %s", i ? "," : "", Json::valueToQuotedString(files[i].c_str()).c_str());
+  }
+  fprintf(out, "\n],\n\"symbols\": {");
+
+  std::vector<const std::string*> names;
+  names.reserve(symbols.size());
+  for (const auto& pair : symbols) names.push_back(&pair.first);
+  std::sort(names.begin(), names.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+  for (unsigned int i = 0; i < names.size(); i++) {
+    fprintf(out, "%s\n  %s: [", i ? "," : "", Json::valueToQuotedString(names[i]->c_str()).c_str());
+    const std::vector<SymbolOccurrence>& occurrences = symbols.at(*names[i]);
+    for (unsigned int j = 0; j < occurrences.size(); j++) {
+      const SymbolOccurrence& so = occurrences[j];
+      fprintf(out, "%s{\"file\": %d, \"row\": %u, \"col\": %u, \"token_type\": %d, \"block_depth\": %d, \"score\": %.3f}",
+          j ? ", " : "", so.file, so.row, so.col, so.token_type, so.block_depth, so.definition_score);
+    }
+    fprintf(out, "]");
+  }
+  fprintf(out, "\n}\n}\n");
+}
@@ -2,13 +2,19 @@
 #define STATLANG_STATLANG_HPP
 
 #include "core/hooks.hpp"
+#include "core/memory_usage.hpp"
 #include "core/rich_text.hpp"
 #include "core/text_file.hpp"
+#include "core/util_glob.hpp"
 #include "statlang/symboldb.hpp"
 #include "statlang/tokenizer.hpp"
 
+#include <atomic>
+#include <cstdio>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 class StatLangError : public std::runtime_error {
@@ -38,14 +44,44 @@ struct SymbolMetadata {
   void debug();
 };
 
+/** Occurrence of a symbol in one of the files of a SymbolIndex. */
+struct SymbolOccurrence {
+  int file;
+  uint32_t row, col;
+  uint8_t token_type;
+  int block_depth;
+  uint32_t hashes[2];
+  float definition_score;
+};
+
+/** All symbols of a tree of files, see StatLang::run_analysis. */
+struct SymbolIndex {
+  std::vector<std::string> files;
+  /** Occurrences of every symbol, best definition candidates first. */
+  std::unordered_map<std::string, std::vector<SymbolOccurrence>> symbols;
+
+  /** Write as a JSON object of files and symbols, symbols in order. */
+  void write_json(FILE* out) const;
+};
+
 class StatLang {
 private:
-  /** Map from extension to file type. */
-  std::unordered_map<std::string, std::string> glob_map;
+  /** Globs of all file types, matched against lowercase file names.  Values index glob_types. */
+  UtilGlob::GlobSet globs;
+  std::vector<std::string> glob_types;
   /** Map from file type to meta file name. */
   std::unordered_map<std::string, std::string> meta_map;
-  /** Map from file type to LanguageDef. */
+  /** Map from file type to LanguageDef.  Guarded by defs_mutex, as grammars are also loaded by the
+  prewarm thread. */
   std::unordered_map<std::string, std::unique_ptr<LanguageDefs>> language_defs;
+  std::mutex defs_mutex;
+
+  /** File types and paths of grammars the prewarm thread is to load, guarded by defs_mutex. */
+  std::vector<std::pair<std::string, std::string>> prewarm_queue;
+  bool prewarm_running;
+  std::atomic<bool> prewarm_stop;
+  std::thread prewarm_thread;
+  void prewarm_loop();
 
   /** Map of ID to internal data. */
   int max_id;
@@ -59,6 +95,8 @@ private:
 
   // Helpers:
   LanguageDefs* get_language_def(int id);
+  /** Add occurrences of the symbols of a processed document, as being in file. */
+  void collect_occurrences(int id, int file, std::unordered_map<std::string, std::vector<SymbolOccurrence>>& symbols);
 
 public:
   StatLang();
@@ -73,6 +111,10 @@ public:
   /** Initialize. */
   void init(const char* json_contents, int json_size);
 
+  /** Load the grammars for the file types of these files in the background, so that opening them
+  does not stall. */
+  void prewarm(const std::vector<std::string>& file_names);
+
 
   /////// StatLang processing
 
@@ -97,14 +139,24 @@ public:
   /** Remove a document from statlang. */
   void remove_document(int id);
 
+  /** Add memory held for a document (MEM_STATLANG_TOKENS, MEM_STATLANG_BLOCKS, MEM_SYMBOL_DB). */
+  void add_memory_usage(int id, MemoryUsage& usage);
+  /** Give back memory held for a document until it is processed again.  Its symbols are not
+  offered for completion meanwhile. */
+  void release_document(int id);
+  /** Was the document released and not processed since? */
+  bool is_released(int id);
+
   /** Get a single-line comment for a document. */
   bool get_document_comment(int id, std::string& prefix, std::string& postfix);
 
   /** Get information about this symbol. */
   void get_symbol_metadata_vector(const std::string& symbol, std::vector<SymbolMetadata>& metadata);
 
-  /** Run statlang big analysis. */
-  void run_analysis();
+  /** Analyze files on num_threads threads: tokenize them, index all their symbols and score every
+  occurrence as a definition candidate.  Files of unknown types or that cannot be read are left
+  out. */
+  void run_analysis(const std::vector<std::string>& paths, int num_threads, SymbolIndex& index);
 };
 
 #endif
\ No newline at end of file
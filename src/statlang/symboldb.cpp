@@ -1,3 +1,4 @@
+#include "core/memory_usage.hpp"
 #include "core/utf8_util.hpp"
 #include "statlang/symboldb.hpp"
 
@@ -47,4 +48,14 @@ void SymbolDatabase::get_symbol(const std::string& symbol, std::vector<SymbolDat
     output.push_back(*iter);
     iter++;
   }
-}
\ No newline at end of file
+}
+
+size_t SymbolDatabase::get_memory_usage() const {
+  size_t bytes = data.capacity() * sizeof(SymbolData);
+  for (const SymbolData& sd : data) bytes += heap_bytes(sd.symbol);
+  return bytes;
+}
+
+void SymbolDatabase::release() {
+  std::vector<SymbolData>().swap(data);
+}
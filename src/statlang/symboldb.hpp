@@ -1,6 +1,7 @@
 #ifndef SYNTAXIC_STATLANG_SYMBOLDB_HPP
 #define SYNTAXIC_STATLANG_SYMBOLDB_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <map>
 #include <string>
@@ -48,6 +49,11 @@ public:
 
   /** Get all occurences of symbol. */
   void get_symbol(const std::string& symbol, std::vector<SymbolData>& output);
+
+  /** Bytes held by the symbol table. */
+  size_t get_memory_usage() const;
+  /** Forget all symbols and give their memory back. */
+  void release();
 };
 
 #endif
\ No newline at end of file
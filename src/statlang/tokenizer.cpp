@@ -5,6 +5,8 @@
 #include "myre2.hpp"
 #include "utf8.h"
 
+#include <mutex>
+
 class Mode {
 public:
   uint16_t mode_id;
@@ -28,7 +30,31 @@ public:
   RE2::Set re_set;
   std::vector<std::unique_ptr<RE2>> regexes;
 
-  inline Mode(uint16_t m) : mode_id(m), type(TOKEN_TYPE_NONE), end_id(-1), illegal_id(-1), extra(0), escape_line_end(false), re_set(RE2::Options(), RE2::ANCHOR_START) {}
+  // Regexes are compiled when the mode is first entered, most modes of a grammar never are.
+  std::once_flag compile_flag;
+  /** Set if regexes failed to compile, the mode then matches nothing. */
+  bool broken;
+
+  inline Mode(uint16_t m) : mode_id(m), type(TOKEN_TYPE_NONE), end_id(-1), illegal_id(-1), extra(0), escape_line_end(false), re_set(RE2::Options(), RE2::ANCHOR_START), broken(false) {}
+
+  /** Compile, once.  Thread safe. */
+  inline void ensure_compiled() {
+    std::call_once(compile_flag, [this]() {
+      try {
+        compile();
+      } catch (TokenizerError& e) {
+        printf("WARNING: Tokenizer mode %d: %s\n", mode_id, e.what());
+        broken = true;
+      }
+    });
+  }
+
+  void compile_all() {
+    ensure_compiled();
+    for (auto& child: contains) {
+      child->compile_all();
+    }
+  }
 
   /** Prepare for operation.
 
@@ -36,13 +62,6 @@ public:
     Other ids are end_id and illegal_id, if any.
     */
   void compile() {
-    //// Compile children:
-
-    for (auto& child: contains) {
-      child->compile();
-    }
-
-    //// Compile self:
 
     // Compile each childs begin.
     for (auto& child: contains) {
@@ -165,13 +184,17 @@ Tokenizer::Tokenizer(const char* json_contents, int json_size) : case_insensitiv
 
   root_mode = std::unique_ptr<Mode>(new Mode(0));
   root_mode->from_json(this, json_root["root"]);
-  root_mode->compile();
+  root_mode->ensure_compiled();
 }
 
 Mode* Tokenizer::get_mode(int mode_id) {
   return root_mode->get_mode_by_id(mode_id);
 }
 
+void Tokenizer::compile_all() {
+  root_mode->compile_all();
+}
+
 Tokenizer::~Tokenizer() {}
 
 RunningTokenizer::RunningTokenizer(Tokenizer* t, int start_mode) : tokenizer(t){
@@ -206,10 +229,11 @@ void RunningTokenizer::run_tokenizer(const std::string& str) {
 
   for (;;) {
     if (cur > end) return;
+    current_mode->ensure_compiled();
     RE2::Set& set = current_mode->re_set;
 
     matches.clear();
-    const bool rv = set.Match(cur, &matches);
+    const bool rv = !current_mode->broken && set.Match(cur, &matches);
     if (rv) {
       int first_match = matches.front();
 
@@ -28,6 +28,8 @@ class Tokenizer {
 
 public:
   Mode* get_mode(int mode_id);
+  /** Modes are otherwise compiled as they are first entered. */
+  void compile_all();
 
   bool case_insensitive;
 
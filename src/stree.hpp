@@ -68,12 +68,16 @@ public:
 class STree {
 protected:
   UIWindow* ui_window;
+  /** Where to report changes made outside of activate and context_do, may be nullptr. */
+  STreeChangeNotifier* change_notifier;
 
 public:
-  inline STree() : ui_window(nullptr){}
+  inline STree() : ui_window(nullptr), change_notifier(nullptr){}
   virtual ~STree(){}
   inline UIWindow* get_ui_window() { return ui_window; }
   inline void set_ui_window(UIWindow* uiw) { ui_window = uiw; }
+  inline STreeChangeNotifier* get_change_notifier() { return change_notifier; }
+  inline void set_change_notifier(STreeChangeNotifier* fpcn) { change_notifier = fpcn; }
 
   virtual STreeNode* get_root_node() = 0;
   virtual void activate(const STreeNode* fpn, STreeChangeNotifier* fpcn) = 0;
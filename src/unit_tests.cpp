@@ -1,25 +1,38 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
 #include "catch.hpp"
 
+#include "choices.hpp"
 #include "core/flow_grid.hpp"
+#include "core/handle_table.hpp"
 #include "core/hooks.hpp"
 #include "core/line.hpp"
 #include "core/mapper.hpp"
+#include "core/perf.hpp"
+#include "core/rich_text.hpp"
+#include "core/scrollback_buffer.hpp"
 #include "core/text_edit.hpp"
 #include "core/text_file.hpp"
+#include "core/text_view.hpp"
 #include "core/util.hpp"
 #include "core/utf8_util.hpp"
 #include "core/util_glob.hpp"
+#include "doc.hpp"
 #include "duktape.h"
+#include "json/json.h"
+#include "known_documents.hpp"
 #include "lm.hpp"
 #include "lmgen.hpp"
 #include "master_io_provider.hpp"
+#include "master_js.hpp"
 #include "preferences.hpp"
+#include "remote_transfer.hpp"
+#include "ssh_io_provider.hpp"
 #include "statlang/symboldb.hpp"
 #include "uiwindow.hpp"
 #include "myre2.hpp"
 
 #include <QCoreApplication>
+#include <QEventLoop>
 #include <QTimer>
 
 TEST_CASE("Line", "[text]") {
@@ -55,6 +68,35 @@ TEST_CASE("Line", "[text]") {
     REQUIRE(line.size() == 7);
     REQUIRE(line.to_string() == "  fbar ");
   }
+
+  SECTION("splicing") {
+    line.insert(2, std::string("\xc5\xa1x\xc4\x91"), 3);
+    REQUIRE(line.size() == 12);
+    REQUIRE(line.get_char(2).c == 0x0161);
+    REQUIRE(line.get_char(4).markup == 3);
+    Line tail("<");
+    line.split(5, tail);
+    REQUIRE(line.size() == 5);
+    REQUIRE(tail.to_string() == "<foobar ");
+    line.append(tail, 1, 4);
+    REQUIRE(line.to_string() == "  \xc5\xa1x\xc4\x91" "foo");
+    REQUIRE(line.get_char(3).markup == 3);
+    REQUIRE(line.get_char(5).markup == 0);
+  }
+
+  SECTION("info") {
+    REQUIRE(line.get_indentation().num_spaces == 2);
+    REQUIRE(line.is_non_word() == false);
+    line.insert(0, '\t');
+    REQUIRE(line.get_indentation().num_tabs == 1);
+    REQUIRE(line.get_start() == 3);
+    line.remove(3, 9);
+    REQUIRE(line.is_whitespace() == true);
+    line.append("+-");
+    REQUIRE(line.is_whitespace() == false);
+    REQUIRE(line.is_non_word() == true);
+    REQUIRE(line.get_start() == 4);
+  }
 }
 
 TEST_CASE("File", "[text]") {
@@ -183,6 +225,85 @@ TEST_CASE("Mini File", "[text]") {
     REQUIRE(start_loc == CursorLocation(1,1));
     REQUIRE(rv == true);
   }
+
+  SECTION("Trim undo") {
+    {
+      SimpleTextEdit ste(tf, CursorLocation(1, 1), &tf);
+      ste.insert_text(CursorLocation(0, 2), "PO\nLIT\nIKA");
+    }
+    {
+      SimpleTextEdit ste(tf, CursorLocation(1, 1), &tf);
+      ste.insert_char(CursorLocation(0, 0), 'X');
+    }
+    UndoManager& um = tf.get_undo_manager();
+    const size_t usage = um.get_memory_usage();
+    REQUIRE(usage > 0);
+    REQUIRE(um.trim(usage) == 0);
+
+    // A large unsaved history goes under the budget, save point of load() included, and the
+    // document stays modified.
+    for (int i = 0; i < 1000; i++) {
+      SimpleTextEdit ste(tf, CursorLocation(0, 0), &tf);
+      ste.insert_char(CursorLocation(0, 0), 'Y');
+    }
+    REQUIRE(tf.has_unsaved_edits());
+    const size_t budget = um.get_memory_usage() / 4;
+    REQUIRE(um.trim(budget) > 0);
+    REQUIRE(um.get_memory_usage() <= budget);
+    REQUIRE(um.is_save_point() == false);
+    REQUIRE(um.undo(start_loc) == true);
+    while (um.undo(start_loc)) {}
+    REQUIRE(tf.has_unsaved_edits());
+    const std::string trimmed = tf.to_string();
+    REQUIRE(trimmed.substr(trimmed.size() - 21) == "YXabPO\nLIT\nIKAcd\nefgh");
+
+    // Once saved, older operations go but the save point on top stays.
+    {
+      SimpleTextEdit ste(tf, CursorLocation(0, 0), &tf);
+      ste.insert_char(CursorLocation(0, 0), 'Z');
+    }
+    um.add_save_point();
+    REQUIRE(um.trim(0) > 0);
+    REQUIRE(um.is_save_point());
+    bool rv = um.undo(start_loc);
+    REQUIRE(rv == false);
+    REQUIRE(tf.to_string() == "Z" + trimmed);
+
+    // Unused capacity of the history does not count against the budget.
+    for (int i = 0; i < 1000; i++) {
+      SimpleTextEdit ste(tf, CursorLocation(0, 0), &tf);
+      ste.insert_char(CursorLocation(0, 0), 'Y');
+    }
+    for (int i = 0; i < 998; i++) um.undo(start_loc);
+    um.add_save_point();
+    REQUIRE(um.trim(um.get_memory_usage() / 4) == 0);
+    REQUIRE(um.is_save_point());
+    rv = um.undo(start_loc);
+    REQUIRE(rv == true);
+    REQUIRE(tf.to_string() == "YZ" + trimmed);
+
+    MemoryUsage mu;
+    tf.add_memory_usage(mu);
+    REQUIRE(mu.bytes[MEM_TEXT] >= 15 * sizeof(Character));
+    REQUIRE(mu.total() == mu.bytes[MEM_TEXT] + mu.bytes[MEM_LINE_TOKENS]);
+  }
+
+  SECTION("Replacements") {
+    TextView tv(tf, &tf);
+    std::vector<TextReplacement> replacements;
+    replacements.push_back({CursorLocation(0, 1), CursorLocation(0, 3), "X"});
+    replacements.push_back({CursorLocation(1, 4), CursorLocation(1, 4), "\nY"});
+    replacements.push_back({CursorLocation(0, 4), CursorLocation(1, 1), ""});
+    REQUIRE(tv.apply_replacements(replacements) == 3);
+    REQUIRE(tf.to_string() == "aXdfgh\nY");
+    bool rv = tf.get_undo_manager().undo(start_loc);
+    REQUIRE(tf.to_string() == "abcd\nefgh");
+    REQUIRE(rv == true);
+
+    replacements.push_back({CursorLocation(0, 0), CursorLocation(0, 2), "Z"});
+    REQUIRE_THROWS(tv.apply_replacements(replacements));
+    REQUIRE(tf.to_string() == "abcd\nefgh");
+  }
 }
 
 TEST_CASE("Utils") {
@@ -253,12 +374,142 @@ TEST_CASE("Hooks") {
     }
     REQUIRE(hook.valid() == false);
   }
+
+  SECTION("Profile") {
+    HookSource<int> hook_source;
+    HookProfile profile;
+    Hook<int> hook = hook_source.add([](int) {}, "first");
+    Hook<int> hook2 = hook_source.add([](int) {});
+    hook_source.call(1);
+    hook_source.set_profile(&profile);
+    hook_source.call(1);
+    hook_source.call(1);
+    REQUIRE(profile.size() == 2);
+    REQUIRE(profile["first"].num_calls == 2);
+    REQUIRE(profile["(unnamed)"].num_calls == 2);
+  }
+}
+
+class EventDoc : public Doc {
+private:
+  HookSource<Doc*, int> hook;
+public:
+  HookSource<Doc*, int>* get_doc_hook() override { return &hook; }
+  const TextBuffer* get_text_buffer() const override { return nullptr; }
+  CursorLocation get_cursor() const override { return CursorLocation(0, 0); }
+  SelectionInfo get_selection() const override { return SelectionInfo(); }
+  std::string get_short_title() const override { return "Events"; }
+  void event(int flags) { call_hook(flags); }
+};
+
+TEST_CASE("Doc events") {
+  int num_scheduled = 0;
+  doc_events.set_scheduler([&num_scheduled]() { num_scheduled++; });
+
+  std::vector<int> delivered;
+  {
+    EventDoc doc;
+    Hook<Doc*, int> hook = doc.get_doc_hook()->add([&delivered](Doc*, int flags) {
+      delivered.push_back(flags);
+    });
+
+    doc.event(DocEvent::EDITED);
+    doc.event(DocEvent::EDITED | DocEvent::CURSOR_MOVED);
+    doc.event(DocEvent::CURSOR_MOVED);
+    REQUIRE(delivered.empty());
+    REQUIRE(num_scheduled == 1);
+    REQUIRE(doc.get_version() == 2);
+
+    doc_events.flush();
+    REQUIRE(delivered.size() == 1);
+    REQUIRE(delivered[0] == (DocEvent::EDITED | DocEvent::CURSOR_MOVED));
+
+    // Waiting events go before those that cannot wait.
+    doc.event(DocEvent::EDITED);
+    doc.event(DocEvent::BEFORE_SAVE);
+    REQUIRE(delivered.size() == 3);
+    REQUIRE(delivered[1] == DocEvent::EDITED);
+    REQUIRE(delivered[2] == DocEvent::BEFORE_SAVE);
+
+    // Closed with events waiting.
+    doc.event(DocEvent::EDITED);
+  }
+  doc_events.flush();
+  REQUIRE(delivered.size() == 3);
+
+  SECTION("Edit, then move before the frame") {
+    EventDoc doc;
+    TextBuffer tb;
+    tb.from_utf8("abcdefghij abcdefghij\nxyz");
+    FlowGrid fg;
+    fg.text_buffer = &tb;
+    fg.x_width = 10;
+    fg.word_wrap_width = 100;
+    fg.reflow();
+    REQUIRE(fg.get_row_info(0).num_effective_rows == 3);
+    Hook<Doc*, int> hook = doc.get_doc_hook()->add([&fg](Doc*, int flags) {
+      if (flags & DocEvent::EDITED) fg.reflow();
+    });
+
+    TextView tv(tb, nullptr);
+    tv.cursor_down(false);
+    tb.get_line(0).trim(2);
+    doc.event(DocEvent::EDITED);
+
+    // What the editor does before handling a key: the grid follows the edit.
+    doc_events.flush(&doc);
+    tv.cursor_up(false, &fg);
+    REQUIRE(tv.get_cursor().row == 0);
+    REQUIRE(tv.get_cursor().col <= 2);
+  }
+
+  doc_events.set_scheduler(nullptr);
+}
+
+TEST_CASE("Perf") {
+  perf.clear();
+  { PerfTimer timer(PERF_REFLOW); }
+  REQUIRE(perf.report().find("Reflow: 0 calls") != std::string::npos);
+
+  perf.set_enabled(true);
+  { PerfTimer timer(PERF_REFLOW); }
+  perf.record(PERF_PAINT, get_timestamp(), 0.003);
+  perf.set_enabled(false);
+  REQUIRE(perf.get_last(PERF_PAINT) == 0.003);
+  const std::string report = perf.report();
+  REQUIRE(report.find("Reflow: 1 calls") != std::string::npos);
+  REQUIRE(report.find("Paint: 1 calls") != std::string::npos);
+  const std::string trace = perf.chrome_trace();
+  REQUIRE(trace.find("\"name\":\"Reflow\"") != std::string::npos);
+  REQUIRE(trace.find("\"name\":\"Paint\"") != std::string::npos);
+  perf.clear();
 }
 
 #ifdef CMAKE_WINDOWS
 #define u8
 #endif
 
+TEST_CASE("HandleTable") {
+  HandleTable<int> table;
+  int a, b, c;
+  int ha = table.get_handle(&a);
+  int hb = table.get_handle(&b);
+  REQUIRE(ha >= 0);
+  REQUIRE(ha != hb);
+  REQUIRE(table.get_handle(&a) == ha);
+  REQUIRE(table.get(ha) == &a);
+  REQUIRE(table.get(hb) == &b);
+
+  // Slot of a is reused for c, but the stale handle must not resolve to it.
+  table.remove(&a);
+  REQUIRE(table.get(ha) == nullptr);
+  int hc = table.get_handle(&c);
+  REQUIRE(hc != ha);
+  REQUIRE(table.get(hc) == &c);
+  REQUIRE(table.get(ha) == nullptr);
+  REQUIRE(table.get(-1) == nullptr);
+}
+
 TEST_CASE("Mapper") {
   std::string str(u8"line1\nliščne2\nline3");
   Mapper mapper(str, 3);
@@ -340,6 +591,95 @@ TEST_CASE("Search", "[text]") {
   REQUIRE(results[0].size == 2);
 }
 
+TEST_CASE("Overlays", "[text]") {
+  MasterIOProvider miop;
+  TextFile tf(master_io_provider);
+  tf.change_path("test_files/small");
+  tf.load();
+
+  RichText rt;
+  rt.add_overlay(&tf, 3, 0, OverlayType::STATLANG_ERROR, "first");
+  rt.add_overlay(&tf, 3, 0, OverlayType::STATLANG_ERROR, "second");
+  rt.add_overlay(&tf, 4, 0, OverlayType::NOTICE, "third");
+  REQUIRE(rt.get_num_overlays() == 3);
+
+  // Displayed on the nearest short and free rows.
+  std::vector<const Overlay*> output;
+  rt.get_overlays(0, 2, output);
+  REQUIRE(output.empty());
+  rt.get_overlays(4, 4, output);
+  REQUIRE(output.size() == 2);
+  output.clear();
+  rt.get_overlays(6, 6, output);
+  REQUIRE(output.size() == 1);
+  REQUIRE(output[0]->row == 4);
+  REQUIRE(output[0]->drow == 6);
+
+  rt.clear_overlays(OverlayType::STATLANG_ERROR);
+  REQUIRE(rt.get_num_overlays() == 1);
+  rt.clear_overlays();
+  REQUIRE(rt.get_num_overlays() == 0);
+}
+
+TEST_CASE("Choices") {
+  REQUIRE(ChoiceList::calculate_score("zz", "src/tb.cpp") < 0);
+  REQUIRE(ChoiceList::calculate_score("TB", "src/tb.cpp") >= 0);
+  // Matches at word boundaries beat matches in the middle of words.
+  REQUIRE(ChoiceList::calculate_score("tb", "src/core/text_buffer.cpp")
+      > ChoiceList::calculate_score("tb", "src/core/attribute.cpp"));
+
+  ChoiceList cl;
+  cl.add_choice("src/core/attribute.cpp", 0);
+  cl.add_choice("src/core/text_buffer.cpp", 1);
+  cl.add_choice("src/qtgui/main_window.cpp", 2);
+  cl.order_choices();
+  REQUIRE(cl.chosen.size() == 3);
+
+  cl.refilter_choices("t");
+  REQUIRE(cl.chosen.size() == 3);
+  cl.refilter_choices("tb");
+  REQUIRE(cl.chosen.size() == 2);
+  REQUIRE(cl.chosen[0]->num == 1);
+  // Narrowed from the matches of "tb".
+  cl.refilter_choices("tbuf");
+  REQUIRE(cl.chosen.size() == 1);
+  REQUIRE(cl.chosen[0]->num == 1);
+  cl.refilter_choices("mw");
+  REQUIRE(cl.chosen.size() == 1);
+  REQUIRE(cl.chosen[0]->num == 2);
+  cl.refilter_choices("zzz");
+  REQUIRE(cl.chosen.empty());
+}
+
+TEST_CASE("Known document index") {
+  KnownDocumentIndex index;
+  index.add("/home/user/proj/src/core/line.cpp");
+  index.add("/home/user/proj/src/qtgui/line.cpp");
+  index.add("/home/user/proj/src/core/line.hpp");
+  index.add("/home/user/other/a/b/c/d/line.cpp");
+
+  std::vector<KnownDocumentMatch> matches;
+  index.find("build/../src/core/line.cpp", matches);
+  REQUIRE(matches.size() == 4);
+  REQUIRE(matches[0].abs_path == "/home/user/proj/src/core/line.cpp");
+  REQUIRE(matches[0].num_components == 3);
+  REQUIRE(matches[1].num_components == 1);
+  REQUIRE(matches[2].num_components == 1);
+  // Only the basename matches.
+  REQUIRE(matches[3].abs_path == "/home/user/proj/src/core/line.hpp");
+  REQUIRE(matches[3].num_components == 0);
+
+  // Deeper than the indexed suffixes.
+  matches.clear();
+  index.find("other\\a\\b\\c\\d\\line.cpp", matches);
+  REQUIRE(matches[0].abs_path == "/home/user/other/a/b/c/d/line.cpp");
+  REQUIRE(matches[0].num_components == 6);
+
+  matches.clear();
+  index.find("./missing.cpp", matches);
+  REQUIRE(matches.empty());
+}
+
 TEST_CASE("Extensions") {
   REQUIRE(".exe" == extract_extension("bar/foo.exe"));
   REQUIRE(".EXE" == extract_extension("/bar/foo.EXE"));
@@ -359,6 +699,74 @@ TEST_CASE("Globbing") {
   REQUIRE(false == UtilGlob::matches("*.foo", "name.bar"));
   REQUIRE(false == UtilGlob::matches("CMakeLists.txt", "CMakeCache.txt"));
   REQUIRE(false == UtilGlob::matches("r*.cpp", "advantage.cpp"));
+
+  UtilGlob::GlobSet globs;
+  globs.add("*.c", 1);
+  globs.add("*.cmake.in", 2);
+  globs.add("cmakelists.txt", 3);
+  globs.add("r*.cpp", 4);
+  globs.add("a?[b-d]*[!x]", 5);
+  globs.add("*", 6);
+  REQUIRE(globs.match("foo.c") == 1);
+  REQUIRE(globs.match("foo.cmake.in") == 2);
+  REQUIRE(globs.match("cmakelists.txt") == 3);
+  REQUIRE(globs.match("recents.cpp") == 4);
+  REQUIRE(globs.match("azcqqy") == 5);
+  REQUIRE(globs.match("azcqqx") == 6);
+
+  UtilGlob::GlobSet filter(true);
+  filter.add_filter("*.o;*.PYC  build", 0);
+  REQUIRE(filter.matches("MAIN.O"));
+  REQUIRE(filter.matches("main.pyc"));
+  REQUIRE(filter.matches("Build"));
+  REQUIRE(!filter.matches("main.cpp"));
+  REQUIRE(!filter.matches("builder"));
+}
+
+TEST_CASE("Globbing benchmark", "[.][bench]") {
+  std::vector<char> contents;
+  read_file(contents, "meta/syntaxic_meta.json");
+  Json::Reader json_reader;
+  Json::Value json_root;
+  REQUIRE(json_reader.parse(contents.data(), contents.data() + contents.size(), json_root));
+  Json::Value lang_root = json_root["stat_lang"]["languages"];
+  UtilGlob::GlobSet globs;
+  std::vector<std::string> all_globs;
+  for (const std::string& lang_name : lang_root.getMemberNames()) {
+    Json::Value lang_globs = lang_root[lang_name]["globs"];
+    for (unsigned int i = 0; i < lang_globs.size(); i++) {
+      globs.add(lang_globs[i].asString(), all_globs.size());
+      all_globs.push_back(lang_globs[i].asString());
+    }
+  }
+
+  const char* names[] = { "main.cpp", "cmakelists.txt", "index.html", "setup.py", "readme",
+      "foo.cmake.in", "style.css", "data.bin", "a.b.c.d.rb", "makefile" };
+  std::vector<std::string> paths;
+  for (int i = 0; i < 1000000; i++) paths.push_back(std::to_string(i) + names[i % 10]);
+
+  double start = get_timestamp();
+  int num_matched = 0;
+  for (const std::string& path : paths) {
+    if (globs.match(path) >= 0) num_matched++;
+  }
+  const double compiled_time = get_timestamp() - start;
+
+  // The old way, for comparison, on a tenth of the paths.
+  start = get_timestamp();
+  int num_matched_old = 0;
+  for (int i = 0; i < 100000; i++) {
+    for (const std::string& glob : all_globs) {
+      if (UtilGlob::matches(glob, paths[i])) {
+        num_matched_old++;
+        break;
+      }
+    }
+  }
+  const double old_time = get_timestamp() - start;
+  REQUIRE(num_matched == 10 * num_matched_old);
+  printf("Globbing 1M paths against %d globs: %.3f s (one glob at a time: %.3f s)\n",
+      int(all_globs.size()), compiled_time, 10 * old_time);
 }
 
 TEST_CASE("Playing with Re2", "[text]") {
@@ -398,6 +806,132 @@ TEST_CASE("ContFile", "[text]") {
   REQUIRE(ch.is_eof() == true);
 }
 
+TEST_CASE("Scrollback", "[text]") {
+  ScrollbackBuffer sb(100);
+  for (int i = 0; i < 100; i++) {
+    sb.append(std::to_string(i) + "\n");
+  }
+  REQUIRE(sb.get_num_lines() == 101);
+  REQUIRE(sb.evict() == 0);
+
+  const int slack = sb.get_slack();
+  for (int i = 100; i < 100 + slack; i++) {
+    sb.append(std::to_string(i) + "\n");
+  }
+  REQUIRE(sb.evict() == slack + 1);
+  REQUIRE(sb.get_num_lines() == 100);
+  REQUIRE(sb.get_line(0).to_string() == std::to_string(slack + 1));
+  REQUIRE(sb.get_last_line().to_string() == "");
+  REQUIRE(sb.get_num_spilled_lines() == 0);
+
+  SECTION("Spill") {
+    ScrollbackBuffer spilled(10);
+    spilled.set_spill(true);
+    std::string expected;
+    for (int i = 0; i < 200; i++) {
+      spilled.append(std::to_string(i) + "\n");
+      expected += std::to_string(i) + "\n";
+      spilled.evict();
+    }
+    REQUIRE(spilled.get_num_spilled_lines() > 0);
+    REQUIRE(spilled.get_num_lines() < 200);
+    REQUIRE(spilled.get_full_history() == expected);
+  }
+}
+
+TEST_CASE("Remote transfer", "[io]") {
+  std::string data;
+  for (int i = 0; i < 100000; i++) data += char(i % 7 == 0 ? 0 : 'a' + i % 13);
+  data += "\n~.\nSYNTAXIC_EOF\n";
+
+  SECTION("compressed") {
+    std::string frames = RemoteTransfer::encode_frames(data.data(), data.size(), true);
+    REQUIRE(frames.find("[CHUNK Z") != std::string::npos);
+    std::vector<char> decoded = RemoteTransfer::decode_frames("noise\n" + frames);
+    REQUIRE(std::string(decoded.begin(), decoded.end()) == data);
+  }
+
+  SECTION("raw") {
+    std::string frames = RemoteTransfer::encode_frames(data.data(), data.size(), false);
+    REQUIRE(frames.find("[CHUNK Z") == std::string::npos);
+    std::vector<char> decoded = RemoteTransfer::decode_frames(frames);
+    REQUIRE(std::string(decoded.begin(), decoded.end()) == data);
+  }
+
+  SECTION("line length") {
+    // Incompressible data gives the longest frames.
+    std::string noise;
+    uint32_t x = 12345;
+    for (int i = 0; i < 100000; i++) {
+      x = x * 1103515245 + 12345;
+      noise += char(x >> 24);
+    }
+    std::string frames = RemoteTransfer::encode_frames(noise.data(), noise.size(), true);
+    size_t start = 0, longest = 0;
+    while (start < frames.size()) {
+      size_t end = frames.find('\n', start);
+      REQUIRE(end != std::string::npos);
+      if (end - start + 1 > longest) longest = end - start + 1;
+      start = end + 1;
+    }
+    REQUIRE(longest < REMOTE_TRANSFER_MAX_LINE);
+    std::vector<char> decoded = RemoteTransfer::decode_frames(frames);
+    REQUIRE(std::string(decoded.begin(), decoded.end()) == noise);
+  }
+
+  SECTION("errors") {
+    std::string frames = RemoteTransfer::encode_frames(data.data(), data.size(), true);
+    REQUIRE_THROWS(RemoteTransfer::decode_frames(frames.substr(0, frames.find("[END"))));
+    REQUIRE_THROWS(RemoteTransfer::decode_frames("[ERROR Could not open file: x]\n"));
+    REQUIRE_NOTHROW(RemoteTransfer::check_reply("[OK]\n"));
+    REQUIRE_THROWS(RemoteTransfer::check_reply("[ERROR Checksum mismatch: x]\n"));
+  }
+}
+
+TEST_CASE("Remote listing", "[io]") {
+  std::vector<DirEntry> entries = SSHIOProvider::parse_ls(
+      "src/\nls: cannot open directory 'secret': Permission denied\nlink@\nrun.sh*\nREADME\n");
+  REQUIRE(entries.size() == 4);
+  REQUIRE(entries[0].name == "src");
+  REQUIRE(entries[0].type == DirEntryType::DIR);
+  REQUIRE(entries[1].name == "link");
+  REQUIRE(entries[1].type == DirEntryType::LINK);
+  REQUIRE(entries[2].name == "run.sh");
+  REQUIRE(entries[3].name == "README");
+  REQUIRE(entries[3].type == DirEntryType::FILE);
+}
+
+TEST_CASE("Async IO", "[io]") {
+  int argc = 1;
+  char arg0[] = "utests";
+  char* argv[] = { arg0 };
+  QCoreApplication app(argc, argv);
+  MasterIOProvider miop;
+
+  std::vector<std::string> paths = { "test_files/small", "test_files/mini", "test_files/does_not_exist" };
+  int num_ok = 0, num_failed = 0;
+  bool finished = false;
+  miop.read_files_async(paths, 0, [&](AsyncIOResult& result) {
+    if (result.ok) num_ok++;
+    else num_failed++;
+  }, [&](int num_done, int num_total) {
+    if (num_done == num_total) finished = true;
+  });
+  int num_cancelled = 0;
+  miop.read_file_async("test_files/mini", 0, [&](AsyncIOResult&) {
+    num_cancelled++;
+  })->cancel();
+
+  const double start = get_timestamp();
+  while (!finished && get_timestamp() - start < 5.0) {
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+  }
+  REQUIRE(finished);
+  REQUIRE(num_ok == 2);
+  REQUIRE(num_failed == 1);
+  REQUIRE(num_cancelled == 0);
+}
+
 TEST_CASE("Preferences", "[program]") {
   PrefManager pm;
 }
@@ -408,6 +942,22 @@ TEST_CASE("Duktape") {
   duk_destroy_heap(ctx);
 }
 
+TEST_CASE("Spawn", "[program]") {
+  int argc = 1;
+  char arg0[] = "utests";
+  char* argv[] = { arg0 };
+  QCoreApplication app(argc, argv);
+  MasterJS mjs;
+
+  mjs.eval_string("var spawned = ''; Syn.spawn({ command: 'cat', stdin: 'spawned output' }, "
+      "function(result) { spawned = result.stdout; });");
+  const double start = get_timestamp();
+  while (mjs.eval_string("spawned") == "\"\"" && get_timestamp() - start < 5.0) {
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+  }
+  REQUIRE(mjs.eval_string("spawned") == "\"spawned output\"");
+}
+
 TEST_CASE("FlowGrid") {
   MasterIOProvider miop;
   TextFile tf(master_io_provider);
@@ -430,4 +980,19 @@ TEST_CASE("FlowGrid") {
   REQUIRE(fg.map_to_y(1, 3) == 15);
   REQUIRE(fg.output_height == 7*15);
   REQUIRE(fg.output_width == 26*10);
+
+  SECTION("wrapping") {
+    fg.word_wrap_width = 100;
+    fg.word_wrap_indent = 0;
+    fg.reflow();
+    // "this is a " / "small test" / " file"
+    REQUIRE(fg.get_row_info(0).num_effective_rows == 3);
+    REQUIRE(fg.map_to_x(0, 10) == 0);
+    REQUIRE(fg.map_to_y(0, 10) == 15);
+    REQUIRE(fg.map_to_x(0, 22) == 20);
+    REQUIRE(fg.map_to_y(0, 22) == 30);
+    REQUIRE(fg.get_effective_row(0, 12) == 1);
+    REQUIRE(fg.map_to_y(1, 0) == 45);
+    REQUIRE(fg.unmap(0, 20) == CursorLocation(0, 10));
+  }
 }
\ No newline at end of file